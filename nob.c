@@ -12,11 +12,26 @@ int main(int argc, char **argv)
     {
         Nob_Cmd cmd = {0};
         nob_cmd_append(&cmd, "gcc");
-        nob_cmd_append(&cmd, "-Wall", "-Wextra", "-O3", "-march=native");
+        // -ffp-contract=off : même terrain généré sur toute machine (voir Makefile)
+        nob_cmd_append(&cmd, "-Wall", "-Wextra", "-O3", "-march=native", "-ffp-contract=off");
         nob_cmd_append(&cmd, "-I./include");
         nob_cmd_append(&cmd, "./src/main.c");
         nob_cmd_append(&cmd, "./src/data.c");
         nob_cmd_append(&cmd, "./src/atlas.c");
+        nob_cmd_append(&cmd, "./src/mesh.c");
+        nob_cmd_append(&cmd, "./src/mesher.c");
+        nob_cmd_append(&cmd, "./src/light.c");
+        nob_cmd_append(&cmd, "./src/horizon.c");
+        nob_cmd_append(&cmd, "./src/region.c");
+        nob_cmd_append(&cmd, "./src/save.c");
+        nob_cmd_append(&cmd, "./src/codec.c");
+        nob_cmd_append(&cmd, "./src/meshcache.c");
+        nob_cmd_append(&cmd, "./src/mpsc.c");
+        nob_cmd_append(&cmd, "./src/jobs.c");
+        nob_cmd_append(&cmd, "./src/pipeline.c");
+        nob_cmd_append(&cmd, "./src/residency.c");
+        nob_cmd_append(&cmd, "./src/pool.c");
+        nob_cmd_append(&cmd, "./src/noise.c");
         nob_cmd_append(&cmd, "-o", "./game");
         nob_cmd_append(&cmd, "-L./lib");
         nob_cmd_append(&cmd, "-lraylib", "-lopengl32", "-lgdi32", "-lwinmm", "-lws2_32");
@@ -16,13 +16,48 @@ static const BlockFaceTextures blockTextureMap[] = {
     [BLOCK_WATER]   = {ATLAS_WATER, ATLAS_WATER, ATLAS_WATER, ATLAS_WATER, ATLAS_WATER, ATLAS_WATER},
     [BLOCK_SAND]    = {ATLAS_SAND, ATLAS_SAND, ATLAS_SAND, ATLAS_SAND, ATLAS_SAND, ATLAS_SAND},
     [BLOCK_WOOD]    = {ATLAS_OAK_LOG_TOP, ATLAS_OAK_LOG_TOP, ATLAS_OAK_LOG_SIDE, ATLAS_OAK_LOG_SIDE, ATLAS_OAK_LOG_SIDE, ATLAS_OAK_LOG_SIDE},
+    [BLOCK_GLOWSTONE] = {ATLAS_GLOWSTONE, ATLAS_GLOWSTONE, ATLAS_GLOWSTONE, ATLAS_GLOWSTONE, ATLAS_GLOWSTONE, ATLAS_GLOWSTONE},
     [BLOCK_NULL]    = {ATLAS_NULL1, ATLAS_NULL1, ATLAS_NULL1, ATLAS_NULL1, ATLAS_NULL1, ATLAS_NULL1},
 };
 
+#define BLOCK_TYPE_COUNT (int)(sizeof(blockTextureMap) / sizeof(blockTextureMap[0]))
+
+// Couleur moyenne de la face supérieure de chaque bloc (terrain lointain)
+static Color blockTopColors[BLOCK_TYPE_COUNT];
+
+// Moyenne des pixels opaques d'une tuile de l'atlas
+static Color AverageTileColor(Image image, int atlasIndex)
+{
+    int x0 = (atlasIndex % ATLAS_COLS) * BLOCK_TEXTURE_SIZE;
+    int y0 = (atlasIndex / ATLAS_COLS) * BLOCK_TEXTURE_SIZE;
+    unsigned int r = 0, g = 0, b = 0, n = 0;
+    for (int y = 0; y < BLOCK_TEXTURE_SIZE; y++)
+    {
+        for (int x = 0; x < BLOCK_TEXTURE_SIZE; x++)
+        {
+            Color c = GetImageColor(image, x0 + x, y0 + y);
+            if (c.a == 0) continue;
+            r += c.r; g += c.g; b += c.b; n++;
+        }
+    }
+    if (n == 0) return MAGENTA;
+    return (Color){ r / n, g / n, b / n, 255 };
+}
+
 // Charger la texture atlas
 Texture2D LoadAtlasTexture(const char* filepath)
 {
-    Texture2D atlas = LoadTexture(filepath);
+    Image image = LoadImage(filepath);
+    Texture2D atlas = {0};
+    if (image.data != NULL)
+    {
+        for (int type = 0; type < BLOCK_TYPE_COUNT; type++)
+        {
+            blockTopColors[type] = AverageTileColor(image, blockTextureMap[type].top);
+        }
+        atlas = LoadTextureFromImage(image);
+        UnloadImage(image);
+    }
     if (atlas.id == 0)
     {
         fprintf(stderr, "Erreur: Impossible de charger l'atlas de textures: %s\n", filepath);
@@ -89,3 +124,31 @@ int GetBlockFaceTexture(int blockType, int faceIndex)
         default: return ATLAS_STONE;     // Fallback
     }
 }
+
+// Couleur moyenne de la face supérieure d'un bloc (calculée au chargement de l'atlas)
+Color GetBlockTopColor(int blockType)
+{
+    if (blockType < 0 || blockType >= BLOCK_TYPE_COUNT)
+    {
+        return blockTopColors[BLOCK_NULL];
+    }
+    return blockTopColors[blockType];
+}
+
+FaceUV blockFaceUV[BLOCK_TYPE_LIMIT][6];
+
+// Précalculer la tuile de chaque face de chaque type de bloc, pour que le
+// mesher n'ait qu'une lecture de table par face émise (pas de switch ni de
+// division). Les types inconnus prennent la texture de BLOCK_NULL.
+void InitBlockFaceUVTable(void)
+{
+    for (int type = 0; type < BLOCK_TYPE_LIMIT; type++)
+    {
+        for (int face = 0; face < 6; face++)
+        {
+            int tile = GetBlockFaceTexture(type, face);
+            Rectangle rect = GetTextureRectFromAtlas(tile);
+            blockFaceUV[type][face] = (FaceUV){ rect.x, rect.y, tile };
+        }
+    }
+}
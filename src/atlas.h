@@ -52,6 +52,7 @@ typedef enum {
     ATLAS_NULL2,
     ATLAS_FERN,
     ATLAS_GRASS_BIOME,
+    ATLAS_GLOWSTONE = 105,
     ATLAS_BREAKING1 = 240,
     ATLAS_BREAKING2,
     ATLAS_BREAKING3,
@@ -75,10 +76,26 @@ typedef struct {
     int west;     // Face ouest (-X)
 } BlockFaceTextures;
 
+// BlockData.Type tient sur 9 bits
+#define BLOCK_TYPE_LIMIT 512
+
+// Tuile d'une face de bloc, précalculée pour le mesher. La taille de la tuile
+// est la même partout (BLOCK_TEXTURE_SIZE), seule l'origine est stockée.
+typedef struct {
+    float u, v;   // origine UV de la tuile dans l'atlas (0.0 à 1.0)
+    int tile;     // index de la tuile dans l'atlas
+} FaceUV;
+
+// Table [type de bloc][face] remplie par InitBlockFaceUVTable().
+// faceIndex: 0=+X, 1=-X, 2=+Y, 3=-Y, 4=+Z, 5=-Z (comme GetBlockFaceTexture)
+extern FaceUV blockFaceUV[BLOCK_TYPE_LIMIT][6];
+
 // Fonctions pour gérer l'atlas
 Texture2D LoadAtlasTexture(const char* filepath);
 Rectangle GetTextureRectFromAtlas(int atlasIndex);
 BlockFaceTextures GetBlockTextures(int blockType);
 int GetBlockFaceTexture(int blockType, int faceIndex);
+Color GetBlockTopColor(int blockType);
+void InitBlockFaceUVTable(void);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,1184 @@
+// Headless benchmarks: ./bench [name...] runs the named benchmarks, or all of
+// them without arguments. No window is opened, only the CPU side is measured.
+#ifdef __linux__
+#define _GNU_SOURCE // writer-preferring rwlock (jobs)
+#endif
+#include "data.h"
+#include "atlas.h"
+#include "mesher.h"
+#include "light.h"
+#include "region.h"
+#include "save.h"
+#include "codec.h"
+#include "meshcache.h"
+#include "mpsc.h"
+#include "jobs.h"
+#include "pool.h"
+#include "noise.h"
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+    const char *name;
+    void (*run)(void);
+} Benchmark;
+
+// Set by a benchmark whose check failed: the exit status is then 1
+static int g_failed = 0;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Same layout as the game: CHUNK_GRID_SIDE^2 chunks around the origin, each
+// in its slot (chunkSlot)
+static Chunk *bench_world(void) {
+    Chunk *chunks = calloc(CHUNK_GRID_SIDE * CHUNK_GRID_SIDE, sizeof(Chunk));
+    int radius = CHUNK_GRID_SIDE / 2;
+    for (int x = -radius; x <= radius; x++) {
+        for (int z = -radius; z <= radius; z++) {
+            generateChunk(&chunks[chunkSlot(x, z)], x, z);
+        }
+    }
+    return chunks;
+}
+
+static void bench_free_world(Chunk *chunks) {
+    for (int i = 0; i < CHUNK_GRID_SIDE * CHUNK_GRID_SIDE; i++) freeChunkData(chunks[i].data);
+    free(chunks);
+}
+
+static int bench_center_chunk(void) {
+    return chunkSlot(0, 0);
+}
+
+// Worst case for face emission: every block is randomly one of a few solid
+// types or air, so almost nothing merges
+static void bench_scramble_chunk(Chunk *chunk, unsigned int seed) {
+    static const BlockType types[] = { BLOCK_AIR, BLOCK_STONE, BLOCK_DIRT, BLOCK_GRASS, BLOCK_SAND, BLOCK_WOOD };
+    srand(seed);
+    for (int x = 0; x < CHUNK_SIZE; x++)
+        for (int y = 0; y < WORLD_HEIGHT; y++)
+            for (int z = 0; z < CHUNK_SIZE; z++)
+                chunk->data->blocks[x][y][z] = createBlock(rand() % 2 ? BLOCK_AIR : types[rand() % 6]);
+}
+
+// Face texture lookup as the mesher used to do it, against the precomputed
+// table, then the whole mesher on a scrambled and on a flat chunk
+static void bench_faces(void) {
+    InitBlockFaceUVTable();
+    const int lookups = 20000000;
+    volatile float sink = 0.0f;
+
+    double t0 = now_seconds();
+    float acc = 0.0f;
+    for (int i = 0; i < lookups; i++) {
+        Rectangle uv = GetTextureRectFromAtlas(GetBlockFaceTexture(2 + (i & 7), i % 6));
+        acc += uv.x + uv.y;
+    }
+    sink = acc;
+    double tSwitch = now_seconds() - t0;
+
+    t0 = now_seconds();
+    acc = 0.0f;
+    for (int i = 0; i < lookups; i++) {
+        FaceUV uv = blockFaceUV[2 + (i & 7)][i % 6];
+        acc += uv.u + uv.v;
+    }
+    sink = acc;
+    double tTable = now_seconds() - t0;
+    (void)sink;
+    printf("faces: uv lookup switch+divide %6.2f ns, table %6.2f ns\n",
+           tSwitch * 1e9 / lookups, tTable * 1e9 / lookups);
+
+    Chunk *chunks = bench_world();
+    int center = bench_center_chunk();
+    const char *labels[2] = { "flat", "scrambled" };
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 1) bench_scramble_chunk(&chunks[center], 1234);
+        const int iterations = pass == 0 ? 200 : 20;
+        for (int ao = 0; ao <= 1; ao++) {
+            SetMeshAmbientOcclusion(ao);
+            long quads = 0;
+            t0 = now_seconds();
+            for (int i = 0; i < iterations; i++) {
+                ReadyMesh *r = mesh_chunk_improved(chunks, center, 0);
+                if (r) { quads += r->vertexCount / 4; FreeReadyMesh(r); }
+            }
+            double t = now_seconds() - t0;
+            printf("faces: %-9s chunk, AO %-3s %8.3f ms/chunk, %7ld quads, %6.2f Mquads/s\n",
+                   labels[pass], ao ? "on" : "off", t * 1e3 / iterations, quads / iterations, quads / t * 1e-6);
+        }
+    }
+    SetMeshAmbientOcclusion(1);
+    bench_free_world(chunks);
+}
+
+// Full lighting of every chunk of the world, then the relight latency of
+// single block edits under open sky
+static void bench_light(void) {
+    Chunk *chunks = bench_world();
+    int total = CHUNK_GRID_SIDE * CHUNK_GRID_SIDE;
+    LightTouched touched;
+    const int passes = 5;
+
+    double t0 = now_seconds();
+    for (int p = 0; p < passes; p++) {
+        for (int i = 0; i < total; i++) chunks[i].lit = 0;
+        for (int i = 0; i < total; i++) LightInitChunk(chunks, &chunks[i], &touched);
+    }
+    double t = now_seconds() - t0;
+    printf("light: init %8.3f ms/chunk (%d chunks)\n", t * 1e3 / (passes * total), total);
+
+    // place then remove a block right above the ground of the center chunk
+    const BlockType placed[2] = { BLOCK_GLOWSTONE, BLOCK_STONE };
+    const char *labels[2] = { "glowstone", "opaque" };
+    const int edits = 200;
+    int y = chunks[bench_center_chunk()].data->heightMap[8][8];
+    for (int k = 0; k < 2; k++) {
+        t0 = now_seconds();
+        for (int i = 0; i < edits; i++) {
+            BlockData old;
+            setBlockAt(chunks, 8, y, 8, createBlock(placed[k]), &old);
+            LightBlockChanged(chunks, 8, y, 8, old, &touched);
+            setBlockAt(chunks, 8, y, 8, createBlock(BLOCK_AIR), &old);
+            LightBlockChanged(chunks, 8, y, 8, old, &touched);
+        }
+        t = now_seconds() - t0;
+        printf("light: edit %-9s %8.3f ms/edit\n", labels[k], t * 1e3 / (2 * edits));
+    }
+
+    // Time until a glowstone edit can be shown (CPU side, the GPU upload is
+    // not measured). Baked light remeshes every chunk whose light changed; the
+    // light volume remeshes the edited chunk only and refills the volumes of
+    // the touched chunks and their neighbours.
+    static unsigned char texels[LIGHT_VOLUME_WIDTH * WORLD_HEIGHT];
+    const char *modes[2] = { "vertex", "volume" };
+    for (int volume = 0; volume <= 1; volume++) {
+        SetMeshLightBaking(!volume);
+        long remeshes = 0, fills = 0, rows = 0;
+        t0 = now_seconds();
+        for (int i = 0; i < edits; i++) {
+            BlockData old;
+            setBlockAt(chunks, 8, y, 8, createBlock(i & 1 ? BLOCK_AIR : BLOCK_GLOWSTONE), &old);
+            LightBlockChanged(chunks, 8, y, 8, old, &touched);
+            if (volume) {
+                Chunk *refill[25];
+                unsigned sections[25];
+                int refillCount = 0;
+                for (int c = 0; c < touched.count; c++) {
+                    for (int dx = -1; dx <= 1; dx++) {
+                        for (int dz = -1; dz <= 1; dz++) {
+                            Chunk *n = findChunk(chunks, touched.chunks[c]->x + dx, touched.chunks[c]->z + dz);
+                            if (!n) continue;
+                            int r = 0;
+                            while (r < refillCount && refill[r] != n) r++;
+                            if (r == refillCount) { refill[refillCount] = n; sections[refillCount++] = 0; }
+                            sections[r] |= touched.sections[c];
+                        }
+                    }
+                }
+                for (int r = 0; r < refillCount; r++) {
+                    int y0 = __builtin_ctz(sections[r]) * CHUNK_SIZE;
+                    int y1 = (32 - __builtin_clz(sections[r])) * CHUNK_SIZE;
+                    LightFillVolume(chunks, refill[r], texels, y0, y1);
+                    rows += y1 - y0;
+                }
+                fills += refillCount;
+                ReadyMesh *r = mesh_chunk_improved(chunks, bench_center_chunk(), 0);
+                if (r) FreeReadyMesh(r);
+                remeshes++;
+            } else {
+                for (int c = 0; c < touched.count; c++) {
+                    ReadyMesh *r = mesh_chunk_improved(chunks, (int)(touched.chunks[c] - chunks), 0);
+                    if (r) FreeReadyMesh(r);
+                }
+                remeshes += touched.count;
+            }
+        }
+        t = now_seconds() - t0;
+        printf("light: update %-6s %8.3f ms/edit, %.1f remeshes", modes[volume], t * 1e3 / edits, (double)remeshes / edits);
+        if (volume) printf(", %.1f volume fills of %.0f rows", (double)fills / edits, (double)rows / fills);
+        printf("\n");
+    }
+    SetMeshLightBaking(1);
+    bench_free_world(chunks);
+}
+
+// Total size of the files in directory, removing them when `clear` is set
+static long bench_directory_bytes(const char *directory, int clear) {
+    long bytes = 0;
+    DIR *dir = opendir(directory);
+    if (!dir) return 0;
+    struct dirent *entry;
+    char path[1024];
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+        snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+        struct stat st;
+        if (stat(path, &st) == 0) bytes += (long)st.st_size;
+        if (clear) remove(path);
+    }
+    closedir(dir);
+    return bytes;
+}
+
+// Save the whole world (as if every chunk had been visited) through region
+// files in a temporary directory, then load it back against regenerating
+// it. Three worlds: untouched, a few edits in one chunk, and one chunk
+// scrambled so it is stored whole.
+static void bench_region(void) {
+    char directory[] = "/tmp/minecraft-bench-XXXXXX";
+    if (!mkdtemp(directory)) { perror("region: mkdtemp"); return; }
+    Chunk *chunks = bench_world();
+    Chunk *loaded = calloc(1, sizeof(Chunk));
+    int total = CHUNK_GRID_SIDE * CHUNK_GRID_SIDE;
+    const int passes = 20;
+    const char *labels[3] = { "untouched", "edited", "scrambled" };
+    printf("region: world of %d chunks, %ld bytes of block data\n", total, (long)total * (long)sizeof(chunks->data->blocks));
+
+    for (int world = 0; world < 3; world++) {
+        if (world == 1) {
+            srand(42);
+            for (int i = 0; i < 32; i++) {
+                BlockData old;
+                setBlockAt(chunks, rand() % 16, 60 + rand() % 10, rand() % 16, createBlock(BLOCK_GLOWSTONE), &old);
+            }
+        }
+        if (world == 2) bench_scramble_chunk(&chunks[bench_center_chunk()], 1234);
+
+        RegionOpenWorld(directory);
+        double t0 = now_seconds();
+        for (int p = 0; p < passes; p++) {
+            for (int i = 0; i < total; i++) RegionSaveChunk(&chunks[i]);
+        }
+        double t = now_seconds() - t0;
+        RegionCloseWorld();
+        long bytes = bench_directory_bytes(directory, 0);
+        printf("region: %-9s save %7.3f ms/chunk, %8ld bytes on disk\n", labels[world], t * 1e3 / (passes * total), bytes);
+
+        RegionOpenWorld(directory);
+        int edited = 0;
+        t0 = now_seconds();
+        for (int p = 0; p < passes; p++) {
+            for (int i = 0; i < total; i++) edited += RegionLoadChunk(loaded, chunks[i].x, chunks[i].z);
+        }
+        t = now_seconds() - t0;
+        RegionCloseWorld();
+        printf("region: %-9s load %7.3f ms/chunk, %d chunks with edits\n", labels[world], t * 1e3 / (passes * total), edited / passes);
+    }
+
+    double t0 = now_seconds();
+    for (int p = 0; p < passes; p++) {
+        for (int i = 0; i < total; i++) generateChunk(loaded, chunks[i].x, chunks[i].z);
+    }
+    double t = now_seconds() - t0;
+    printf("region: generate  %7.3f ms/chunk\n", t * 1e3 / (passes * total));
+
+    bench_directory_bytes(directory, 1);
+    rmdir(directory);
+    freeChunkData(loaded->data);
+    free(loaded);
+    bench_free_world(chunks);
+}
+
+// A chunk coming back into range from the cold tier (residency.h: its blocks
+// through CodecCompress when it left, with its height map kept as is)
+// against reading it from its region file or generating it again. On the
+// generated world, then on a world where every chunk is scrambled, the worst
+// case of the codec (and the case where a region file holds whole chunks).
+static void bench_cold(void) {
+    char directory[] = "/tmp/minecraft-bench-XXXXXX";
+    if (!mkdtemp(directory)) { perror("cold: mkdtemp"); return; }
+    static unsigned char scratch[CODEC_BOUND(sizeof(((ChunkData *)0)->blocks))];
+    Chunk *chunks = bench_world();
+    Chunk *back = calloc(1, sizeof(Chunk));
+    back->data = allocChunkData();
+    int total = CHUNK_GRID_SIDE * CHUNK_GRID_SIDE;
+    unsigned char **cold = calloc(total, sizeof(unsigned char *));
+    size_t *sizes = malloc(total * sizeof(size_t));
+    const int passes = 5;
+    const char *labels[2] = { "generated", "scrambled" };
+
+    for (int world = 0; world < 2; world++) {
+        if (world == 1) {
+            for (int i = 0; i < total; i++) bench_scramble_chunk(&chunks[i], 200 + i);
+        }
+        size_t kept = 0;
+        double t0 = now_seconds();
+        for (int p = 0; p < passes; p++) {
+            for (int i = 0; i < total; i++) {
+                sizes[i] = CodecCompress(chunks[i].data->blocks, sizeof(chunks[i].data->blocks), scratch);
+                free(cold[i]);
+                cold[i] = malloc(sizes[i]);
+                memcpy(cold[i], scratch, sizes[i]);
+            }
+        }
+        double leave = now_seconds() - t0;
+        for (int i = 0; i < total; i++) kept += sizes[i];
+
+        int bad = 0;
+        t0 = now_seconds();
+        for (int p = 0; p < passes; p++) {
+            for (int i = 0; i < total; i++) {
+                bad += CodecDecompress(cold[i], sizes[i], back->data->blocks, sizeof(back->data->blocks)) != sizeof(back->data->blocks);
+                memcpy(back->data->heightMap, chunks[i].data->heightMap, sizeof(back->data->heightMap));
+                memset(back->data->skyLight, 0, sizeof(back->data->skyLight));
+            }
+        }
+        double decode = now_seconds() - t0;
+        bad += memcmp(back->data->blocks, chunks[total - 1].data->blocks, sizeof(back->data->blocks)) != 0;
+
+        RegionOpenWorld(directory);
+        for (int i = 0; i < total; i++) RegionSaveChunk(&chunks[i]);
+        RegionCloseWorld();
+        RegionOpenWorld(directory);
+        t0 = now_seconds();
+        for (int p = 0; p < passes; p++) {
+            for (int i = 0; i < total; i++) RegionLoadChunk(back, chunks[i].x, chunks[i].z);
+        }
+        double region = now_seconds() - t0;
+        RegionCloseWorld();
+        bench_directory_bytes(directory, 1);
+
+        t0 = now_seconds();
+        for (int p = 0; p < passes; p++) {
+            for (int i = 0; i < total; i++) generateChunk(back, chunks[i].x, chunks[i].z);
+        }
+        double generate = now_seconds() - t0;
+
+        double n = (double)passes * total;
+        printf("cold: %-9s leave %7.3f ms/chunk (%6.0f bytes kept), back %7.3f ms/chunk%s; region %7.3f ms, generate %7.3f ms\n",
+               labels[world], leave * 1e3 / n, (double)kept / total, decode * 1e3 / n, bad ? " MISMATCH" : "",
+               region * 1e3 / n, generate * 1e3 / n);
+    }
+
+    rmdir(directory);
+    for (int i = 0; i < total; i++) free(cold[i]);
+    free(cold);
+    free(sizes);
+    freeChunkData(back->data);
+    free(back);
+    bench_free_world(chunks);
+}
+
+// Autosave of a world where every chunk has a few edits: synchronous saving
+// on the calling thread against snapshots handed to the save job, called
+// once per simulated frame with the autosave budget
+static void bench_save(void) {
+    char directory[] = "/tmp/minecraft-bench-XXXXXX";
+    if (!mkdtemp(directory)) { perror("save: mkdtemp"); return; }
+    Chunk *chunks = bench_world();
+    int total = CHUNK_GRID_SIDE * CHUNK_GRID_SIDE;
+    srand(7);
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < total; i++) {
+            for (int e = 0; e < 64; e++) {
+                BlockData old;
+                setBlockAt(chunks, (chunks[i].x << 4) + rand() % 16, 50 + rand() % 20, (chunks[i].z << 4) + rand() % 16,
+                           createBlock(round ? BLOCK_STONE : BLOCK_GLOWSTONE), &old);
+            }
+        }
+
+        RegionOpenWorld(directory);
+        if (round == 0) {
+            double t0 = now_seconds();
+            for (int i = 0; i < total; i++) {
+                RegionSaveChunk(&chunks[i]);
+                chunks[i].dirty = 0;
+            }
+            RegionSync();
+            double t = now_seconds() - t0;
+            printf("save: synchronous %8.3f ms stall for %d chunks\n", t * 1e3, total);
+        } else {
+            JobsInit(-1);
+            InitSaveSystem();
+            double t0 = now_seconds();
+            int frames = 0;
+            // one call per 60 Hz frame, the rest of the frame left to the save job
+            for (;;) {
+                double frameStart = now_seconds();
+                int left = SaveDirtyChunks(chunks, total, SAVE_STALL_BUDGET);
+                frames++;
+                if (left == 0) break;
+                double rest = 1.0 / 60.0 - (now_seconds() - frameStart);
+                if (rest > 0) usleep((useconds_t)(rest * 1e6));
+            }
+            ShutdownSaveSystem();
+            JobsShutdown();
+            double t = now_seconds() - t0;
+            SaveStats stats = GetSaveStats();
+            printf("save: background  %8.3f ms max stall per frame over %d frames, %ld chunks durable after %.3f ms in %ld batches\n",
+                   stats.maxStall * 1e3, frames, stats.chunksSaved, t * 1e3, stats.batches);
+        }
+        RegionCloseWorld();
+    }
+    bench_directory_bytes(directory, 1);
+    rmdir(directory);
+    bench_free_world(chunks);
+}
+
+// Ratio and throughput of the codec on the generated world, then on a world
+// where every chunk is scrambled. Throughputs are in MB of block data (2
+// bytes per block) per second, both ways. "lz" is CodecCompress straight on
+// the block array, "chunk" is CodecEncodeChunk (column runs, then LZ).
+static void bench_codec(void) {
+    Chunk *chunks = bench_world();
+    Chunk *decoded = calloc(1, sizeof(Chunk));
+    decoded->data = allocChunkData();
+    int total = CHUNK_GRID_SIDE * CHUNK_GRID_SIDE;
+    size_t blockBytes = sizeof(chunks->data->blocks);
+    unsigned char *packed = malloc(CODEC_BOUND(blockBytes) > CODEC_CHUNK_BOUND ? CODEC_BOUND(blockBytes) : CODEC_CHUNK_BOUND);
+    size_t *sizes = malloc(total * sizeof(size_t));
+    const int passes = 5;
+    double mb = (double)passes * total * blockBytes / 1e6;
+
+    for (int world = 0; world < 2; world++) {
+        if (world == 1) {
+            for (int i = 0; i < total; i++) bench_scramble_chunk(&chunks[i], 100 + i);
+        }
+        const char *label = world ? "scrambled" : "generated";
+        for (int codec = 0; codec < 2; codec++) {
+            size_t packedBytes = 0;
+            double encode = 0, decode = 0;
+            int bad = 0;
+            for (int i = 0; i < total; i++) {
+                double t0 = now_seconds();
+                for (int p = 0; p < passes; p++) {
+                    sizes[i] = codec ? CodecEncodeChunk(&chunks[i], packed)
+                                     : CodecCompress(chunks[i].data->blocks, blockBytes, packed);
+                }
+                encode += now_seconds() - t0;
+                packedBytes += sizes[i];
+
+                t0 = now_seconds();
+                for (int p = 0; p < passes; p++) {
+                    if (codec) bad += !CodecDecodeChunk(decoded, packed, sizes[i]);
+                    else bad += CodecDecompress(packed, sizes[i], decoded->data->blocks, blockBytes) != blockBytes;
+                }
+                decode += now_seconds() - t0;
+                // the chunk codec leaves the light out
+                for (int b = 0; b < CHUNK_SIZE * WORLD_HEIGHT * CHUNK_SIZE; b++) {
+                    BlockData a = (&chunks[i].data->blocks[0][0][0])[b], d = (&decoded->data->blocks[0][0][0])[b];
+                    if (codec) a.lightLevel = 0;
+                    if (memcmp(&a, &d, sizeof(a)) != 0) { bad++; break; }
+                }
+            }
+            printf("codec: %s %-5s ratio %7.1f:1 (%8zu bytes), encode %7.1f MB/s, decode %7.1f MB/s%s\n",
+                   label, codec ? "chunk" : "lz", (double)total * blockBytes / packedBytes, packedBytes,
+                   mb / encode, mb / decode, bad ? ", ROUNDTRIP MISMATCH" : "");
+        }
+    }
+    free(sizes);
+    free(packed);
+    freeChunkData(decoded->data);
+    free(decoded);
+    bench_free_world(chunks);
+}
+
+// Checksum of every array of a mesh, reading it all once like the upload does
+static unsigned long bench_touch_mesh(const ReadyMesh *r) {
+    unsigned long sum = 0;
+    const unsigned char *arrays[5] = { (const unsigned char *)r->positions, (const unsigned char *)r->normals,
+                                       (const unsigned char *)r->texcoords, (const unsigned char *)r->texcoords2, r->colors };
+    const size_t sizes[5] = { 12, 12, 8, 8, 4 };
+    for (int a = 0; a < 5; a++) {
+        for (size_t i = 0; i < sizes[a] * r->vertexCount; i++) sum = sum * 31 + arrays[a][i];
+    }
+    for (int i = 0; i < r->indexCount; i++) sum = sum * 31 + (r->indices16 ? r->indices16[i] : r->indices[i]);
+    return sum;
+}
+
+// Meshes of a freshly loaded world the way the mesh worker makes them at
+// startup: neighbours lit, then the mesh read from the cache or built and
+// stored. Returns the seconds spent; the upload itself needs a GPU, reading
+// the arrays once stands for it.
+static double bench_startup_meshes(int *hits, unsigned long *checksum) {
+    Chunk *chunks = bench_world();
+    int total = CHUNK_GRID_SIDE * CHUNK_GRID_SIDE;
+    LightTouched touched;
+    *hits = 0;
+    *checksum = 0;
+    double t0 = now_seconds();
+    for (int i = 0; i < total; i++) {
+        for (int dx = -1; dx <= 1; dx++) {
+            for (int dz = -1; dz <= 1; dz++) {
+                Chunk *c = findChunk(chunks, chunks[i].x + dx, chunks[i].z + dz);
+                if (c && !c->lit) LightInitChunk(chunks, c, &touched);
+            }
+        }
+        uint64_t key = MeshInputHash(chunks, i, 0);
+        ReadyMesh *r;
+        if (MeshCacheLoad(chunks[i].x, chunks[i].z, 0, key, i, &r)) {
+            (*hits)++;
+        } else {
+            r = mesh_chunk_improved(chunks, i, 0);
+            MeshCacheStore(chunks[i].x, chunks[i].z, 0, key, r);
+        }
+        if (r) {
+            *checksum += bench_touch_mesh(r);
+            FreeReadyMesh(r);
+        }
+    }
+    double t = now_seconds() - t0;
+    bench_free_world(chunks);
+    return t;
+}
+
+// Time until every chunk of the world has its mesh, with an empty mesh cache
+// then with the one left by the previous run
+static void bench_meshcache(void) {
+    char directory[] = "/tmp/minecraft-bench-XXXXXX";
+    if (!mkdtemp(directory)) { perror("meshcache: mkdtemp"); return; }
+    InitBlockFaceUVTable();
+    SetMeshLightBaking(0); // default light mode, light volumes
+    MeshCacheOpen(directory);
+    int hits;
+    unsigned long cold, warm;
+    double tCold = bench_startup_meshes(&hits, &cold);
+    printf("meshcache: cold cache %8.2f ms for the world, %2d hits, %ld bytes cached\n",
+           tCold * 1e3, hits, bench_directory_bytes(directory, 0));
+    double tWarm = bench_startup_meshes(&hits, &warm);
+    printf("meshcache: warm cache %8.2f ms for the world, %2d hits%s\n",
+           tWarm * 1e3, hits, warm == cold ? "" : ", MESHES DIFFER");
+    bench_directory_bytes(directory, 1);
+    rmdir(directory);
+    MeshCacheOpen(NULL);
+    SetMeshLightBaking(1);
+}
+
+// Finished meshes handed from the workers to the main thread: 8 producer
+// threads push QUEUE_ITEMS items each while the main thread pops, through the
+// mutex stack mesh.c used to have and through the MPSC queue. Reports the cost
+// per item, the longest single pop (a stall of the render thread) and how many
+// items came out before an older one of the same producer.
+#define QUEUE_PRODUCERS 8
+#define QUEUE_ITEMS 200000
+
+typedef struct BenchItem {
+    MpscNode link;
+    struct BenchItem *next;
+    int producer;
+    int sequence;
+} BenchItem;
+
+typedef struct BenchQueue {
+    int lockFree;
+    MpscQueue mpsc;
+    BenchItem *stack;
+    pthread_mutex_t mutex;
+    BenchItem *items; // QUEUE_PRODUCERS * QUEUE_ITEMS
+} BenchQueue;
+
+typedef struct BenchProducer {
+    BenchQueue *queue;
+    int producer;
+} BenchProducer;
+
+static void *bench_queue_producer(void *arg) {
+    BenchProducer *p = arg;
+    BenchQueue *q = p->queue;
+    for (int i = 0; i < QUEUE_ITEMS; i++) {
+        BenchItem *item = &q->items[p->producer * QUEUE_ITEMS + i];
+        item->producer = p->producer;
+        item->sequence = i;
+        if (q->lockFree) {
+            MpscPush(&q->mpsc, &item->link);
+        } else {
+            pthread_mutex_lock(&q->mutex);
+            item->next = q->stack;
+            q->stack = item;
+            pthread_mutex_unlock(&q->mutex);
+        }
+    }
+    return NULL;
+}
+
+static BenchItem *bench_queue_pop(BenchQueue *q) {
+    if (q->lockFree) return (BenchItem *)MpscPop(&q->mpsc); // link is the first member
+    pthread_mutex_lock(&q->mutex);
+    BenchItem *item = q->stack;
+    if (item) q->stack = item->next;
+    pthread_mutex_unlock(&q->mutex);
+    return item;
+}
+
+static void bench_queue(void) {
+    static const char *labels[2] = { "mutex stack", "mpsc fifo" };
+    BenchQueue q;
+    q.items = malloc(sizeof(BenchItem) * QUEUE_PRODUCERS * QUEUE_ITEMS);
+    for (int lockFree = 0; lockFree < 2; lockFree++) {
+        q.lockFree = lockFree;
+        q.stack = NULL;
+        pthread_mutex_init(&q.mutex, NULL);
+        MpscInit(&q.mpsc);
+        int lastSequence[QUEUE_PRODUCERS];
+        for (int i = 0; i < QUEUE_PRODUCERS; i++) lastSequence[i] = -1;
+
+        pthread_t threads[QUEUE_PRODUCERS];
+        BenchProducer producers[QUEUE_PRODUCERS];
+        double t0 = now_seconds();
+        for (int i = 0; i < QUEUE_PRODUCERS; i++) {
+            producers[i] = (BenchProducer){ &q, i };
+            pthread_create(&threads[i], NULL, bench_queue_producer, &producers[i]);
+        }
+        long popped = 0, outOfOrder = 0;
+        double maxPop = 0.0;
+        while (popped < (long)QUEUE_PRODUCERS * QUEUE_ITEMS) {
+            double p0 = now_seconds();
+            BenchItem *item = bench_queue_pop(&q);
+            double p = now_seconds() - p0;
+            if (p > maxPop) maxPop = p;
+            if (!item) continue;
+            if (item->sequence < lastSequence[item->producer]) outOfOrder++;
+            else lastSequence[item->producer] = item->sequence;
+            popped++;
+        }
+        double t = now_seconds() - t0;
+        for (int i = 0; i < QUEUE_PRODUCERS; i++) pthread_join(threads[i], NULL);
+        pthread_mutex_destroy(&q.mutex);
+        printf("queue: %-11s %7.1f ns/item, longest pop %8.3f ms, %ld items out of order\n",
+               labels[lockFree], t * 1e9 / popped, maxPop * 1e3, outOfOrder);
+    }
+    free(q.items);
+}
+
+// Scaling of the job system from 1 thread to one per core (the main thread
+// helps in JobWait, so N threads is JobsInit(N - 1)): chunk generation and
+// meshing of the world split into one job per chunk, and empty jobs for the
+// cost of the scheduler itself, then lighting beside meshing under the light lock
+#define JOBS_GENERATE_PASSES 8
+#define JOBS_MESH_PASSES 4
+#define JOBS_EMPTY 200000
+
+typedef struct BenchChunkJob {
+    Chunk *chunks;
+    int index;
+} BenchChunkJob;
+
+static void bench_generate_job(void *arg) {
+    static _Thread_local Chunk out;
+    BenchChunkJob *job = arg;
+    generateChunk(&out, job->chunks[job->index].x, job->chunks[job->index].z);
+}
+
+static void bench_mesh_job(void *arg) {
+    BenchChunkJob *job = arg;
+    ReadyMesh *r = mesh_chunk_improved(job->chunks, job->index, 0);
+    if (r) FreeReadyMesh(r);
+}
+
+static void bench_empty_job(void *arg) {
+    (void)arg;
+}
+
+// Light jobs beside mesh jobs, locked as in the game (mesh.c g_lightLock):
+// lighting holds the write lock, meshing shares the read lock. The game's
+// lock lets writers go first, the glibc default lets readers in.
+#define JOBS_MESH_PER_LIGHT 3
+
+#ifdef PTHREAD_RWLOCK_WRITER_NONRECURSIVE_INITIALIZER_NP
+#define BENCH_WRITER_LOCK PTHREAD_RWLOCK_WRITER_NONRECURSIVE_INITIALIZER_NP
+#else
+#define BENCH_WRITER_LOCK PTHREAD_RWLOCK_INITIALIZER
+#endif
+
+static pthread_rwlock_t g_benchLocks[2] = { PTHREAD_RWLOCK_INITIALIZER, BENCH_WRITER_LOCK };
+static pthread_rwlock_t *g_benchLock = NULL;
+static double g_longestWrite = 0.0; // longest wait for the write lock, written under it
+
+static void bench_light_job(void *arg) {
+    BenchChunkJob *job = arg;
+    LightTouched touched;
+    double t0 = now_seconds();
+    pthread_rwlock_wrlock(g_benchLock);
+    double wait = now_seconds() - t0;
+    if (wait > g_longestWrite) g_longestWrite = wait;
+    LightInitChunk(job->chunks, &job->chunks[job->index], &touched);
+    pthread_rwlock_unlock(g_benchLock);
+}
+
+static void bench_locked_mesh_job(void *arg) {
+    pthread_rwlock_rdlock(g_benchLock);
+    bench_mesh_job(arg);
+    pthread_rwlock_unlock(g_benchLock);
+}
+
+static void bench_jobs(void) {
+    InitBlockFaceUVTable();
+    Chunk *chunks = bench_world();
+    int total = CHUNK_GRID_SIDE * CHUNK_GRID_SIDE;
+    LightTouched touched;
+    for (int i = 0; i < total; i++) LightInitChunk(chunks, &chunks[i], &touched);
+    int passes = JOBS_GENERATE_PASSES > JOBS_MESH_PASSES ? JOBS_GENERATE_PASSES : JOBS_MESH_PASSES;
+    BenchChunkJob *jobs = malloc(sizeof(BenchChunkJob) * total * passes);
+    for (int i = 0; i < total * passes; i++) jobs[i] = (BenchChunkJob){ chunks, i % total };
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores < 1) cores = 1;
+    double base[4] = {0};
+    for (int threads = 1;; threads *= 2) {
+        if (threads > cores) threads = (int)cores;
+        JobsInit(threads - 1);
+        double rate[2];
+        for (int kind = 0; kind < 2; kind++) {
+            int count = total * (kind ? JOBS_MESH_PASSES : JOBS_GENERATE_PASSES);
+            JobCounter counter = {0};
+            double t0 = now_seconds();
+            for (int i = 0; i < count; i++) {
+                JobSubmit(kind ? bench_mesh_job : bench_generate_job, &jobs[i], JOB_PRIORITY_NORMAL, &counter);
+            }
+            JobWait(&counter);
+            rate[kind] = count / (now_seconds() - t0);
+            if (threads == 1) base[kind] = rate[kind];
+        }
+        JobCounter counter = {0};
+        double t0 = now_seconds();
+        for (int i = 0; i < JOBS_EMPTY; i++) JobSubmit(bench_empty_job, NULL, JOB_PRIORITY_NORMAL, &counter);
+        JobWait(&counter);
+        double empty = (now_seconds() - t0) / JOBS_EMPTY;
+        JobStats stats = GetJobStats();
+        printf("jobs: %2d threads  generate %8.0f chunks/s (x%.2f)  mesh %7.0f chunks/s (x%.2f)  %6.0f ns/empty job, %ld stolen\n",
+               threads, rate[0], rate[0] / base[0], rate[1], rate[1] / base[1], empty * 1e9, stats.stolen);
+        for (int writersFirst = 0; writersFirst < 2; writersFirst++) {
+            g_benchLock = &g_benchLocks[writersFirst];
+            g_longestWrite = 0.0;
+            JobCounter mixed = {0};
+            t0 = now_seconds();
+            for (int i = 0; i < total; i++) {
+                JobSubmit(bench_light_job, &jobs[i], JOB_PRIORITY_NORMAL, &mixed);
+                for (int m = 1; m <= JOBS_MESH_PER_LIGHT; m++) {
+                    JobSubmit(bench_locked_mesh_job, &jobs[(i + m * 7) % total], JOB_PRIORITY_NORMAL, &mixed);
+                }
+            }
+            JobWait(&mixed);
+            double light = total / (now_seconds() - t0);
+            if (threads == 1) base[2 + writersFirst] = light;
+            printf("jobs: %2d threads  light %7.0f chunks/s (x%.2f) beside %d meshes each, %-13s longest write wait %7.3f ms\n",
+                   threads, light, light / base[2 + writersFirst], JOBS_MESH_PER_LIGHT,
+                   writersFirst ? "writers first" : "readers first", g_longestWrite * 1e3);
+        }
+        JobsShutdown();
+        if (threads == cores) break;
+    }
+    free(jobs);
+    bench_free_world(chunks);
+}
+
+// Terrain generator: the noise a chunk needs (a 2D height per column, the 3D
+// density grid) on each backend compiled in, against the scalar one, then
+// whole chunks generated per second on one core, and the relief of the world
+#define TERRAIN_CHUNKS 2000
+
+static void bench_terrain(void) {
+    // as generateChunk: 5 x 33 x 5 density points, 4 blocks apart, stretched in y
+    enum { COLUMNS = CHUNK_SIZE * CHUNK_SIZE, POINTS = 5 * 33 * 5 };
+    static float x[COLUMNS], z[COLUMNS], px[POINTS], py[POINTS], pz[POINTS];
+    static float out[NOISE_BACKEND_COUNT][COLUMNS + POINTS];
+    NoiseParams height = { DEFAULT_WORLD_SEED, 5, 1.0f / 192.0f }, density = { DEFAULT_WORLD_SEED, 3, 1.0f / 32.0f };
+    double scalar = 0.0;
+    for (int b = 0; b < NOISE_BACKEND_COUNT; b++) {
+        if (!NoiseBackendAvailable(b)) continue;
+        double t0 = now_seconds();
+        for (int c = 0; c < TERRAIN_CHUNKS; c++) {
+            for (int i = 0; i < COLUMNS; i++) {
+                x[i] = (float)(c * CHUNK_SIZE + i / CHUNK_SIZE);
+                z[i] = (float)(i % CHUNK_SIZE);
+            }
+            for (int i = 0; i < POINTS; i++) {
+                px[i] = (float)(c * CHUNK_SIZE + i / 165 * 4);
+                py[i] = (float)(i / 5 % 33 * 8);
+                pz[i] = (float)(i % 5 * 4);
+            }
+            NoiseFbm2DOn(b, height, x, z, out[b], COLUMNS);
+            NoiseFbm3DOn(b, density, px, py, pz, out[b] + COLUMNS, POINTS);
+        }
+        double t = (now_seconds() - t0) / TERRAIN_CHUNKS;
+        if (b == NOISE_SCALAR) scalar = t;
+        float diff = 0.0f;
+        for (int i = 0; i < COLUMNS + POINTS; i++) {
+            float d = out[b][i] - out[NOISE_SCALAR][i];
+            if (d < 0) d = -d;
+            if (d > diff) diff = d;
+        }
+        printf("terrain: noise %-6s %7.3f ms/chunk (x%.2f), %6.1f M octave samples/s, max diff to scalar %g\n",
+               NoiseBackendName(b), t * 1e3, scalar / t, (COLUMNS * 5 + POINTS * 3) / t / 1e6, diff);
+    }
+
+    Chunk *chunk = calloc(1, sizeof(Chunk));
+    int lowest = WORLD_HEIGHT, highest = 0, overhangs = 0;
+    double t0 = now_seconds();
+    for (int c = 0; c < TERRAIN_CHUNKS; c++) {
+        generateChunk(chunk, c % 45 - 22, c / 45 - 22);
+    }
+    double t = (now_seconds() - t0) / TERRAIN_CHUNKS;
+    for (int c = 0; c < 100; c++) {
+        generateChunk(chunk, c % 10 * 7, c / 10 * 7);
+        for (int cx = 0; cx < CHUNK_SIZE; cx++) {
+            for (int cz = 0; cz < CHUNK_SIZE; cz++) {
+                int top = chunk->data->heightMap[cx][cz];
+                if (top < lowest) lowest = top;
+                if (top > highest) highest = top;
+                // an air block under the surface, above the ground: an overhang
+                for (int y = top - 2; y > SEA_LEVEL; y--) {
+                    if (chunk->data->blocks[cx][y][cz].Type == BLOCK_AIR) {
+                        overhangs++;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    printf("terrain: generate %.3f ms/chunk, %.0f chunks/s per core (%s); surface y %d to %d, %.1f%% columns under an overhang\n",
+           t * 1e3, 1.0 / t, NoiseBackendName(NoiseBestBackend()), lowest, highest, overhangs / 256.0);
+    freeChunkData(chunk->data);
+    free(chunk);
+}
+
+// Determinism of generation: a square of chunks generated serially, then as
+// one job per chunk on 1 thread up to one per core (at least 4, so threads
+// interleave even on a small machine), submitted in a new shuffled order
+// each time. Every chunk is hashed (blocks and height map); the world hash
+// combines them in coordinate order and must not change, and a second seed
+// must give another world. Either failure makes the bench exit with 1.
+#define DETERMINISM_SIDE 24
+
+typedef struct BenchHashJob {
+    int chunkX, chunkZ;
+    uint64_t hash;
+} BenchHashJob;
+
+static uint64_t bench_fnv(uint64_t hash, const void *bytes, size_t size) {
+    const unsigned char *p = bytes;
+    for (size_t i = 0; i < size; i++) hash = (hash ^ p[i]) * 0x100000001B3ull;
+    return hash;
+}
+
+static void bench_hash_job(void *arg) {
+    static _Thread_local Chunk out;
+    BenchHashJob *job = arg;
+    generateChunk(&out, job->chunkX, job->chunkZ);
+    uint64_t hash = bench_fnv(0xCBF29CE484222325ull, out.data->blocks, sizeof(out.data->blocks));
+    hash = bench_fnv(hash, out.data->heightMap, sizeof(out.data->heightMap));
+    job->hash = hash;
+}
+
+static uint64_t bench_world_hash(const BenchHashJob *jobs, int count) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (int i = 0; i < count; i++) hash = bench_fnv(hash, &jobs[i].hash, sizeof(jobs[i].hash));
+    return hash;
+}
+
+static void bench_determinism(void) {
+    int count = DETERMINISM_SIDE * DETERMINISM_SIDE;
+    BenchHashJob *jobs = malloc(sizeof(BenchHashJob) * count);
+    int *order = malloc(sizeof(int) * count);
+    uint64_t *reference = malloc(sizeof(uint64_t) * count);
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int most = cores > 4 ? (int)cores : 4;
+    uint32_t seeds[2] = { worldSeed(), worldSeed() + 1 };
+    uint64_t worlds[2];
+    unsigned int shuffle = 7;
+
+    for (int s = 0; s < 2; s++) {
+        setWorldSeed(seeds[s]);
+        for (int i = 0; i < count; i++) {
+            jobs[i] = (BenchHashJob){ i / DETERMINISM_SIDE - DETERMINISM_SIDE / 2, i % DETERMINISM_SIDE - DETERMINISM_SIDE / 2, 0 };
+        }
+        double t0 = now_seconds();
+        for (int i = 0; i < count; i++) bench_hash_job(&jobs[i]);
+        double serial = now_seconds() - t0;
+        for (int i = 0; i < count; i++) reference[i] = jobs[i].hash;
+        worlds[s] = bench_world_hash(jobs, count);
+        printf("determinism: seed %08x  serial     world %016llx  %6.0f chunks/s\n",
+               seeds[s], (unsigned long long)worlds[s], count / serial);
+
+        for (int threads = 1;; threads *= 2) {
+            if (threads > most) threads = most;
+            for (int i = 0; i < count; i++) {
+                order[i] = i;
+                jobs[i].hash = 0;
+            }
+            for (int i = count - 1; i > 0; i--) {
+                int j = rand_r(&shuffle) % (i + 1);
+                int tmp = order[i];
+                order[i] = order[j];
+                order[j] = tmp;
+            }
+            JobsInit(threads - 1);
+            JobCounter counter = {0};
+            t0 = now_seconds();
+            for (int i = 0; i < count; i++) JobSubmit(bench_hash_job, &jobs[order[i]], JOB_PRIORITY_NORMAL, &counter);
+            JobWait(&counter);
+            double t = now_seconds() - t0;
+            JobsShutdown();
+            int differ = 0;
+            for (int i = 0; i < count; i++) differ += jobs[i].hash != reference[i];
+            uint64_t world = bench_world_hash(jobs, count);
+            printf("determinism: seed %08x  %2d threads world %016llx  %6.0f chunks/s  %s\n",
+                   seeds[s], threads, (unsigned long long)world, count / t,
+                   differ ? "MISMATCH" : "identical");
+            if (differ) {
+                printf("determinism: %d of %d chunks differ from the serial pass\n", differ, count);
+                g_failed = 1;
+            }
+            if (threads == most) break;
+        }
+    }
+    if (worlds[0] == worlds[1]) {
+        printf("determinism: MISMATCH, both seeds give the same world\n");
+        g_failed = 1;
+    }
+    setWorldSeed(seeds[0]);
+    free(reference);
+    free(order);
+    free(jobs);
+}
+
+// Slab pool (pool.h) against malloc. First alloc/free throughput from 1 thread
+// to one per core, each thread replacing at random the buffers it holds:
+// chunk blocks, and small buffers the size of cold chunks. Then a streaming
+// flight on every core: chunks take the blocks of the chunks they replace,
+// which another thread allocated, the leaving ones go to a bounded cold tier
+// of buffers of random size, a few get save snapshots; the resident set is
+// sampled along the way. POOL_FLIGHT_SECONDS sets the length of each flight
+// (3600 for the one-hour run).
+#define POOL_FLIGHT_SECONDS 10
+#define POOL_HELD_BLOCKS 8
+#define POOL_HELD_SMALL 256
+#define POOL_OPERATIONS 200000
+#define POOL_COLD_CHUNKS 512
+#define POOL_SNAPSHOTS 32
+
+typedef struct BenchAllocator {
+    const char *name;
+    void *(*alloc)(size_t size);
+    void (*free)(void *ptr, size_t size);
+} BenchAllocator;
+
+static void *bench_malloc(size_t size) {
+    return malloc(size);
+}
+
+static void bench_malloc_free(void *ptr, size_t size) {
+    (void)size;
+    free(ptr);
+}
+
+static const BenchAllocator bench_allocators[2] = {
+    { "malloc", bench_malloc, bench_malloc_free },
+    { "pool", PoolAlloc, PoolFree },
+};
+
+// Cold chunks: from an all-air chunk to a scrambled one (bench cold)
+static size_t bench_cold_size(unsigned int *seed) {
+    return 256 + rand_r(seed) % 36000;
+}
+
+typedef struct BenchPoolThread {
+    const BenchAllocator *allocator;
+    unsigned int seed;
+    double seconds;
+} BenchPoolThread;
+
+static void *bench_pool_churn(void *arg) {
+    BenchPoolThread *t = arg;
+    void *blocks[POOL_HELD_BLOCKS] = {0};
+    void *small[POOL_HELD_SMALL] = {0};
+    size_t smallSizes[POOL_HELD_SMALL] = {0};
+    double t0 = now_seconds();
+    for (int i = 0; i < POOL_OPERATIONS; i++) {
+        int k = rand_r(&t->seed);
+        if (k % 16 == 0) {
+            void **b = &blocks[k / 16 % POOL_HELD_BLOCKS];
+            t->allocator->free(*b, sizeof(ChunkData));
+            *b = t->allocator->alloc(sizeof(ChunkData));
+            *(volatile char *)*b = 1;
+        } else {
+            int j = k / 16 % POOL_HELD_SMALL;
+            t->allocator->free(small[j], smallSizes[j]);
+            smallSizes[j] = bench_cold_size(&t->seed);
+            small[j] = t->allocator->alloc(smallSizes[j]);
+            *(volatile char *)small[j] = 1;
+        }
+    }
+    t->seconds = now_seconds() - t0;
+    for (int i = 0; i < POOL_HELD_BLOCKS; i++) t->allocator->free(blocks[i], sizeof(ChunkData));
+    for (int i = 0; i < POOL_HELD_SMALL; i++) t->allocator->free(small[i], smallSizes[i]);
+    return NULL;
+}
+
+// Shared by the flight threads: every buffer swapped in takes the place of
+// one another thread may have allocated, which is freed by the one swapping
+typedef struct BenchFlight {
+    const BenchAllocator *allocator;
+    void **chunks;
+    void **cold;
+    size_t *coldSizes;
+    void **snapshots;
+    long step;
+    double end;
+} BenchFlight;
+
+typedef struct BenchFlightThread {
+    BenchFlight *flight;
+    unsigned int seed;
+} BenchFlightThread;
+
+static void *bench_pool_flight(void *arg) {
+    BenchFlightThread *t = arg;
+    BenchFlight *f = t->flight;
+    const BenchAllocator *a = f->allocator;
+    int total = CHUNK_GRID_SIDE * CHUNK_GRID_SIDE;
+    while (now_seconds() < f->end) {
+        long step = __atomic_fetch_add(&f->step, 1, __ATOMIC_RELAXED);
+        // the chunk coming into range is generated in its own blocks
+        void *data = a->alloc(sizeof(ChunkData));
+        memset(data, (int)step, sizeof(ChunkData));
+        void *left = __atomic_exchange_n(&f->chunks[step % total], data, __ATOMIC_ACQ_REL);
+        if (left) {
+            // the one leaving goes to the cold tier, in place of the oldest
+            size_t size = bench_cold_size(&t->seed);
+            unsigned char *cold = a->alloc(size);
+            memset(cold, 0, size);
+            memcpy(cold, &size, sizeof(size));
+            unsigned char *oldest = __atomic_exchange_n(&f->cold[step % POOL_COLD_CHUNKS], cold, __ATOMIC_ACQ_REL);
+            if (oldest) {
+                memcpy(&size, oldest, sizeof(size));
+                a->free(oldest, size);
+            }
+            a->free(left, sizeof(ChunkData));
+        }
+        if (step % 8 == 0) {
+            void *snapshot = a->alloc(sizeof(ChunkData));
+            memcpy(snapshot, data, sizeof(ChunkData));
+            void *saved = __atomic_exchange_n(&f->snapshots[step / 8 % POOL_SNAPSHOTS], snapshot, __ATOMIC_ACQ_REL);
+            a->free(saved, sizeof(ChunkData));
+        }
+    }
+    return NULL;
+}
+
+// Resident set of the process, 0 where /proc is missing
+static double bench_rss_mb(void) {
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (!f) return 0.0;
+    long size = 0, resident = 0;
+    if (fscanf(f, "%ld %ld", &size, &resident) != 2) resident = 0;
+    fclose(f);
+    return (double)resident * sysconf(_SC_PAGESIZE) / 1048576.0;
+}
+
+static void bench_pool(void) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores < 1) cores = 1;
+    pthread_t *threads = malloc(sizeof(pthread_t) * cores);
+    BenchPoolThread *churn = malloc(sizeof(BenchPoolThread) * cores);
+
+    for (int n = 1;; n *= 2) {
+        if (n > cores) n = (int)cores;
+        double rate[2];
+        for (int k = 0; k < 2; k++) {
+            for (int i = 0; i < n; i++) {
+                churn[i] = (BenchPoolThread){ &bench_allocators[k], 1234u + i, 0.0 };
+                pthread_create(&threads[i], NULL, bench_pool_churn, &churn[i]);
+            }
+            double slowest = 0.0;
+            for (int i = 0; i < n; i++) {
+                pthread_join(threads[i], NULL);
+                if (churn[i].seconds > slowest) slowest = churn[i].seconds;
+            }
+            rate[k] = (double)n * POOL_OPERATIONS / slowest;
+        }
+        printf("pool: %2d threads  malloc %6.2f M alloc+free/s  pool %6.2f M/s (x%.2f)\n",
+               n, rate[0] / 1e6, rate[1] / 1e6, rate[1] / rate[0]);
+        if (n == cores) break;
+    }
+
+    const char *secondsText = getenv("POOL_FLIGHT_SECONDS");
+    double seconds = secondsText && atof(secondsText) > 0 ? atof(secondsText) : POOL_FLIGHT_SECONDS;
+    int total = CHUNK_GRID_SIDE * CHUNK_GRID_SIDE;
+    BenchFlightThread *flyers = malloc(sizeof(BenchFlightThread) * cores);
+    for (int k = 0; k < 2; k++) {
+        BenchFlight flight = { &bench_allocators[k], calloc(total, sizeof(void *)),
+                               calloc(POOL_COLD_CHUNKS, sizeof(void *)), NULL,
+                               calloc(POOL_SNAPSHOTS, sizeof(void *)), 0, 0.0 };
+        double start = bench_rss_mb();
+        double t0 = now_seconds();
+        flight.end = t0 + seconds;
+        for (int i = 0; i < cores; i++) {
+            flyers[i] = (BenchFlightThread){ &flight, 99u + i };
+            pthread_create(&threads[i], NULL, bench_pool_flight, &flyers[i]);
+        }
+        // warm once the world and the cold tier are full: from then on, what
+        // the resident set gains is fragmentation
+        double warm = 0.0, peak = 0.0, last = 0.0;
+        int samples = 0;
+        while (now_seconds() < flight.end) {
+            sleep(1);
+            last = bench_rss_mb() - start;
+            if (last > peak) peak = last;
+            if (now_seconds() - t0 >= seconds / 4 && samples++ == 0) warm = last;
+        }
+        for (int i = 0; i < cores; i++) pthread_join(threads[i], NULL);
+        double elapsed = now_seconds() - t0;
+        printf("pool: flight %-6s %.0f s, %ld chunks (%.0f/s)  rss +%.1f MB warm, +%.1f MB peak, +%.1f MB end (drift %+.1f MB)\n",
+               flight.allocator->name, elapsed, flight.step, flight.step / elapsed, warm, peak, last, last - warm);
+        for (int i = 0; i < total; i++) flight.allocator->free(flight.chunks[i], sizeof(ChunkData));
+        for (int i = 0; i < POOL_COLD_CHUNKS; i++) {
+            size_t size;
+            if (!flight.cold[i]) continue;
+            memcpy(&size, flight.cold[i], sizeof(size));
+            flight.allocator->free(flight.cold[i], size);
+        }
+        for (int i = 0; i < POOL_SNAPSHOTS; i++) flight.allocator->free(flight.snapshots[i], sizeof(ChunkData));
+        free(flight.chunks);
+        free(flight.cold);
+        free(flight.snapshots);
+    }
+    PoolStats stats = GetPoolStats();
+    printf("pool: %d slabs (%d huge pages), %.1f MB reserved, %.1f MB still used\n",
+           stats.slabs, stats.hugePages, stats.reserved / 1048576.0, stats.used / 1048576.0);
+    free(flyers);
+    free(churn);
+    free(threads);
+}
+
+static const Benchmark benchmarks[] = {
+    { "faces", bench_faces },
+    { "light", bench_light },
+    { "region", bench_region },
+    { "save", bench_save },
+    { "codec", bench_codec },
+    { "cold", bench_cold },
+    { "meshcache", bench_meshcache },
+    { "queue", bench_queue },
+    { "jobs", bench_jobs },
+    { "terrain", bench_terrain },
+    { "determinism", bench_determinism },
+    { "pool", bench_pool },
+};
+
+int main(int argc, char **argv) {
+    // as in the game
+    PoolInit(1);
+    int count = (int)(sizeof(benchmarks) / sizeof(benchmarks[0]));
+    for (int i = 0; i < count; i++) {
+        int selected = argc < 2;
+        for (int a = 1; a < argc; a++) {
+            if (strcmp(argv[a], benchmarks[i].name) == 0) selected = 1;
+        }
+        if (selected) benchmarks[i].run();
+    }
+    return g_failed;
+}
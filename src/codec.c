@@ -0,0 +1,204 @@
+#include "codec.h"
+#include "data.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CODEC_MIN_MATCH 4
+#define CODEC_MAX_OFFSET 65535
+#define CODEC_HASH_BITS 12
+
+#define CHUNK_BLOCKS (CHUNK_SIZE * WORLD_HEIGHT * CHUNK_SIZE)
+
+static inline uint32_t read32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline unsigned hash4(uint32_t v) {
+    return (v * 2654435761u) >> (32 - CODEC_HASH_BITS);
+}
+
+// Lengths past the 4 bits of the token continue as bytes of 255 and a last
+// byte below 255
+static unsigned char *put_length(unsigned char *op, size_t length) {
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = (unsigned char)length;
+    return op;
+}
+
+static int get_length(const unsigned char **ip, const unsigned char *end, size_t *length) {
+    unsigned char b;
+    do {
+        if (*ip >= end) return 0;
+        b = *(*ip)++;
+        *length += b;
+    } while (b == 255);
+    return 1;
+}
+
+static unsigned char *put_sequence(unsigned char *op, const unsigned char *literals, size_t literalCount,
+                                   size_t offset, size_t matchLength) {
+    unsigned char *token = op++;
+    size_t match = matchLength - CODEC_MIN_MATCH;
+    *token = (unsigned char)(((literalCount < 15 ? literalCount : 15) << 4) | (match < 15 ? match : 15));
+    if (literalCount >= 15) op = put_length(op, literalCount - 15);
+    memcpy(op, literals, literalCount);
+    op += literalCount;
+    *op++ = (unsigned char)(offset & 0xff);
+    *op++ = (unsigned char)(offset >> 8);
+    if (match >= 15) op = put_length(op, match - 15);
+    return op;
+}
+
+size_t CodecCompress(const void *input, size_t size, void *output) {
+    const unsigned char *in = input, *end = in + size;
+    const unsigned char *ip = in, *anchor = in;
+    unsigned char *op = output;
+    // last position seen for each hash of 4 bytes; stale or colliding entries
+    // are caught by comparing the bytes
+    uint32_t table[1 << CODEC_HASH_BITS];
+    memset(table, 0, sizeof(table));
+
+    while (ip + CODEC_MIN_MATCH <= end) {
+        uint32_t sequence = read32(ip);
+        unsigned h = hash4(sequence);
+        const unsigned char *ref = in + table[h];
+        table[h] = (uint32_t)(ip - in);
+        if (ref >= ip || ip - ref > CODEC_MAX_OFFSET || read32(ref) != sequence) {
+            // skip faster through data that does not compress
+            ip += 1 + ((size_t)(ip - anchor) >> 6);
+            continue;
+        }
+        size_t length = CODEC_MIN_MATCH;
+        while (ip + length < end && ref[length] == ip[length]) length++;
+        op = put_sequence(op, anchor, (size_t)(ip - anchor), (size_t)(ip - ref), length);
+        ip += length;
+        anchor = ip;
+        // keep the end of the match findable, runs restart right after it
+        if (ip - 2 >= in && ip + 2 <= end) table[hash4(read32(ip - 2))] = (uint32_t)(ip - 2 - in);
+    }
+
+    // the last sequence only has literals
+    size_t literalCount = (size_t)(end - anchor);
+    *op++ = (unsigned char)((literalCount < 15 ? literalCount : 15) << 4);
+    if (literalCount >= 15) op = put_length(op, literalCount - 15);
+    memcpy(op, anchor, literalCount);
+    op += literalCount;
+    return (size_t)(op - (unsigned char *)output);
+}
+
+size_t CodecDecompress(const void *input, size_t size, void *output, size_t capacity) {
+    const unsigned char *ip = input, *end = ip + size;
+    unsigned char *out = output, *op = out, *outEnd = out + capacity;
+    while (ip < end) {
+        unsigned token = *ip++;
+        size_t literalCount = token >> 4;
+        if (literalCount == 15 && !get_length(&ip, end, &literalCount)) return 0;
+        if ((size_t)(end - ip) < literalCount || (size_t)(outEnd - op) < literalCount) return 0;
+        memcpy(op, ip, literalCount);
+        op += literalCount;
+        ip += literalCount;
+        if (ip == end) break;
+
+        if (end - ip < 2) return 0;
+        size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        size_t length = token & 15;
+        if (length == 15 && !get_length(&ip, end, &length)) return 0;
+        length += CODEC_MIN_MATCH;
+        if (offset == 0 || offset > (size_t)(op - out) || (size_t)(outEnd - op) < length) return 0;
+        const unsigned char *ref = op - offset;
+        if (offset >= length) {
+            memcpy(op, ref, length);
+            op += length;
+        } else {
+            // overlapping copy: a short pattern repeated (runs)
+            for (size_t i = 0; i < length; i++) *op++ = *ref++;
+        }
+    }
+    return (size_t)(op - out);
+}
+
+// Block as serialized: light is left out, it is recomputed from the blocks
+static inline uint16_t block_bits(BlockData b) {
+    b.lightLevel = 0;
+    uint16_t value;
+    memcpy(&value, &b, sizeof(value));
+    return value;
+}
+
+static inline unsigned char *put_run(unsigned char *op, int count, uint16_t value) {
+    *op++ = (unsigned char)(count - 1);
+    memcpy(op, &value, 2);
+    return op + 2;
+}
+
+// Stage 1: every column from the bottom up as (count - 1, value) runs of 3
+// bytes, columns in x then z order
+static size_t encode_columns(const Chunk *chunk, unsigned char *out) {
+    unsigned char *op = out;
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+        for (int z = 0; z < CHUNK_SIZE; z++) {
+            uint16_t previous = block_bits(chunk->data->blocks[x][0][z]);
+            int count = 1;
+            for (int y = 1; y < WORLD_HEIGHT; y++) {
+                uint16_t value = block_bits(chunk->data->blocks[x][y][z]);
+                if (value != previous) {
+                    op = put_run(op, count, previous);
+                    previous = value;
+                    count = 0;
+                }
+                count++;
+            }
+            op = put_run(op, count, previous);
+        }
+    }
+    return (size_t)(op - out);
+}
+
+static int decode_columns(Chunk *chunk, const unsigned char *in, size_t size) {
+    const unsigned char *ip = in, *end = in + size;
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+        for (int z = 0; z < CHUNK_SIZE; z++) {
+            int y = 0;
+            while (y < WORLD_HEIGHT) {
+                if (end - ip < 3) return 0;
+                int count = ip[0] + 1;
+                BlockData b;
+                memcpy(&b, ip + 1, sizeof(b));
+                ip += 3;
+                if (y + count > WORLD_HEIGHT) return 0;
+                for (int i = 0; i < count; i++) chunk->data->blocks[x][y + i][z] = b;
+                y += count;
+            }
+        }
+    }
+    return ip == end;
+}
+
+size_t CodecEncodeChunk(const Chunk *chunk, void *out) {
+    unsigned char *columns = malloc(3 * CHUNK_BLOCKS);
+    if (!columns) return 0;
+    size_t size = CodecCompress(columns, encode_columns(chunk, columns), out);
+    free(columns);
+    return size;
+}
+
+int CodecDecodeChunk(Chunk *chunk, const void *in, size_t size) {
+    unsigned char *columns = malloc(3 * CHUNK_BLOCKS);
+    if (!columns) return 0;
+    size_t columnsSize = CodecDecompress(in, size, columns, 3 * CHUNK_BLOCKS);
+    int ok = columnsSize > 0 && decode_columns(chunk, columns, columnsSize);
+    free(columns);
+    if (ok) {
+        computeHeightMap(chunk);
+        computeBlockHash(chunk);
+    }
+    return ok;
+}
@@ -0,0 +1,35 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include "data.h"
+
+#include <stddef.h>
+
+// Self-contained compression for chunk data, usable by the world saves and by
+// anything that ships chunks elsewhere. CodecCompress is a byte-level LZ77
+// codec (LZ4-like sequences: token, literals, 16 bit offset, match length)
+// with a 64 KiB window. CodecEncodeChunk serializes the blocks of a chunk as
+// runs along each Y column, which turns the terrain into a few runs per
+// column, then compresses those runs with CodecCompress so that neighbouring
+// columns with the same profile cost a few bytes each.
+
+// Largest output of CodecCompress for `size` input bytes
+#define CODEC_BOUND(size) ((size) + (size) / 255 + 16)
+// Largest output of CodecEncodeChunk: one (count, value) run per block
+#define CODEC_CHUNK_BOUND CODEC_BOUND(3 * CHUNK_SIZE * WORLD_HEIGHT * CHUNK_SIZE)
+
+// Compress `size` bytes into out, which must hold CODEC_BOUND(size) bytes.
+// Returns the compressed size.
+size_t CodecCompress(const void *in, size_t size, void *out);
+// Decompress into out (at most `capacity` bytes). Returns the decompressed
+// size, 0 when the input is corrupted or does not fit.
+size_t CodecDecompress(const void *in, size_t size, void *out, size_t capacity);
+
+// Serialize the blocks of chunk (light left out) into out, which must hold
+// CODEC_CHUNK_BOUND bytes. Returns the encoded size.
+size_t CodecEncodeChunk(const Chunk *chunk, void *out);
+// Fill the blocks, the height map and the block hashes of chunk. 0 when the
+// data is corrupted.
+int CodecDecodeChunk(Chunk *chunk, const void *in, size_t size);
+
+#endif // CODEC_H
@@ -1,5 +1,7 @@
 #include "data.h"
 #include "atlas.h"
+#include "pool.h"
+#include "noise.h"
 #include "raymath.h"
 #include "rlgl.h"
 #include <stdio.h>
@@ -67,6 +69,13 @@ BlockData createBlock(BlockType type)
         blockData.visible = 1;
         break;
 
+    case BLOCK_GLOWSTONE:
+        blockData.lightLevel = 0; // la lumière émise est posée par le moteur de lumière
+        blockData.gravity = 0;
+        blockData.solid = 1;
+        blockData.visible = 1;
+        break;
+
     default:
         fprintf(stderr, "createBlock: Unknown block type %d\n", type);
         exit(1);
@@ -75,38 +84,336 @@ BlockData createBlock(BlockType type)
     return blockData;
 }
 
+// Niveau de lumière émis par un type de bloc (0 = n'émet pas)
+int blockEmission(BlockType type)
+{
+    switch (type)
+    {
+    case BLOCK_GLOWSTONE:
+        return 15;
+    default:
+        return 0;
+    }
+}
+
+// Terrain : une hauteur par colonne (bruit 2D sur plusieurs octaves), que
+// déforme une densité 3D pour former des surplombs. Un bloc est plein quand
+// (hauteur - y) + OVERHANG_DEPTH * densité > 0 : la densité n'agit qu'à moins
+// de OVERHANG_DEPTH blocs de la surface. Elle est échantillonnée tous les
+// DENSITY_STEP_XZ blocs en x et z et DENSITY_STEP_Y en y, puis interpolée
+// (trilinéaire) : 825 points de bruit par chunk au lieu de 32768.
+#define TERRAIN_BASE 70.0f
+#define TERRAIN_AMPLITUDE 64.0f
+#define HEIGHT_OCTAVES 5
+#define HEIGHT_FREQUENCY (1.0f / 192.0f)
+#define DENSITY_OCTAVES 3
+#define DENSITY_FREQUENCY (1.0f / 32.0f)
+#define DENSITY_SEED 0x3D3D3D3Du
+#define OVERHANG_DEPTH 24.0f
+// La densité varie plus vite en hauteur qu'à l'horizontale : des corniches
+// plutôt que des bulles
+#define DENSITY_STRETCH_Y 2.0f
+#define DENSITY_STEP_XZ 4
+#define DENSITY_STEP_Y 4
+#define DENSITY_SIDE (CHUNK_SIZE / DENSITY_STEP_XZ + 1)
+#define DENSITY_LEVELS (WORLD_HEIGHT / DENSITY_STEP_Y + 1)
+#define BEDROCK_LAYERS 4
+#define DIRT_LAYERS 3
+
+static uint32_t g_worldSeed = DEFAULT_WORLD_SEED;
+
+// Avant de générer le moindre chunk
+void setWorldSeed(uint32_t seed)
+{
+    g_worldSeed = seed;
+}
+
+uint32_t worldSeed(void)
+{
+    return g_worldSeed;
+}
+
+static NoiseParams heightNoise(void)
+{
+    return (NoiseParams){ g_worldSeed, HEIGHT_OCTAVES, HEIGHT_FREQUENCY };
+}
+
+static NoiseParams densityNoise(void)
+{
+    return (NoiseParams){ g_worldSeed ^ DENSITY_SEED, DENSITY_OCTAVES, DENSITY_FREQUENCY };
+}
+
+static float columnHeight(float noise)
+{
+    return TERRAIN_BASE + TERRAIN_AMPLITUDE * noise;
+}
+
+// Plus haut bloc plein d'une colonne sans surplomb (densité nulle)
+static int columnTop(float height)
+{
+    return (int)ceilf(height) - 1;
+}
+
+static BlockType surfaceBlock(int y)
+{
+    return y <= SEA_LEVEL + 1 ? BLOCK_SAND : BLOCK_GRASS;
+}
+
+static int terrainTopAt(int worldX, int worldZ)
+{
+    float x = (float)worldX, z = (float)worldZ, noise;
+    NoiseFbm2D(heightNoise(), &x, &z, &noise, 1);
+    return columnTop(columnHeight(noise));
+}
+
+// Hauteur de la surface d'une colonne générée (l'eau comprise, les surplombs
+// non), sans avoir à générer le chunk. Sert au terrain lointain (horizon)
+// pour les zones non chargées.
+int terrainHeightAt(int worldX, int worldZ)
+{
+    int top = terrainTopAt(worldX, worldZ);
+    return top < SEA_LEVEL ? SEA_LEVEL : top;
+}
+
+// Type du bloc de surface d'une colonne générée
+BlockType terrainTopBlockAt(int worldX, int worldZ)
+{
+    int top = terrainTopAt(worldX, worldZ);
+    return top < SEA_LEVEL ? BLOCK_WATER : surfaceBlock(top);
+}
+
+// Octets alloués pour les blocs des chunks (modifié atomiquement)
+static size_t g_chunkDataBytes = 0;
+
+// Blocs d'un chunk, alloués à part du tableau des chunks : un chunk évincé
+// (pour tenir le budget mémoire) rend les siens. Ils viennent du pool : un
+// chunk qui arrive reprend ceux d'un chunk parti
+ChunkData *allocChunkData(void)
+{
+    ChunkData *data = PoolAlloc(sizeof(ChunkData));
+    if (data != NULL) __atomic_add_fetch(&g_chunkDataBytes, sizeof(ChunkData), __ATOMIC_RELAXED);
+    return data;
+}
+
+void freeChunkData(ChunkData *data)
+{
+    if (data == NULL) return;
+    __atomic_sub_fetch(&g_chunkDataBytes, sizeof(ChunkData), __ATOMIC_RELAXED);
+    PoolFree(data, sizeof(ChunkData));
+}
+
+size_t chunkDataBytes(void)
+{
+    return __atomic_load_n(&g_chunkDataBytes, __ATOMIC_RELAXED);
+}
+
+// Densité de la colonne (x, z) aux niveaux first à last de la grille,
+// interpolée entre les 4 colonnes de la grille qui l'entourent. Entre deux
+// niveaux, elle est interpolée en y : l'interpolation trilinéaire, faite
+// une fois par niveau plutôt qu'une fois par bloc.
+static void densityColumn(const float density[DENSITY_SIDE][DENSITY_LEVELS][DENSITY_SIDE], int x, int z,
+                          int first, int last, float *column)
+{
+    int gx = x / DENSITY_STEP_XZ, gz = z / DENSITY_STEP_XZ;
+    float tx = (float)(x % DENSITY_STEP_XZ) / DENSITY_STEP_XZ;
+    float tz = (float)(z % DENSITY_STEP_XZ) / DENSITY_STEP_XZ;
+    for (int gy = first; gy <= last; gy++)
+    {
+        column[gy] = Lerp(Lerp(density[gx][gy][gz], density[gx + 1][gy][gz], tx),
+                          Lerp(density[gx][gy][gz + 1], density[gx + 1][gy][gz + 1], tx), tz);
+    }
+}
+
 void generateChunk(Chunk *chunk, int chunkX, int chunkZ)
 {
+    if (chunk->data == NULL) chunk->data = allocChunkData();
     chunk->x = chunkX;
     chunk->z = chunkZ;
-    // Pour l'instant, générons un terrain plat simple
-    for (int x = 0; x < 16; x++)
+    chunk->lit = 0;
+    chunk->dirty = 0;
+    chunk->version = 0;
+    memset(chunk->data->skyLight, 0, sizeof(chunk->data->skyLight));
+
+    // Hauteur des 256 colonnes, en un seul lot de bruit
+    float columnX[CHUNK_SIZE * CHUNK_SIZE], columnZ[CHUNK_SIZE * CHUNK_SIZE], heights[CHUNK_SIZE * CHUNK_SIZE];
+    for (int x = 0; x < CHUNK_SIZE; x++)
     {
-        for (int z = 0; z < 16; z++)
+        for (int z = 0; z < CHUNK_SIZE; z++)
+        {
+            columnX[x * CHUNK_SIZE + z] = (float)((chunkX << 4) + x);
+            columnZ[x * CHUNK_SIZE + z] = (float)((chunkZ << 4) + z);
+        }
+    }
+    NoiseFbm2D(heightNoise(), columnX, columnZ, heights, CHUNK_SIZE * CHUNK_SIZE);
+
+    // Densité aux points de la grille grossière (les bords sont partagés avec
+    // les chunks voisins, qui calculent les mêmes valeurs)
+    enum { DENSITY_POINTS = DENSITY_SIDE * DENSITY_LEVELS * DENSITY_SIDE };
+    float pointX[DENSITY_POINTS], pointY[DENSITY_POINTS], pointZ[DENSITY_POINTS];
+    float density[DENSITY_SIDE][DENSITY_LEVELS][DENSITY_SIDE];
+    int point = 0;
+    for (int x = 0; x < DENSITY_SIDE; x++)
+    {
+        for (int y = 0; y < DENSITY_LEVELS; y++)
         {
-            for (int y = 0; y < 128; y++)
+            for (int z = 0; z < DENSITY_SIDE; z++)
             {
-                if (y > 64)
+                pointX[point] = (float)((chunkX << 4) + x * DENSITY_STEP_XZ);
+                pointY[point] = (float)(y * DENSITY_STEP_Y) * DENSITY_STRETCH_Y;
+                pointZ[point] = (float)((chunkZ << 4) + z * DENSITY_STEP_XZ);
+                point++;
+            }
+        }
+    }
+    NoiseFbm3D(densityNoise(), pointX, pointY, pointZ, &density[0][0][0], DENSITY_POINTS);
+
+    // Les quelques types du terrain, construits une fois plutôt qu'à chaque bloc
+    static const BlockType terrainTypes[] = { BLOCK_AIR, BLOCK_WATER, BLOCK_BEDROCK, BLOCK_STONE, BLOCK_DIRT, BLOCK_GRASS, BLOCK_SAND };
+    BlockData block[BLOCK_BREAKING + 1];
+    for (int i = 0; i < (int)(sizeof(terrainTypes) / sizeof(terrainTypes[0])); i++)
+    {
+        block[terrainTypes[i]] = createBlock(terrainTypes[i]);
+    }
+
+    for (int x = 0; x < CHUNK_SIZE; x++)
+    {
+        for (int z = 0; z < CHUNK_SIZE; z++)
+        {
+            float height = columnHeight(heights[x * CHUNK_SIZE + z]);
+            float column[DENSITY_LEVELS];
+            int first = (int)(height - OVERHANG_DEPTH) / DENSITY_STEP_Y;
+            int last = (int)(height + OVERHANG_DEPTH) / DENSITY_STEP_Y + 1;
+            first = first < 0 ? 0 : first;
+            last = last >= DENSITY_LEVELS ? DENSITY_LEVELS - 1 : last;
+            densityColumn(density, x, z, first, last, column);
+            // De haut en bas : la profondeur sous le dernier bloc vide choisit
+            // la couche (surface, terre, pierre)
+            int depth = -1;
+            int top = 0;
+            BlockType surface = BLOCK_GRASS;
+            for (int y = WORLD_HEIGHT - 1; y >= 0; y--)
+            {
+                int solid;
+                if (y < BEDROCK_LAYERS) solid = 1;
+                else if (y > height + OVERHANG_DEPTH) solid = 0;
+                else if (y < height - OVERHANG_DEPTH) solid = 1;
+                else
+                {
+                    int gy = y / DENSITY_STEP_Y;
+                    float d = Lerp(column[gy], column[gy + 1], (float)(y % DENSITY_STEP_Y) / DENSITY_STEP_Y);
+                    solid = (height - y) + OVERHANG_DEPTH * d > 0.0f;
+                }
+
+                BlockType type;
+                if (!solid)
                 {
-                    chunk->data.blocks[x][y][z] = createBlock(BLOCK_AIR);
+                    depth = -1;
+                    type = y <= SEA_LEVEL ? BLOCK_WATER : BLOCK_AIR;
                 }
-                else if (y == 64)
+                else if (y < BEDROCK_LAYERS)
                 {
-                    chunk->data.blocks[x][y][z] = createBlock(BLOCK_GRASS);
+                    type = BLOCK_BEDROCK;
                 }
-                else if (y >= 60)
+                else if (++depth == 0)
                 {
-                    chunk->data.blocks[x][y][z] = createBlock(BLOCK_DIRT);
+                    surface = surfaceBlock(y);
+                    type = surface;
                 }
-                else if (y >= 4)
+                else if (depth <= DIRT_LAYERS)
                 {
-                    chunk->data.blocks[x][y][z] = createBlock(BLOCK_STONE);
+                    type = surface == BLOCK_SAND ? BLOCK_SAND : BLOCK_DIRT;
                 }
                 else
                 {
-                    chunk->data.blocks[x][y][z] = createBlock(BLOCK_BEDROCK);
+                    type = BLOCK_STONE;
                 }
+                if (top == 0 && type != BLOCK_AIR) top = y + 1;
+                chunk->data->blocks[x][y][z] = block[type];
             }
+            chunk->data->heightMap[x][z] = (uint8_t)top;
+        }
+    }
+    computeBlockHash(chunk);
+}
+
+// Recalculer la heightmap de toutes les colonnes du chunk
+void computeHeightMap(Chunk *chunk)
+{
+    for (int x = 0; x < 16; x++)
+    {
+        for (int z = 0; z < 16; z++)
+        {
+            int y = WORLD_HEIGHT;
+            while (y > 0 && !(chunk->data->blocks[x][y - 1][z].visible && chunk->data->blocks[x][y - 1][z].Type != BLOCK_AIR))
+            {
+                y--;
+            }
+            chunk->data->heightMap[x][z] = (uint8_t)y;
+        }
+    }
+}
+
+// Contribution d'un bloc à l'empreinte de son chunk. L'empreinte est une
+// somme : setBlockAt retire l'ancienne contribution et ajoute la nouvelle
+// sans tout recalculer. La lumière des blocs n'en fait pas partie, et l'air
+// compte pour 0 (la moitié d'un chunk généré).
+static inline uint64_t blockHashBits(int index, uint16_t bits)
+{
+    static const BlockData noLight = { .Type = 0x1FF, .lightLevel = 0, .gravity = 1, .solid = 1, .visible = 1 };
+    static const BlockData air = { .Type = BLOCK_AIR };
+    uint16_t mask, airBits;
+    memcpy(&mask, &noLight, sizeof(mask));
+    memcpy(&airBits, &air, sizeof(airBits));
+    bits &= mask;
+    if (bits == airBits) return 0;
+    uint64_t h = ((uint64_t)index << 16 | bits) + 1;
+    h *= 0x9E3779B97F4A7C15ull;
+    h ^= h >> 32;
+    h *= 0xD6E8FEB86659FD93ull;
+    return h ^ (h >> 32);
+}
+
+static inline uint64_t blockHashTerm(int x, int y, int z, BlockData block)
+{
+    uint16_t bits;
+    memcpy(&bits, &block, sizeof(bits));
+    return blockHashBits((x * WORLD_HEIGHT + y) * CHUNK_SIZE + z, bits);
+}
+
+// Ajouter (sign = 1) ou retirer (sign = -1) un bloc des empreintes du chunk
+static inline void hashBlock(Chunk *chunk, int x, int y, int z, BlockData block, int sign)
+{
+    uint64_t term = blockHashTerm(x, y, z, block);
+    if (sign < 0) term = 0 - term;
+    chunk->blockHash += term;
+    if (x == 0) chunk->sideHash[0] += term;
+    if (x == CHUNK_SIZE - 1) chunk->sideHash[1] += term;
+    if (z == 0) chunk->sideHash[2] += term;
+    if (z == CHUNK_SIZE - 1) chunk->sideHash[3] += term;
+}
+
+// Recalculer les empreintes quand les blocs ont été remplis sans setBlockAt
+void computeBlockHash(Chunk *chunk)
+{
+    // les blocs dans l'ordre de la mémoire : l'indice est la position à plat
+    const unsigned char *raw = (const unsigned char *)chunk->data->blocks;
+    uint64_t h = 0;
+    for (int i = 0; i < CHUNK_SIZE * WORLD_HEIGHT * CHUNK_SIZE; i++)
+    {
+        uint16_t bits;
+        memcpy(&bits, raw + 2 * i, sizeof(bits));
+        h += blockHashBits(i, bits);
+    }
+    chunk->blockHash = h;
+    memset(chunk->sideHash, 0, sizeof(chunk->sideHash));
+    for (int y = 0; y < WORLD_HEIGHT; y++)
+    {
+        for (int i = 0; i < CHUNK_SIZE; i++)
+        {
+            chunk->sideHash[0] += blockHashTerm(0, y, i, chunk->data->blocks[0][y][i]);
+            chunk->sideHash[1] += blockHashTerm(CHUNK_SIZE - 1, y, i, chunk->data->blocks[CHUNK_SIZE - 1][y][i]);
+            chunk->sideHash[2] += blockHashTerm(i, y, 0, chunk->data->blocks[i][y][0]);
+            chunk->sideHash[3] += blockHashTerm(i, y, CHUNK_SIZE - 1, chunk->data->blocks[i][y][CHUNK_SIZE - 1]);
         }
     }
 }
@@ -146,18 +453,103 @@ BlockData getBlockAt(Chunk *chunks, int worldX, int worldY, int worldZ)
     }
 
     // Trouver le chunk correspondant
-    for (int i = 0; i < (2 * RENDER_DISTANCE + 1) * (2 * RENDER_DISTANCE + 1); i++)
+    Chunk *chunk = findChunk(chunks, chunkX, chunkZ);
+    if (chunk != NULL)
     {
-        if (chunks[i].x == chunkX && chunks[i].z == chunkZ)
-        {
-            return chunks[i].data.blocks[localX][worldY][localZ];
-        }
+        return chunk->data->blocks[localX][worldY][localZ];
     }
 
     // Si le chunk n'est pas trouvé, retourner un bloc AIR
     return createBlock(BLOCK_AIR);
 }
 
+// Remplacer un bloc (coordonnées monde). Renvoie 0 si le chunk n'est pas chargé.
+// L'ancien bloc est renvoyé dans oldBlock (si non NULL) pour la mise à jour
+// incrémentale de la lumière.
+int setBlockAt(Chunk *chunks, int worldX, int worldY, int worldZ, BlockData block, BlockData *oldBlock)
+{
+    if (worldY < 0 || worldY >= WORLD_HEIGHT)
+    {
+        return 0;
+    }
+    Chunk *chunk = findChunk(chunks, worldX >> 4, worldZ >> 4);
+    if (chunk == NULL)
+    {
+        return 0;
+    }
+    const int x = worldX & 15, z = worldZ & 15;
+    // Les meshes en cours de calcul pour ce chunk, et pour les voisins dont
+    // la bordure contient ce bloc, sont périmés. La version change avant le
+    // bloc : un mesh qui retrouve la même version après coup a tout lu avant.
+    for (int dx = -1; dx <= 1; dx++)
+    {
+        for (int dz = -1; dz <= 1; dz++)
+        {
+            if ((dx < 0 && x != 0) || (dx > 0 && x != 15) || (dz < 0 && z != 0) || (dz > 0 && z != 15))
+            {
+                continue;
+            }
+            Chunk *n = (dx == 0 && dz == 0) ? chunk : findChunk(chunks, chunk->x + dx, chunk->z + dz);
+            if (n != NULL)
+            {
+                __atomic_fetch_add(&n->version, 1, __ATOMIC_SEQ_CST);
+            }
+        }
+    }
+    BlockData *slot = &chunk->data->blocks[x][worldY][z];
+    if (oldBlock != NULL)
+    {
+        *oldBlock = *slot;
+    }
+    hashBlock(chunk, x, worldY, z, *slot, -1);
+    hashBlock(chunk, x, worldY, z, block, 1);
+    *slot = block;
+    chunk->dirty = 1;
+
+    // Tenir la heightmap à jour
+    uint8_t *height = &chunk->data->heightMap[x][z];
+    if (block.visible && block.Type != BLOCK_AIR)
+    {
+        if (worldY >= *height)
+        {
+            *height = (uint8_t)(worldY + 1);
+        }
+    }
+    else if (worldY == *height - 1)
+    {
+        int y = worldY;
+        while (y > 0 && !(chunk->data->blocks[x][y - 1][z].visible && chunk->data->blocks[x][y - 1][z].Type != BLOCK_AIR))
+        {
+            y--;
+        }
+        *height = (uint8_t)y;
+    }
+    return 1;
+}
+
+// Emplacement du chunk (chunkX, chunkZ) dans le tableau : ses coordonnées
+// modulo CHUNK_GRID_SIDE. Le tableau est un tore : le chunk qui sort du carré
+// d'un côté laisse sa place à celui qui y entre du côté opposé.
+int chunkSlot(int chunkX, int chunkZ)
+{
+    int x = chunkX % CHUNK_GRID_SIDE, z = chunkZ % CHUNK_GRID_SIDE;
+    if (x < 0) x += CHUNK_GRID_SIDE;
+    if (z < 0) z += CHUNK_GRID_SIDE;
+    return x * CHUNK_GRID_SIDE + z;
+}
+
+// Trouver un chunk chargé par ses coordonnées de chunk (NULL si absent)
+Chunk *findChunk(Chunk *chunks, int chunkX, int chunkZ)
+{
+    Chunk *chunk = &chunks[chunkSlot(chunkX, chunkZ)];
+    // un emplacement sans blocs attend son chunk, ou l'a évincé
+    if (chunk->data != NULL && chunk->x == chunkX && chunk->z == chunkZ)
+    {
+        return chunk;
+    }
+    return NULL;
+}
+
 // Get neighboring block positions
 int isBlockExposed(Chunk *chunks, int x, int y, int z)
 {
@@ -2,11 +2,28 @@
 #define DATA_H
 #include "raylib.h"
 #include <stdint.h>
+#include <stddef.h>
 
 
 #define CHUNK_SIZE 16
 #define WORLD_HEIGHT 128
+// Chunks affichés en détail complet autour du joueur
 #define RENDER_DISTANCE 4
+// Chunks affichés en tout : au-delà de RENDER_DISTANCE, en maillages
+// simplifiés (niveaux de détail, voir mesh.h)
+#define VIEW_DISTANCE 16
+// Chunks chargés en plus de la distance de vue de chaque côté, pour préparer
+// ceux vers lesquels le joueur se dirige
+#define PREFETCH_DISTANCE 2
+// Chunks chargés : un carré de CHUNK_GRID_SIDE x CHUNK_GRID_SIDE autour du joueur
+#define CHUNK_GRID_SIDE (2 * (VIEW_DISTANCE + PREFETCH_DISTANCE) + 1)
+// Les colonnes plus basses sont remplies d'eau jusqu'à ce niveau
+#define SEA_LEVEL 60
+// Graine d'un nouveau monde (un monde existant garde la sienne, voir region.h)
+#define DEFAULT_WORLD_SEED 0x5EED1234u
+// Version de generateChunk, gardée avec chaque monde (voir region.h) : à
+// incrémenter dès que le générateur donne d'autres blocs pour la même graine
+#define GENERATOR_VERSION 2
 
 #define WINDOWS_WIDTH 800
 #define WINDOWS_HEIGHT 600
@@ -50,6 +67,7 @@ typedef enum
     BLOCK_WATER,
     BLOCK_SAND,
     BLOCK_WOOD,
+    BLOCK_GLOWSTONE,
     BLOCK_NULL,
     BLOCK_BREAKING
 } BlockType;
@@ -65,8 +83,9 @@ typedef struct __attribute__((packed, aligned(1))) BlockData
 
 typedef struct __attribute__((packed)) ChunkData
 {
-    int8_t ChunkHeight;
-    BlockData blocks[16][128][16];
+    uint8_t heightMap[16][16];       // par colonne : y du premier bloc au-dessus du plus haut bloc opaque
+    BlockData blocks[16][128][16];   // lightLevel = lumière des blocs (torches...)
+    uint8_t skyLight[16][128][16];   // lumière du ciel, 0 à 15
 } ChunkData;
 
 typedef struct ChunkRenderData {
@@ -78,25 +97,61 @@ typedef struct ChunkRenderData {
     void *cpuVertices;
     void *cpuIndices;
     int needsRemesh;
-    int meshing;
+    int queued;     // a mesh job for the chunk waits in the queue (one at most)
+    int meshing;    // mesh jobs queued, running or waiting for upload
     int meshReady;
+    int lod;        // LOD level of the uploaded mesh (0 = full detail)
+    int lodTarget;  // LOD level wanted for the current player distance
+    int bakedLight; // mesh colors already hold the light, no light volume sampling
+    unsigned lightDirty; // 16 row bands of the light volume texture to refill (one bit each)
+    unsigned lightVersion; // bumped by the worker whenever the light of the chunk changes
+    uint64_t meshKey;      // remesh key of the uploaded mesh (0 = none)
+    uint64_t cacheKey;     // MeshInputHash of the uploaded mesh
+    int cacheStale;        // the uploaded mesh is not in the mesh cache: written when the chunk leaves
+    int edited;            // a block of the chunk or of its border was edited since it came into the slot
+    unsigned meshTicket;     // handed to the mesh jobs in the order they read the chunk
+    unsigned uploadedTicket; // ticket of the uploaded mesh: older results are dropped
+    Texture2D lightTexture;
     float aabbMin[3];
     float aabbMax[3];
     void *user; // reserved
     int hasMesh;
+    int gpuBytes; // vertex and index buffers of the uploaded mesh
     Mesh mesh;
 } ChunkRenderData;
 
 typedef struct {
     int x;
     int z;
-    ChunkData data;
+    int lit; // lumière (ciel + blocs) calculée
+    int stage; // étape atteinte dans le pipeline des chunks (ChunkStage, pipeline.h)
+    unsigned epoch; // incrémenté (atomiquement) quand l'emplacement passe à un autre chunk : annule les tâches de l'ancien
+    int dirty; // modifié depuis le chargement, à sauvegarder
+    unsigned version; // incrémenté (atomiquement) par setBlockAt dès qu'un bloc du chunk ou de son bord change
+    uint64_t blockHash;   // empreinte des blocs (sans la lumière), tenue à jour par setBlockAt
+    uint64_t sideHash[4]; // empreinte de chaque bord : x = 0, x = 15, z = 0, z = 15
+    ChunkData *data; // blocs (allocChunkData) : NULL tant que l'emplacement n'a pas de chunk, ou après éviction
     ChunkRenderData render;
 } Chunk;
 
 BlockData createBlock(BlockType type);
+int blockEmission(BlockType type);
+void setWorldSeed(uint32_t seed);
+uint32_t worldSeed(void);
+int terrainHeightAt(int worldX, int worldZ);
+BlockType terrainTopBlockAt(int worldX, int worldZ);
+ChunkData *allocChunkData(void);
+void freeChunkData(ChunkData *data);
+size_t chunkDataBytes(void);
+// Les blocs ne dépendent que de la graine du monde et de (chunkX, chunkZ) :
+// appelable depuis plusieurs threads à la fois, sur des chunks différents
 void generateChunk(Chunk *chunk, int chunkX, int chunkZ);
+void computeHeightMap(Chunk *chunk);
+void computeBlockHash(Chunk *chunk);
+int chunkSlot(int chunkX, int chunkZ);
+Chunk *findChunk(Chunk *chunks, int chunkX, int chunkZ);
 BlockData getBlockAt(Chunk *chunks, int worldX, int worldY, int worldZ);
+int setBlockAt(Chunk *chunks, int worldX, int worldY, int worldZ, BlockData block, BlockData *oldBlock);
 int isBlockExposed(Chunk *chunks, int x, int y, int z);
 
 #endif
\ No newline at end of file
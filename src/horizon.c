@@ -0,0 +1,165 @@
+#include "horizon.h"
+#include "atlas.h"
+#include "pipeline.h"
+#include "mesh.h"
+#include "data.h"
+#include "raylib.h"
+#include "raymath.h"
+
+#include <stdlib.h>
+#include <limits.h>
+#include <math.h>
+
+// Each grid slot owns its own 4 vertices, so a cell can be rewritten without
+// touching its neighbours. World cell (cx, cz) always lives in slot
+// (cx mod HORIZON_GRID, cz mod HORIZON_GRID): when the player crosses a cell
+// border only the row / column of slots that wrapped around is rebuilt.
+typedef struct HorizonSlot {
+    int cx, cz;   // world cell coordinates currently stored in the slot
+    int hidden;   // covered by a loaded chunk mesh, collapsed to a point
+} HorizonSlot;
+
+#define HORIZON_SLOTS (HORIZON_GRID * HORIZON_GRID)
+
+static Chunk *g_chunks = NULL;
+static HorizonSlot g_slots[HORIZON_SLOTS];
+static Mesh g_mesh = {0};
+static Material g_material = {0};
+static int g_dirtyMin = INT_MAX;
+static int g_dirtyMax = -1;
+
+static int floor_div(int a, int b) {
+    return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
+static int wrap(int a, int n) {
+    int m = a % n;
+    return m < 0 ? m + n : m;
+}
+
+// Surface height and color of a column: from the chunk data when it is
+// loaded and generated, from the generator's analytic height otherwise
+static void sample_column(int wx, int wz, float *height, Color *color) {
+    Chunk *chunk = findChunk(g_chunks, wx >> 4, wz >> 4);
+    if (chunk && __atomic_load_n(&chunk->stage, __ATOMIC_ACQUIRE) >= CHUNK_STAGE_GENERATED) {
+        int top = chunk->data->heightMap[wx & 15][wz & 15];
+        *height = (float)top;
+        *color = GetBlockTopColor(top > 0 ? chunk->data->blocks[wx & 15][top - 1][wz & 15].Type : BLOCK_NULL);
+        return;
+    }
+    *height = (float)(terrainHeightAt(wx, wz) + 1);
+    *color = GetBlockTopColor(terrainTopBlockAt(wx, wz));
+}
+
+// A cell is hidden once the chunk under it is drawn
+static int cell_hidden(int cx, int cz, Vector3 playerPos) {
+    Chunk *chunk = findChunk(g_chunks, floor_div(cx * HORIZON_CELL, CHUNK_SIZE), floor_div(cz * HORIZON_CELL, CHUNK_SIZE));
+    return chunk && ChunkDrawn(chunk, playerPos);
+}
+
+static void build_slot(int slot, int cx, int cz, int hidden) {
+    g_slots[slot].cx = cx;
+    g_slots[slot].cz = cz;
+    g_slots[slot].hidden = hidden;
+
+    // corners in counter-clockwise order seen from above
+    const int corner[4][2] = { {1, 0}, {0, 0}, {0, 1}, {1, 1} };
+    float *pos = &g_mesh.vertices[slot * 12];
+    unsigned char *col = &g_mesh.colors[slot * 16];
+    for (int c = 0; c < 4; c++) {
+        int wx = (cx + corner[c][0]) * HORIZON_CELL;
+        int wz = (cz + corner[c][1]) * HORIZON_CELL;
+        float h = 0.0f;
+        Color color = BLANK;
+        if (hidden) {
+            wx = cx * HORIZON_CELL;
+            wz = cz * HORIZON_CELL;
+        } else {
+            sample_column(wx, wz, &h, &color);
+        }
+        pos[c*3 + 0] = (float)wx;
+        pos[c*3 + 1] = h;
+        pos[c*3 + 2] = (float)wz;
+        col[c*4 + 0] = color.r;
+        col[c*4 + 1] = color.g;
+        col[c*4 + 2] = color.b;
+        col[c*4 + 3] = color.a;
+    }
+    if (slot < g_dirtyMin) g_dirtyMin = slot;
+    if (slot > g_dirtyMax) g_dirtyMax = slot;
+}
+
+void InitHorizon(Chunk* chunks) {
+    g_chunks = chunks;
+    g_mesh = (Mesh){0};
+    g_mesh.vertexCount = HORIZON_SLOTS * 4;
+    g_mesh.triangleCount = HORIZON_SLOTS * 2;
+    g_mesh.vertices = calloc(HORIZON_SLOTS * 12, sizeof(float));
+    g_mesh.texcoords = calloc(HORIZON_SLOTS * 8, sizeof(float));
+    g_mesh.colors = calloc(HORIZON_SLOTS * 16, sizeof(unsigned char));
+    g_mesh.indices = malloc(sizeof(unsigned short) * HORIZON_SLOTS * 6);
+    for (int i = 0; i < HORIZON_SLOTS; i++) {
+        g_mesh.indices[i*6 + 0] = i*4 + 0; g_mesh.indices[i*6 + 1] = i*4 + 1; g_mesh.indices[i*6 + 2] = i*4 + 2;
+        g_mesh.indices[i*6 + 3] = i*4 + 0; g_mesh.indices[i*6 + 4] = i*4 + 2; g_mesh.indices[i*6 + 5] = i*4 + 3;
+        // no cell stored yet: the first update fills every slot
+        g_slots[i].cx = INT_MIN;
+        g_slots[i].cz = INT_MIN;
+        g_slots[i].hidden = 0;
+    }
+    UploadMesh(&g_mesh, true);
+    g_material = LoadMaterialDefault();
+    g_dirtyMin = INT_MAX;
+    g_dirtyMax = -1;
+}
+
+// Re-center the grid on the player and refresh cells whose loaded chunk
+// started or stopped being drawn. Only changed slots are rewritten and uploaded.
+void UpdateHorizon(Vector3 playerPos) {
+    int centerX = (int)floorf(playerPos.x / HORIZON_CELL);
+    int centerZ = (int)floorf(playerPos.z / HORIZON_CELL);
+    int baseX = centerX - HORIZON_GRID / 2;
+    int baseZ = centerZ - HORIZON_GRID / 2;
+
+    // bounds of the loaded chunks, the only place where cells can get hidden
+    int total = CHUNK_GRID_SIDE * CHUNK_GRID_SIDE;
+    int minCX = INT_MAX, maxCX = INT_MIN, minCZ = INT_MAX, maxCZ = INT_MIN;
+    for (int i = 0; i < total; i++) {
+        if (g_chunks[i].x < minCX) minCX = g_chunks[i].x;
+        if (g_chunks[i].x > maxCX) maxCX = g_chunks[i].x;
+        if (g_chunks[i].z < minCZ) minCZ = g_chunks[i].z;
+        if (g_chunks[i].z > maxCZ) maxCZ = g_chunks[i].z;
+    }
+    const int cellsPerChunk = CHUNK_SIZE / HORIZON_CELL;
+
+    for (int sx = 0; sx < HORIZON_GRID; sx++) {
+        int cx = baseX + wrap(sx - baseX, HORIZON_GRID);
+        for (int sz = 0; sz < HORIZON_GRID; sz++) {
+            int cz = baseZ + wrap(sz - baseZ, HORIZON_GRID);
+            int slot = sx * HORIZON_GRID + sz;
+            HorizonSlot *s = &g_slots[slot];
+            int inLoaded = floor_div(cx, cellsPerChunk) >= minCX && floor_div(cx, cellsPerChunk) <= maxCX &&
+                           floor_div(cz, cellsPerChunk) >= minCZ && floor_div(cz, cellsPerChunk) <= maxCZ;
+            int hidden = inLoaded && cell_hidden(cx, cz, playerPos);
+            if (s->cx != cx || s->cz != cz || s->hidden != hidden) {
+                build_slot(slot, cx, cz, hidden);
+            }
+        }
+    }
+
+    if (g_dirtyMax >= 0) {
+        int count = g_dirtyMax - g_dirtyMin + 1;
+        UpdateMeshBuffer(g_mesh, 0, &g_mesh.vertices[g_dirtyMin * 12], count * 12 * sizeof(float), g_dirtyMin * 12 * sizeof(float));
+        UpdateMeshBuffer(g_mesh, 3, &g_mesh.colors[g_dirtyMin * 16], count * 16, g_dirtyMin * 16);
+        g_dirtyMin = INT_MAX;
+        g_dirtyMax = -1;
+    }
+}
+
+void DrawHorizon(void) {
+    DrawMesh(g_mesh, g_material, MatrixIdentity());
+}
+
+void ShutdownHorizon(void) {
+    UnloadMesh(g_mesh);
+    UnloadMaterial(g_material);
+}
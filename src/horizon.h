@@ -0,0 +1,19 @@
+#ifndef HORIZON_H
+#define HORIZON_H
+
+#include "data.h"
+#include "raylib.h"
+
+// Far terrain drawn past the loaded chunks: a coarse grid of
+// HORIZON_GRID x HORIZON_GRID cells of HORIZON_CELL blocks centered on the
+// player, kept in a single mesh (one draw call, fixed memory). It reaches
+// twice as far as the chunks drawn (VIEW_DISTANCE).
+#define HORIZON_CELL 16
+#define HORIZON_GRID 64
+
+void InitHorizon(Chunk* chunks);
+void UpdateHorizon(Vector3 playerPos);
+void DrawHorizon(void);
+void ShutdownHorizon(void);
+
+#endif // HORIZON_H
@@ -0,0 +1,353 @@
+#ifdef __linux__
+#define _GNU_SOURCE // SCHED_IDLE
+#endif
+#include "jobs.h"
+#include "mpsc.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#define JOBS_MAX_WORKERS 64
+#define JOB_DEQUE_INITIAL 64
+
+typedef struct Job {
+    MpscNode link; // main thread queue only (first member)
+    JobFunc func;
+    void *arg;
+    JobCounter *counter;
+} Job;
+
+// Ring buffer with its own lock: only its owner and the odd thief take it, so
+// it is almost never contended
+typedef struct JobDeque {
+    pthread_mutex_t mutex;
+    Job *jobs;
+    int capacity;
+    int top;   // oldest job, where thieves take
+    int count; // also read without the lock to skip empty deques
+} JobDeque;
+
+typedef struct JobWorker {
+    pthread_t thread;
+    JobDeque deques[JOB_PRIORITY_COUNT];
+    unsigned seed; // picks the first victim to steal from
+    long executed;
+    long stolen;
+} __attribute__((aligned(64))) JobWorker;
+
+static JobWorker g_workers[JOBS_MAX_WORKERS];
+static int g_workerCount = 0;
+// deque sets in use: at least one, so jobs have somewhere to go without workers
+static int g_dequeCount = 0;
+static unsigned g_nextDeque = 0;
+static int g_queued = 0;   // jobs sitting in the deques
+static int g_sleeping = 0; // workers waiting on g_sleepCond
+static int g_shutdown = 0;
+static pthread_mutex_t g_sleepMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_sleepCond = PTHREAD_COND_INITIALIZER;
+static MpscQueue g_mainQueue;
+static pthread_t g_mainThread;
+static JobCounter g_allJobs;    // every job submitted, for JobsShutdown
+static long g_helperExecuted = 0; // by threads that are not workers, in JobWait
+static long g_helperStolen = 0;
+static long g_mainExecuted = 0;
+static _Thread_local int t_worker = -1;
+// Background jobs (JOB_PRIORITY_LOW) have their own queue and thread, in the
+// idle scheduling class where the system has one: on a busy core that thread
+// only runs when no other thread of the process wants to, so a save never
+// takes a time slice from the main thread in the middle of a frame. The
+// workers leave these jobs alone.
+static JobDeque g_background;
+static pthread_t g_backgroundThread;
+static pthread_cond_t g_backgroundCond = PTHREAD_COND_INITIALIZER;
+static long g_backgroundExecuted = 0;
+
+static int core_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+static void deque_push(JobDeque *d, Job job) {
+    pthread_mutex_lock(&d->mutex);
+    if (d->count == d->capacity) {
+        int capacity = d->capacity ? d->capacity * 2 : JOB_DEQUE_INITIAL;
+        Job *jobs = malloc(sizeof(Job) * capacity);
+        for (int i = 0; i < d->count; i++) jobs[i] = d->jobs[(d->top + i) % d->capacity];
+        free(d->jobs);
+        d->jobs = jobs;
+        d->capacity = capacity;
+        d->top = 0;
+    }
+    d->jobs[(d->top + d->count) % d->capacity] = job;
+    __atomic_store_n(&d->count, d->count + 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&d->mutex);
+}
+
+// Owner side: newest job first, its data is likely still in cache
+static int deque_pop(JobDeque *d, Job *job) {
+    if (__atomic_load_n(&d->count, __ATOMIC_RELAXED) == 0) return 0;
+    pthread_mutex_lock(&d->mutex);
+    int ok = d->count > 0;
+    if (ok) {
+        *job = d->jobs[(d->top + d->count - 1) % d->capacity];
+        __atomic_store_n(&d->count, d->count - 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&d->mutex);
+    return ok;
+}
+
+// Thief side: oldest job first
+static int deque_steal(JobDeque *d, Job *job) {
+    if (__atomic_load_n(&d->count, __ATOMIC_RELAXED) == 0) return 0;
+    pthread_mutex_lock(&d->mutex);
+    int ok = d->count > 0;
+    if (ok) {
+        *job = d->jobs[d->top];
+        d->top = (d->top + 1) % d->capacity;
+        __atomic_store_n(&d->count, d->count - 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&d->mutex);
+    return ok;
+}
+
+// Highest priority first: the own deque of that priority, then the others
+// starting from a random one
+static int find_job(int self, unsigned *seed, Job *job, int *stolen) {
+    for (int p = 0; p < JOB_PRIORITY_COUNT; p++) {
+        if (self >= 0 && deque_pop(&g_workers[self].deques[p], job)) {
+            *stolen = 0;
+            break;
+        }
+        *seed = *seed * 1103515245u + 12345u;
+        int start = (int)((*seed >> 16) % (unsigned)g_dequeCount);
+        int found = 0;
+        for (int i = 0; i < g_dequeCount && !found; i++) {
+            int victim = (start + i) % g_dequeCount;
+            found = victim != self && deque_steal(&g_workers[victim].deques[p], job);
+        }
+        if (found) {
+            *stolen = 1;
+            break;
+        }
+        if (p == JOB_PRIORITY_COUNT - 1) return 0;
+    }
+    __atomic_fetch_sub(&g_queued, 1, __ATOMIC_SEQ_CST);
+    return 1;
+}
+
+static void finish_job(JobCounter *counter) {
+    if (counter) __atomic_fetch_sub(&counter->pending, 1, __ATOMIC_ACQ_REL);
+    __atomic_fetch_sub(&g_allJobs.pending, 1, __ATOMIC_ACQ_REL);
+}
+
+static void *background_loop(void *arg) {
+    (void)arg;
+#ifdef __linux__
+    struct sched_param param = {0};
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+    for (;;) {
+        Job job;
+        // oldest first
+        if (deque_steal(&g_background, &job)) {
+            job.func(job.arg);
+            finish_job(job.counter);
+            __atomic_fetch_add(&g_backgroundExecuted, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+        // JobSubmit signals with g_sleepMutex held, after the push
+        pthread_mutex_lock(&g_sleepMutex);
+        while (__atomic_load_n(&g_background.count, __ATOMIC_RELAXED) == 0 && !g_shutdown) {
+            pthread_cond_wait(&g_backgroundCond, &g_sleepMutex);
+        }
+        int stop = g_shutdown && __atomic_load_n(&g_background.count, __ATOMIC_RELAXED) == 0;
+        pthread_mutex_unlock(&g_sleepMutex);
+        if (stop) break;
+    }
+    return NULL;
+}
+
+static void *worker_loop(void *arg) {
+    int self = (int)(size_t)arg;
+    JobWorker *w = &g_workers[self];
+    t_worker = self;
+    for (;;) {
+        Job job;
+        int stolen;
+        if (find_job(self, &w->seed, &job, &stolen)) {
+            job.func(job.arg);
+            finish_job(job.counter);
+            __atomic_fetch_add(&w->executed, 1, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&w->stolen, stolen, __ATOMIC_RELAXED);
+            continue;
+        }
+        // a submitter adds to g_queued before looking at g_sleeping, and a
+        // worker adds to g_sleeping before looking at g_queued: one of the two
+        // sees the other, so no wakeup is lost
+        pthread_mutex_lock(&g_sleepMutex);
+        __atomic_fetch_add(&g_sleeping, 1, __ATOMIC_SEQ_CST);
+        while (__atomic_load_n(&g_queued, __ATOMIC_SEQ_CST) <= 0 && !g_shutdown) {
+            pthread_cond_wait(&g_sleepCond, &g_sleepMutex);
+        }
+        __atomic_fetch_sub(&g_sleeping, 1, __ATOMIC_SEQ_CST);
+        int stop = g_shutdown && __atomic_load_n(&g_queued, __ATOMIC_SEQ_CST) <= 0;
+        pthread_mutex_unlock(&g_sleepMutex);
+        if (stop) break;
+    }
+    return NULL;
+}
+
+void JobsInit(int workerCount) {
+    if (workerCount < 0) {
+        workerCount = core_count() - 1;
+        if (workerCount < 1) workerCount = 1;
+    }
+    if (workerCount > JOBS_MAX_WORKERS) workerCount = JOBS_MAX_WORKERS;
+    g_workerCount = workerCount;
+    g_dequeCount = workerCount > 0 ? workerCount : 1;
+    g_queued = 0;
+    g_sleeping = 0;
+    g_shutdown = 0;
+    g_allJobs.pending = 0;
+    g_helperExecuted = g_helperStolen = g_mainExecuted = 0;
+    g_mainThread = pthread_self();
+    MpscInit(&g_mainQueue);
+    for (int i = 0; i < g_dequeCount; i++) {
+        JobWorker *w = &g_workers[i];
+        memset(w, 0, sizeof(*w));
+        w->seed = 0x9E3779B9u * (unsigned)(i + 1);
+        for (int p = 0; p < JOB_PRIORITY_COUNT; p++) pthread_mutex_init(&w->deques[p].mutex, NULL);
+    }
+    memset(&g_background, 0, sizeof(g_background));
+    pthread_mutex_init(&g_background.mutex, NULL);
+    g_backgroundExecuted = 0;
+    for (int i = 0; i < workerCount; i++) {
+        pthread_create(&g_workers[i].thread, NULL, worker_loop, (void *)(size_t)i);
+    }
+    if (workerCount > 0) pthread_create(&g_backgroundThread, NULL, background_loop, NULL);
+}
+
+void JobsShutdown(void) {
+    JobWait(&g_allJobs);
+    pthread_mutex_lock(&g_sleepMutex);
+    g_shutdown = 1;
+    pthread_cond_broadcast(&g_sleepCond);
+    pthread_cond_signal(&g_backgroundCond);
+    pthread_mutex_unlock(&g_sleepMutex);
+    for (int i = 0; i < g_workerCount; i++) pthread_join(g_workers[i].thread, NULL);
+    if (g_workerCount > 0) pthread_join(g_backgroundThread, NULL);
+    free(g_background.jobs);
+    pthread_mutex_destroy(&g_background.mutex);
+    for (int i = 0; i < g_dequeCount; i++) {
+        for (int p = 0; p < JOB_PRIORITY_COUNT; p++) {
+            JobDeque *d = &g_workers[i].deques[p];
+            free(d->jobs);
+            pthread_mutex_destroy(&d->mutex);
+        }
+    }
+    g_workerCount = 0;
+    g_dequeCount = 0;
+}
+
+void JobSubmit(JobFunc func, void *arg, JobPriority priority, JobCounter *counter) {
+    // counted before it can run, so a parent's counter cannot reach zero
+    // while its children are still to come
+    if (counter) __atomic_fetch_add(&counter->pending, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&g_allJobs.pending, 1, __ATOMIC_RELAXED);
+    if (priority == JOB_PRIORITY_LOW) {
+        deque_push(&g_background, (Job){ .func = func, .arg = arg, .counter = counter });
+        pthread_mutex_lock(&g_sleepMutex);
+        pthread_cond_signal(&g_backgroundCond);
+        pthread_mutex_unlock(&g_sleepMutex);
+        return;
+    }
+    int target = t_worker >= 0 ? t_worker
+                               : (int)(__atomic_fetch_add(&g_nextDeque, 1, __ATOMIC_RELAXED) % (unsigned)g_dequeCount);
+    deque_push(&g_workers[target].deques[priority], (Job){ .func = func, .arg = arg, .counter = counter });
+    __atomic_fetch_add(&g_queued, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&g_sleeping, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&g_sleepMutex);
+        pthread_cond_signal(&g_sleepCond);
+        pthread_mutex_unlock(&g_sleepMutex);
+    }
+}
+
+void JobSubmitMain(JobFunc func, void *arg, JobCounter *counter) {
+    Job *job = malloc(sizeof(Job));
+    job->func = func;
+    job->arg = arg;
+    job->counter = counter;
+    if (counter) __atomic_fetch_add(&counter->pending, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&g_allJobs.pending, 1, __ATOMIC_RELAXED);
+    MpscPush(&g_mainQueue, &job->link);
+}
+
+int JobsRunMain(int maxJobs) {
+    int count = 0;
+    while (count < maxJobs) {
+        Job *job = (Job *)MpscPop(&g_mainQueue);
+        if (!job) break;
+        job->func(job->arg);
+        finish_job(job->counter);
+        free(job);
+        count++;
+    }
+    __atomic_fetch_add(&g_mainExecuted, count, __ATOMIC_RELAXED);
+    return count;
+}
+
+void JobWait(JobCounter *counter) {
+    int isMain = t_worker < 0 && pthread_equal(pthread_self(), g_mainThread);
+    unsigned seed = 0x2545F491u;
+    while (__atomic_load_n(&counter->pending, __ATOMIC_ACQUIRE) > 0) {
+        if (isMain && JobsRunMain(1)) continue;
+        Job job;
+        int stolen = 0;
+        int found = find_job(t_worker, t_worker >= 0 ? &g_workers[t_worker].seed : &seed, &job, &stolen);
+        // background jobs too: the one waited for may be one of them
+        if (!found) found = deque_steal(&g_background, &job);
+        if (!found) {
+            sched_yield();
+            continue;
+        }
+        job.func(job.arg);
+        finish_job(job.counter);
+        if (t_worker >= 0) {
+            __atomic_fetch_add(&g_workers[t_worker].executed, 1, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&g_workers[t_worker].stolen, stolen, __ATOMIC_RELAXED);
+        } else {
+            __atomic_fetch_add(&g_helperExecuted, 1, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&g_helperStolen, stolen, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+int JobsWorkerCount(void) {
+    return g_workerCount;
+}
+
+JobStats GetJobStats(void) {
+    JobStats stats = { .workers = g_workerCount };
+    stats.executed = __atomic_load_n(&g_helperExecuted, __ATOMIC_RELAXED);
+    stats.stolen = __atomic_load_n(&g_helperStolen, __ATOMIC_RELAXED);
+    for (int i = 0; i < g_workerCount; i++) {
+        stats.executed += __atomic_load_n(&g_workers[i].executed, __ATOMIC_RELAXED);
+        stats.stolen += __atomic_load_n(&g_workers[i].stolen, __ATOMIC_RELAXED);
+    }
+    stats.executed += __atomic_load_n(&g_backgroundExecuted, __ATOMIC_RELAXED);
+    stats.mainExecuted = __atomic_load_n(&g_mainExecuted, __ATOMIC_RELAXED);
+    return stats;
+}
@@ -0,0 +1,55 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+// Job system shared by world generation, lighting, meshing and saving. Each
+// worker thread owns one deque per priority: it pushes and pops its own jobs
+// at the bottom, and an idle worker steals the oldest job at the top of
+// another worker's deque. Higher priorities always go first, stolen or not.
+// Low priority jobs run on a background thread of their own instead, which
+// the system schedules only when the other threads leave it a core.
+// Jobs that must run on the main thread (GL calls) go to a separate lock-free
+// queue that the main thread drains with JobsRunMain.
+typedef void (*JobFunc)(void *arg);
+
+typedef enum {
+    JOB_PRIORITY_HIGH,   // reacts to the player: block edits and their remeshes
+    JOB_PRIORITY_NORMAL, // streaming: generation, lighting, meshing
+    JOB_PRIORITY_LOW,    // can wait, and must not slow the frame down: saving
+    JOB_PRIORITY_COUNT
+} JobPriority;
+
+// Completion counter: every job submitted with a counter adds one to it and
+// removes it once run. A job may submit its children with the counter of its
+// parent; they are counted before the parent finishes, so the counter only
+// drops to zero once the whole tree is done. Zero-initialized means idle.
+typedef struct JobCounter {
+    int pending;
+} JobCounter;
+
+typedef struct JobStats {
+    int workers;
+    long executed;     // jobs run by the workers, the background thread and threads in JobWait
+    long stolen;       // of which taken from the deque of another worker
+    long mainExecuted; // main thread jobs run by JobsRunMain
+} JobStats;
+
+// Start workerCount threads (< 0: one per core besides the calling thread, at
+// least one), and the background thread. The calling thread becomes the main
+// thread. With 0 workers, jobs only run inside JobWait.
+void JobsInit(int workerCount);
+// Run every job left (main thread ones included), then stop the workers
+void JobsShutdown(void);
+// counter may be NULL
+void JobSubmit(JobFunc func, void *arg, JobPriority priority, JobCounter *counter);
+// Queue a job for the main thread. Never blocks, callable from any thread.
+void JobSubmitMain(JobFunc func, void *arg, JobCounter *counter);
+// Main thread: run up to maxJobs main thread jobs, oldest first. Returns how
+// many ran.
+int JobsRunMain(int maxJobs);
+// Run jobs until the counter drops to zero (main thread jobs too when called
+// from the main thread), so waiting never leaves a core idle or deadlocks a worker
+void JobWait(JobCounter *counter);
+int JobsWorkerCount(void);
+JobStats GetJobStats(void);
+
+#endif // JOBS_H
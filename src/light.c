@@ -0,0 +1,334 @@
+#include "light.h"
+#include "data.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { LIGHT_SKY, LIGHT_BLOCK };
+
+#define DIR_DOWN 3
+
+static const int lightDirs[6][3] = {
+    { 1, 0, 0}, {-1, 0, 0}, { 0, 1, 0}, { 0,-1, 0}, { 0, 0, 1}, { 0, 0,-1},
+};
+
+// Block position relative to the origin of the chunk being lit, so the 3x3
+// chunk neighbourhood spans x, z in [-16, 32)
+typedef struct LightNode {
+    int16_t x, z;
+    uint8_t y;
+    uint8_t level; // removal pass: light the block had before being cleared
+} LightNode;
+
+typedef struct LightQueue {
+    LightNode *nodes;
+    int head, tail, cap;
+} LightQueue;
+
+// One FIFO per 16 block high section. The fill drains a section before moving
+// to the next one, which keeps the working set inside a 16x16x16 region.
+typedef struct LightQueues {
+    LightQueue section[LIGHT_SECTIONS];
+    int pending;
+} LightQueues;
+
+typedef struct LightContext {
+    Chunk *grid[3][3];      // chunks that may be written (loaded and lit)
+    LightQueues add;
+    LightQueues remove;
+    LightTouched *touched;
+    int channel;
+} LightContext;
+
+// Queues are kept per thread and reused between calls
+static _Thread_local LightContext g_ctx;
+
+static void queue_push(LightQueues *q, int x, int y, int z, int level) {
+    LightQueue *s = &q->section[y >> 4];
+    if (s->tail == s->cap) {
+        if (s->head > 0) {
+            memmove(s->nodes, s->nodes + s->head, sizeof(LightNode) * (s->tail - s->head));
+            s->tail -= s->head;
+            s->head = 0;
+        }
+        if (s->tail == s->cap) {
+            s->cap = s->cap ? s->cap * 2 : 1024;
+            s->nodes = realloc(s->nodes, sizeof(LightNode) * s->cap);
+        }
+    }
+    s->nodes[s->tail++] = (LightNode){ (int16_t)x, (int16_t)z, (uint8_t)y, (uint8_t)level };
+    q->pending++;
+}
+
+// Pop from the current section, moving on to the next one once it is empty
+static int queue_pop(LightQueues *q, int *current, LightNode *out) {
+    while (q->pending > 0) {
+        LightQueue *s = &q->section[*current];
+        if (s->head < s->tail) {
+            *out = s->nodes[s->head++];
+            q->pending--;
+            return 1;
+        }
+        s->head = s->tail = 0;
+        *current = (*current + 1) % LIGHT_SECTIONS;
+    }
+    return 0;
+}
+
+static inline int light_opaque(BlockData b) {
+    return b.visible && b.Type != BLOCK_AIR;
+}
+
+// Chunk holding relative position (x, z), NULL outside the neighbourhood or
+// when that chunk may not be written
+static inline Chunk *ctx_chunk(LightContext *ctx, int x, int z) {
+    if (x < -CHUNK_SIZE || x >= 2*CHUNK_SIZE || z < -CHUNK_SIZE || z >= 2*CHUNK_SIZE) return NULL;
+    return ctx->grid[(x + CHUNK_SIZE) >> 4][(z + CHUNK_SIZE) >> 4];
+}
+
+static inline int light_get(LightContext *ctx, Chunk *c, int x, int y, int z) {
+    return ctx->channel == LIGHT_SKY ? c->data->skyLight[x & 15][y][z & 15] : c->data->blocks[x & 15][y][z & 15].lightLevel;
+}
+
+// Record that the light of c changed in the sections set in `sections`
+static void touch(LightContext *ctx, Chunk *c, unsigned sections) {
+    LightTouched *t = ctx->touched;
+    for (int i = 0; i < t->count; i++) {
+        if (t->chunks[i] == c) {
+            t->sections[i] |= sections;
+            return;
+        }
+    }
+    if (t->count < (int)(sizeof(t->chunks) / sizeof(t->chunks[0]))) {
+        t->chunks[t->count] = c;
+        t->sections[t->count] = sections;
+        t->count++;
+    }
+}
+
+static inline void light_set(LightContext *ctx, Chunk *c, int x, int y, int z, int level) {
+    if (ctx->channel == LIGHT_SKY) c->data->skyLight[x & 15][y][z & 15] = (uint8_t)level;
+    else c->data->blocks[x & 15][y][z & 15].lightLevel = level;
+}
+
+// Breadth-first spread of the lights queued in ctx->add
+static void propagate_add(LightContext *ctx) {
+    int current = 0;
+    LightNode n;
+    while (queue_pop(&ctx->add, &current, &n)) {
+        Chunk *c = ctx_chunk(ctx, n.x, n.z);
+        int level = light_get(ctx, c, n.x, n.y, n.z);
+        if (level <= 1 && !(ctx->channel == LIGHT_SKY && level == LIGHT_MAX)) continue;
+        for (int d = 0; d < 6; d++) {
+            int mx = n.x + lightDirs[d][0], my = n.y + lightDirs[d][1], mz = n.z + lightDirs[d][2];
+            if (my < 0 || my >= WORLD_HEIGHT) continue;
+            Chunk *mc = ctx_chunk(ctx, mx, mz);
+            if (!mc) continue;
+            if (light_opaque(mc->data->blocks[mx & 15][my][mz & 15])) continue;
+            int nl = (ctx->channel == LIGHT_SKY && d == DIR_DOWN && level == LIGHT_MAX) ? LIGHT_MAX : level - 1;
+            if (light_get(ctx, mc, mx, my, mz) >= nl) continue;
+            light_set(ctx, mc, mx, my, mz, nl);
+            touch(ctx, mc, 1u << (my >> 4));
+            queue_push(&ctx->add, mx, my, mz, nl);
+        }
+    }
+}
+
+// Clear the light that came from the blocks queued in ctx->remove. Neighbours
+// lit by another source are queued in ctx->add to fill the hole back in.
+static void propagate_remove(LightContext *ctx) {
+    int current = 0;
+    LightNode n;
+    while (queue_pop(&ctx->remove, &current, &n)) {
+        for (int d = 0; d < 6; d++) {
+            int mx = n.x + lightDirs[d][0], my = n.y + lightDirs[d][1], mz = n.z + lightDirs[d][2];
+            if (my < 0 || my >= WORLD_HEIGHT) continue;
+            Chunk *mc = ctx_chunk(ctx, mx, mz);
+            if (!mc) continue;
+            int ml = light_get(ctx, mc, mx, my, mz);
+            if (ml == 0) continue;
+            int skyColumn = ctx->channel == LIGHT_SKY && d == DIR_DOWN && n.level == LIGHT_MAX && ml == LIGHT_MAX;
+            if (ml < n.level || skyColumn) {
+                // emitters keep their own light
+                int emission = ctx->channel == LIGHT_BLOCK ? blockEmission(mc->data->blocks[mx & 15][my][mz & 15].Type) : 0;
+                light_set(ctx, mc, mx, my, mz, emission);
+                touch(ctx, mc, 1u << (my >> 4));
+                queue_push(&ctx->remove, mx, my, mz, ml);
+                if (emission > 0) queue_push(&ctx->add, mx, my, mz, emission);
+            } else {
+                queue_push(&ctx->add, mx, my, mz, ml);
+            }
+        }
+    }
+}
+
+static void ctx_begin(LightContext *ctx, Chunk *chunks, Chunk *center, LightTouched *touched) {
+    for (int dx = -1; dx <= 1; dx++) {
+        for (int dz = -1; dz <= 1; dz++) {
+            Chunk *c = (dx == 0 && dz == 0) ? center : findChunk(chunks, center->x + dx, center->z + dz);
+            ctx->grid[dx + 1][dz + 1] = (c && c->lit) ? c : NULL;
+        }
+    }
+    ctx->touched = touched;
+    touched->count = 0;
+}
+
+// Heightmap of column (x, z) relative to the chunk being lit, -1 outside the
+// chunks that may be written
+static inline int ctx_height(LightContext *ctx, int x, int z) {
+    Chunk *c = ctx_chunk(ctx, x, z);
+    return c ? c->data->heightMap[x & 15][z & 15] : -1;
+}
+
+// Queue the border blocks of the lit face neighbours so their light flows in.
+// For sky light only the part below the adjacent column's heightmap matters:
+// everything above already holds full light.
+static void pull_neighbour_borders(LightContext *ctx) {
+    Chunk *center = ctx->grid[1][1];
+    for (int side = 0; side < 4; side++) {
+        int dx = side == 0 ? -1 : (side == 1 ? 1 : 0);
+        int dz = side == 2 ? -1 : (side == 3 ? 1 : 0);
+        if (!ctx->grid[dx + 1][dz + 1]) continue;
+        Chunk *n = ctx->grid[dx + 1][dz + 1];
+        for (int i = 0; i < CHUNK_SIZE; i++) {
+            int x = dx < 0 ? -1 : (dx > 0 ? CHUNK_SIZE : i);
+            int z = dz < 0 ? -1 : (dz > 0 ? CHUNK_SIZE : i);
+            int ox = x < 0 ? 0 : (x >= CHUNK_SIZE ? CHUNK_SIZE - 1 : x);
+            int oz = z < 0 ? 0 : (z >= CHUNK_SIZE ? CHUNK_SIZE - 1 : z);
+            int top = ctx->channel == LIGHT_SKY ? center->data->heightMap[ox][oz] : WORLD_HEIGHT;
+            for (int y = 0; y < top; y++) {
+                if (light_get(ctx, n, x, y, z) > 1) queue_push(&ctx->add, x, y, z, 0);
+            }
+        }
+    }
+}
+
+void LightInitChunk(Chunk *chunks, Chunk *chunk, LightTouched *touched) {
+    LightContext *ctx = &g_ctx;
+    chunk->lit = 1;
+    ctx_begin(ctx, chunks, chunk, touched);
+    touch(ctx, chunk, LIGHT_ALL_SECTIONS);
+
+    // Sky: full light from the heightmap up, dark below. Rows of 16 bytes
+    // along z, which the compiler turns into vector compares.
+    ctx->channel = LIGHT_SKY;
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+        const uint8_t *height = chunk->data->heightMap[x];
+        for (int y = 0; y < WORLD_HEIGHT; y++) {
+            uint8_t *row = chunk->data->skyLight[x][y];
+            for (int z = 0; z < CHUNK_SIZE; z++) {
+                row[z] = y >= height[z] ? LIGHT_MAX : 0;
+            }
+        }
+    }
+    // Light only needs to spread sideways where a column is lower than one of
+    // its neighbours: the open blocks between the two heights can leak into
+    // what lies under the taller column
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+        for (int z = 0; z < CHUNK_SIZE; z++) {
+            int height = chunk->data->heightMap[x][z];
+            int top = height;
+            for (int d = 0; d < 6; d++) {
+                if (lightDirs[d][1] != 0) continue;
+                int h = ctx_height(ctx, x + lightDirs[d][0], z + lightDirs[d][2]);
+                if (h > top) top = h;
+            }
+            for (int y = height; y < top; y++) queue_push(&ctx->add, x, y, z, LIGHT_MAX);
+        }
+    }
+    pull_neighbour_borders(ctx);
+    propagate_add(ctx);
+
+    // Blocks: spread from every emitter. Types come in long runs, so the
+    // emission is only looked up when the type changes.
+    ctx->channel = LIGHT_BLOCK;
+    int lastType = -1, emission = 0;
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+        for (int y = 0; y < WORLD_HEIGHT; y++) {
+            for (int z = 0; z < CHUNK_SIZE; z++) {
+                BlockData *b = &chunk->data->blocks[x][y][z];
+                if (b->Type != lastType) {
+                    lastType = b->Type;
+                    emission = blockEmission(b->Type);
+                }
+                b->lightLevel = emission;
+                if (emission) queue_push(&ctx->add, x, y, z, emission);
+            }
+        }
+    }
+    pull_neighbour_borders(ctx);
+    propagate_add(ctx);
+}
+
+void LightBlockChanged(Chunk *chunks, int worldX, int worldY, int worldZ, BlockData oldBlock, LightTouched *touched) {
+    touched->count = 0;
+    if (worldY < 0 || worldY >= WORLD_HEIGHT) return;
+    Chunk *chunk = findChunk(chunks, worldX >> 4, worldZ >> 4);
+    // an unlit chunk gets its full lighting later anyway
+    if (!chunk || !chunk->lit) return;
+
+    LightContext *ctx = &g_ctx;
+    ctx_begin(ctx, chunks, chunk, touched);
+    touch(ctx, chunk, 1u << (worldY >> 4));
+    const int x = worldX & 15, y = worldY, z = worldZ & 15;
+    BlockData *block = &chunk->data->blocks[x][y][z];
+    const int opaque = light_opaque(*block);
+
+    for (int channel = LIGHT_SKY; channel <= LIGHT_BLOCK; channel++) {
+        ctx->channel = channel;
+        // the new block overwrote the stored block light, the old one tells it
+        int old = channel == LIGHT_SKY ? chunk->data->skyLight[x][y][z] : oldBlock.lightLevel;
+        light_set(ctx, chunk, x, y, z, 0);
+        if (old > 0) queue_push(&ctx->remove, x, y, z, old);
+        propagate_remove(ctx);
+
+        if (channel == LIGHT_BLOCK && blockEmission(block->Type) > 0) {
+            light_set(ctx, chunk, x, y, z, blockEmission(block->Type));
+            queue_push(&ctx->add, x, y, z, 0);
+        }
+        if (!opaque) {
+            if (channel == LIGHT_SKY && y == WORLD_HEIGHT - 1) {
+                light_set(ctx, chunk, x, y, z, LIGHT_MAX);
+                queue_push(&ctx->add, x, y, z, 0);
+            }
+            // let the surrounding light flow into the now open block
+            for (int d = 0; d < 6; d++) {
+                int mx = x + lightDirs[d][0], my = y + lightDirs[d][1], mz = z + lightDirs[d][2];
+                if (my < 0 || my >= WORLD_HEIGHT) continue;
+                Chunk *mc = ctx_chunk(ctx, mx, mz);
+                if (mc && light_get(ctx, mc, mx, my, mz) > 0) queue_push(&ctx->add, mx, my, mz, 0);
+            }
+        }
+        propagate_add(ctx);
+    }
+}
+
+// Light of local block (x, y, z) of src as stored in the volume
+static inline unsigned char volume_texel(const Chunk *src, int x, int y, int z) {
+    if (!src) return LIGHT_MAX * 17;
+    int sky = src->data->skyLight[x][y][z];
+    int block = src->data->blocks[x][y][z].lightLevel;
+    return (unsigned char)((sky > block ? sky : block) * 17);
+}
+
+// Written row by row so both the reads along z and the texel writes are
+// contiguous
+void LightFillVolume(Chunk *chunks, Chunk *chunk, unsigned char *texels, int y0, int y1) {
+    Chunk *grid[3][3];
+    for (int dx = -1; dx <= 1; dx++) {
+        for (int dz = -1; dz <= 1; dz++) {
+            grid[dx + 1][dz + 1] = (dx == 0 && dz == 0) ? chunk : findChunk(chunks, chunk->x + dx, chunk->z + dz);
+        }
+    }
+    for (int px = 0; px < LIGHT_VOLUME_SIDE; px++) {
+        Chunk **row = grid[px == 0 ? 0 : (px == LIGHT_VOLUME_SIDE - 1 ? 2 : 1)];
+        const int x = (px - 1) & 15;
+        for (int y = y0; y < y1; y++) {
+            unsigned char *dst = texels + y * LIGHT_VOLUME_WIDTH + px * LIGHT_VOLUME_SIDE;
+            dst[0] = volume_texel(row[0], x, y, CHUNK_SIZE - 1);
+            for (int z = 0; z < CHUNK_SIZE; z++) dst[z + 1] = volume_texel(row[1], x, y, z);
+            dst[LIGHT_VOLUME_SIDE - 1] = volume_texel(row[2], x, y, 0);
+        }
+    }
+}
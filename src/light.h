@@ -0,0 +1,43 @@
+#ifndef LIGHT_H
+#define LIGHT_H
+
+#include "data.h"
+
+// Flood-fill lighting. Two channels: sky light (ChunkData.skyLight) and block
+// light (BlockData.lightLevel). Light spreads one level weaker per block, sky
+// light at level 15 also falls straight down without weakening.
+#define LIGHT_MAX 15
+
+// 16 block high sections of a chunk, as bits of LightTouched.sections
+#define LIGHT_SECTIONS (WORLD_HEIGHT / CHUNK_SIZE)
+#define LIGHT_ALL_SECTIONS ((1u << LIGHT_SECTIONS) - 1)
+
+// Chunks whose light values changed during a lighting call, with the sections
+// that changed. Light travels at most 15 blocks, so only the chunk and its
+// neighbours can be reached.
+typedef struct LightTouched {
+    Chunk *chunks[9];
+    unsigned sections[9];
+    int count;
+} LightTouched;
+
+// Full lighting of a freshly generated chunk, seeded from its heightmap,
+// pulling light in from lit neighbours and pushing its own light into them.
+void LightInitChunk(Chunk *chunks, Chunk *chunk, LightTouched *touched);
+
+// Incremental relight after the block at (worldX, worldY, worldZ) was
+// replaced by setBlockAt; oldBlock is what was there before.
+void LightBlockChanged(Chunk *chunks, int worldX, int worldY, int worldZ, BlockData oldBlock, LightTouched *touched);
+
+// Light volume sampled by the chunk shader instead of baking light into the
+// vertices: one texel per block of the chunk plus a one block border from its
+// neighbours, column (x+1)*LIGHT_VOLUME_SIDE + (z+1) and row y, each holding
+// max(sky, block) * 17. Fully lit where a neighbour is not loaded.
+#define LIGHT_VOLUME_SIDE (CHUNK_SIZE + 2)
+#define LIGHT_VOLUME_WIDTH (LIGHT_VOLUME_SIDE * LIGHT_VOLUME_SIDE)
+
+// Fill rows y0 to y1 - 1 of texels (LIGHT_VOLUME_WIDTH * WORLD_HEIGHT bytes)
+// for chunk
+void LightFillVolume(Chunk *chunks, Chunk *chunk, unsigned char *texels, int y0, int y1);
+
+#endif // LIGHT_H
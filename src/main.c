@@ -3,6 +3,14 @@
 #include "data.h"
 #include "atlas.h"
 #include "mesh.h"
+#include "horizon.h"
+#include "region.h"
+#include "save.h"
+#include "meshcache.h"
+#include "jobs.h"
+#include "pipeline.h"
+#include "residency.h"
+#include "pool.h"
 
 #include "raylib.h"
 #include "raymath.h"
@@ -13,8 +21,55 @@
 #include <math.h>
 #include <unistd.h>
 
+#define REACH_DISTANCE 8.0f
+#define WORLD_DIRECTORY "world"
+// Budget mémoire des chunks (blocs, meshes CPU et GPU) en Mo, remplacé par la
+// variable d'environnement MEMORY_BUDGET_MB si elle est définie
+#define MEMORY_BUDGET_MB 256
 
+// Lancer de rayon (DDA) : premier bloc visible touché dans la direction 'dir'.
+// 'before' reçoit la dernière case vide traversée, où poser un bloc.
+static int raycastBlock(Chunk *chunks, Vector3 origin, Vector3 dir, float maxDist, Vector3Int *hit, Vector3Int *before)
+{
+    int x = (int)floorf(origin.x), y = (int)floorf(origin.y), z = (int)floorf(origin.z);
+    int stepX = dir.x > 0 ? 1 : -1, stepY = dir.y > 0 ? 1 : -1, stepZ = dir.z > 0 ? 1 : -1;
+    float tDeltaX = dir.x != 0 ? fabsf(1.0f / dir.x) : INFINITY;
+    float tDeltaY = dir.y != 0 ? fabsf(1.0f / dir.y) : INFINITY;
+    float tDeltaZ = dir.z != 0 ? fabsf(1.0f / dir.z) : INFINITY;
+    float tMaxX = dir.x > 0 ? (x + 1 - origin.x) * tDeltaX : (origin.x - x) * tDeltaX;
+    float tMaxY = dir.y > 0 ? (y + 1 - origin.y) * tDeltaY : (origin.y - y) * tDeltaY;
+    float tMaxZ = dir.z > 0 ? (z + 1 - origin.z) * tDeltaZ : (origin.z - z) * tDeltaZ;
+    float t = 0.0f;
+    *before = (Vector3Int){ x, y, z };
+    while (t <= maxDist)
+    {
+        BlockData b = getBlockAt(chunks, x, y, z);
+        if (b.visible && b.Type != BLOCK_AIR)
+        {
+            *hit = (Vector3Int){ x, y, z };
+            return 1;
+        }
+        *before = (Vector3Int){ x, y, z };
+        if (tMaxX < tMaxY && tMaxX < tMaxZ) { x += stepX; t = tMaxX; tMaxX += tDeltaX; }
+        else if (tMaxY < tMaxZ)             { y += stepY; t = tMaxY; tMaxY += tDeltaY; }
+        else                                { z += stepZ; t = tMaxZ; tMaxZ += tDeltaZ; }
+    }
+    return 0;
+}
 
+// Remplacer un bloc et prévenir le système de mesh (lumière + remesh).
+// Seulement dans un chunk arrivé au bout du pipeline : avant, sa génération
+// ou sa lumière sont encore en cours.
+static void editBlock(Chunk *chunks, Vector3Int pos, BlockType type)
+{
+    Chunk *chunk = findChunk(chunks, pos.x >> 4, pos.z >> 4);
+    if (!chunk || __atomic_load_n(&chunk->stage, __ATOMIC_ACQUIRE) != CHUNK_STAGE_UPLOADED) return;
+    BlockData oldBlock;
+    if (setBlockAt(chunks, pos.x, pos.y, pos.z, createBlock(type), &oldBlock))
+    {
+        NotifyBlockChanged(pos.x, pos.y, pos.z, oldBlock);
+    }
+}
 
 int main(void) {
     // Initialisation de la fenêtre
@@ -44,19 +99,58 @@ int main(void) {
         .pitch = 0.0f
     };
 
-    // Initialisation des chunks
-    int totalChunks = (2*RENDER_DISTANCE+1)*(2*RENDER_DISTANCE+1);
-    Chunk* chunks = malloc(totalChunks * sizeof(Chunk));
-    for (int x = -RENDER_DISTANCE; x <= RENDER_DISTANCE; x++) {
-        for (int z = -RENDER_DISTANCE; z <= RENDER_DISTANCE; z++) {
-            int index = (x + RENDER_DISTANCE) * (2*RENDER_DISTANCE + 1) + (z + RENDER_DISTANCE);
-            generateChunk(&chunks[index], x, z);
-        }
+    // Bloc posé au clic droit (touches 1 à 5)
+    BlockType selectedBlock = BLOCK_STONE;
+    const BlockType hotbar[5] = { BLOCK_STONE, BLOCK_DIRT, BLOCK_SAND, BLOCK_WOOD, BLOCK_GLOWSTONE };
+
+    // Blocs des chunks, sauvegardes et chunks compressés alloués par classes de
+    // taille dans des blocs de 2 Mo, en grandes pages si le système en a
+    PoolInit(1);
+
+    // Tâches de fond : un worker par cœur en plus de ce thread
+    JobsInit(-1);
+
+    // Emplacements des chunks, vides : le pipeline leur donne les chunks
+    // autour du joueur, les génère (avec les modifications sauvegardées), les
+    // éclaire et les maille en tâches de fond
+    // Un nouveau monde prend la graine WORLD_SEED de l'environnement si elle
+    // est définie, un monde existant garde la sienne
+    const char *seedText = getenv("WORLD_SEED");
+    if (seedText != NULL) setWorldSeed((uint32_t)strtoul(seedText, NULL, 0));
+    if (!RegionOpenWorld(WORLD_DIRECTORY)) {
+        printf("ERREUR: Impossible d'ouvrir le monde %s\n", WORLD_DIRECTORY);
+        JobsShutdown();
+        UnloadTexture(blockAtlas);
+        CloseWindow();
+        return 1;
     }
+    player.position.y = (float)terrainHeightAt(0, 0) + 2.0f;
+    int totalChunks = CHUNK_GRID_SIDE * CHUNK_GRID_SIDE;
+    Chunk* chunks = calloc(totalChunks, sizeof(Chunk));
+
+    // Sauvegarde en arrière-plan
+    InitSaveSystem();
+    float autosaveTimer = 0.0f;
+    int autosaveLeft = 0;
 
-    // Initialiser le système de mesh (workers + queues)
+    // Initialiser le système de mesh (workers + queues), avec les meshes
+    // gardés sur disque depuis la dernière partie
+    MeshCacheOpen(WORLD_DIRECTORY "/meshes");
     InitMeshSystem(chunks, totalChunks, blockAtlas);
 
+    // Terrain lointain au-delà des chunks chargés
+    InitHorizon(chunks);
+
+    // Lancer le pipeline : génération, voisins prêts, lumière, mesh, envoi au GPU
+    StartChunkPipeline(chunks, totalChunks, player.position);
+
+    // Au-delà du budget mémoire, les chunks hors de vue sont évincés. Ceux
+    // évincés ou sortis de la zone restent compressés en mémoire un moment
+    // (touche M pour les libérer à la place)
+    const char *budgetText = getenv("MEMORY_BUDGET_MB");
+    long budgetMb = budgetText != NULL && atol(budgetText) > 0 ? atol(budgetText) : MEMORY_BUDGET_MB;
+    InitResidency(chunks, totalChunks, (size_t)budgetMb << 20, RESIDENCY_COMPRESS);
+
     // Boucle principale
     while (!WindowShouldClose())
     {
@@ -81,6 +175,7 @@ int main(void) {
         };
 
         // Déplacement du joueur
+        Vector3 previousPosition = player.position;
         float speed = 10.0f * deltaTime;
         if (IsKeyDown(KEY_LEFT_SHIFT)) speed *= 2.5f;
         
@@ -108,6 +203,43 @@ int main(void) {
             player.position.y += speed;
         }
 
+        // Vitesse du joueur, pour charger à l'avance les chunks vers lesquels il se dirige
+        if (deltaTime > 0.0f)
+        {
+            player.velocity = (Vector3){
+                (player.position.x - previousPosition.x) / deltaTime,
+                (player.position.y - previousPosition.y) / deltaTime,
+                (player.position.z - previousPosition.z) / deltaTime
+            };
+        }
+
+        // Casser (clic gauche) / poser (clic droit) un bloc
+        for (int i = 0; i < 5; i++)
+        {
+            if (IsKeyPressed(KEY_ONE + i)) selectedBlock = hotbar[i];
+        }
+        if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT) || IsMouseButtonPressed(MOUSE_BUTTON_RIGHT))
+        {
+            Vector3Int hit, before;
+            if (raycastBlock(chunks, player.position, direction, REACH_DISTANCE, &hit, &before))
+            {
+                if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) editBlock(chunks, hit, BLOCK_AIR);
+                else editBlock(chunks, before, selectedBlock);
+            }
+        }
+
+        // Basculer entre lumière précalculée dans les sommets et texture de lumière
+        if (IsKeyPressed(KEY_L))
+        {
+            SetChunkLightMode(GetChunkLightMode() == CHUNK_LIGHT_VOLUME ? CHUNK_LIGHT_VERTEX : CHUNK_LIGHT_VOLUME);
+        }
+
+        // Chunks évincés ou sortis de la zone : compressés en mémoire ou libérés (rechargés ensuite)
+        if (IsKeyPressed(KEY_M))
+        {
+            SetResidencyMode(GetResidencyMode() == RESIDENCY_COMPRESS ? RESIDENCY_DROP : RESIDENCY_COMPRESS);
+        }
+
         // Mise à jour de la caméra
         camera.position = player.position;
         camera.target = (Vector3){
@@ -116,9 +248,34 @@ int main(void) {
             player.position.z + direction.z
         };
 
+        // Chunks qui sortent de la zone chargée : leurs emplacements passent
+        // à ceux qui y entrent, leurs tâches sont annulées. La zone est
+        // décalée vers là où le joueur se dirige.
+        StreamChunks(player.position, player.velocity, direction);
+
+        // Tenir le budget mémoire
+        UpdateResidency(player.position);
+
+        // Choisir le niveau de détail de chaque chunk selon la distance
+        UpdateChunkLods(player.position);
+
         // Poll mesh uploads (main thread uploads ready meshes to GPU)
         PollMeshUploads();
 
+        // Recentrer le terrain lointain autour du joueur
+        UpdateHorizon(player.position);
+
+        // Sauvegarde automatique, étalée sur plusieurs frames si besoin. Les
+        // blocs sont copiés sous le verrou en lecture : si un job de lumière le
+        // tient ou l'attend, on réessaie à la frame suivante plutôt que d'attendre
+        autosaveTimer += deltaTime;
+        if ((autosaveTimer >= AUTOSAVE_INTERVAL || autosaveLeft > 0) && TryLockChunkDataRead())
+        {
+            if (autosaveTimer >= AUTOSAVE_INTERVAL) autosaveTimer = 0.0f;
+            autosaveLeft = SaveDirtyChunks(chunks, totalChunks, SAVE_STALL_BUDGET);
+            UnlockChunkData();
+        }
+
         // Rendu
         BeginDrawing();
             ClearBackground(SKYBLUE);
@@ -130,7 +287,8 @@ int main(void) {
             DrawLine3D((Vector3){0,0,0}, (Vector3){0,10,0}, GREEN);
             DrawLine3D((Vector3){0,0,0}, (Vector3){0,0,10}, BLUE);
 
-            // Draw chunk meshes
+            // Draw far terrain, then chunk meshes
+            DrawHorizon();
             DrawChunks(chunks, camera, player.position);
 
             EndMode3D();
@@ -146,6 +304,64 @@ int main(void) {
                               player.position.x, 
                               player.position.y, 
                               player.position.z), 10, 50, 20, WHITE);
+            DrawText(GetChunkLightMode() == CHUNK_LIGHT_VOLUME ? "Lumiere: texture" : "Lumiere: sommets", 10, 80, 20, WHITE);
+            SaveStats saveStats = GetSaveStats();
+            DrawText(TextFormat("Sauvegarde: %.3f ms (max %.3f ms)", saveStats.lastStall * 1000.0, saveStats.maxStall * 1000.0), 10, 110, 20, WHITE);
+            MeshJobStats jobStats = GetMeshJobStats();
+            DrawText(TextFormat("Remesh: %ld calcules, %ld du cache, %ld evites, %ld perimes",
+                                jobStats.meshed, jobStats.cached, jobStats.skipped, jobStats.stale), 10, 140, 20, WHITE);
+            if (GetMeshStartupTime() > 0.0)
+                DrawText(TextFormat("Premier rendu complet: %.0f ms", GetMeshStartupTime() * 1000.0), 10, 170, 20, WHITE);
+            JobStats jobs = GetJobStats();
+            DrawText(TextFormat("Taches: %d workers, %ld executees, %ld volees, %ld sur le thread principal",
+                                jobs.workers, jobs.executed, jobs.stolen, jobs.mainExecuted), 10, 200, 20, WHITE);
+            // Pipeline : chunks en attente de chaque étape et latence moyenne pour y arriver
+            ChunkStageStats stages[CHUNK_STAGE_COUNT];
+            GetChunkPipelineStats(stages);
+            char pipelineText[256];
+            int length = snprintf(pipelineText, sizeof(pipelineText), "Pipeline:");
+            for (int s = CHUNK_STAGE_GENERATED; s < CHUNK_STAGE_COUNT && length < (int)sizeof(pipelineText); s++)
+            {
+                length += snprintf(pipelineText + length, sizeof(pipelineText) - length, " %s %d (%.1f ms)",
+                                   ChunkStageName(s), stages[s].queued, stages[s].meanLatency * 1000.0);
+            }
+            DrawText(pipelineText, 10, 230, 20, WHITE);
+            // Travail évité grâce aux chunks sortis de la zone avant d'être prêts
+            ChunkCancelStats cancel = GetChunkCancelStats();
+            DrawText(TextFormat("Annule: %ld sortis (%ld revenus), %ld generations, %ld eclairages, %ld meshes, ~%.0f ms evitees",
+                                cancel.left, cancel.kept, cancel.generateSkipped + cancel.generateWasted,
+                                cancel.lightSkipped, cancel.meshSkipped, cancel.savedSeconds * 1000.0), 10, 260, 20, WHITE);
+            // Chunks arrivés dans le champ de vue déjà affichés (préchargés à temps) ou non
+            ChunkPrefetchStats prefetch = GetChunkPrefetchStats();
+            long arrived = prefetch.hits + prefetch.misses;
+            DrawText(TextFormat("Prechargement: %ld prets, %ld en retard (%.0f%%), avance %d, %d",
+                                prefetch.hits, prefetch.misses, arrived > 0 ? 100.0 * prefetch.hits / arrived : 0.0,
+                                prefetch.aheadX, prefetch.aheadZ), 10, 290, 20, WHITE);
+            // Mémoire des chunks par catégorie, et chunks évincés pour tenir le budget
+            ResidencyStats residency = GetResidencyStats();
+            DrawText(TextFormat("Memoire: blocs %.1f Mo, meshes %.1f Mo CPU %.1f Mo GPU, compresses %.1f Mo (%d) / %.0f Mo",
+                                residency.voxelBytes / 1048576.0, residency.cpuMeshBytes / 1048576.0,
+                                residency.gpuMeshBytes / 1048576.0, residency.compressedBytes / 1048576.0,
+                                residency.compressed, residency.budget / 1048576.0), 10, 320, 20, WHITE);
+            DrawText(TextFormat("Evinces: %d (%s), %ld evictions, %ld retours",
+                                residency.evicted, GetResidencyMode() == RESIDENCY_COMPRESS ? "compresses" : "liberes",
+                                residency.evictions, residency.readmissions), 10, 350, 20, WHITE);
+            // Temps pour récupérer les blocs d'un chunk qui revient, selon leur source
+            ChunkSourceStats sources[CHUNK_SOURCE_COUNT];
+            GetChunkSourceStats(sources);
+            char sourceText[256];
+            length = snprintf(sourceText, sizeof(sourceText), "Chargement:");
+            for (int s = CHUNK_SOURCE_COLD; s < CHUNK_SOURCE_COUNT && length < (int)sizeof(sourceText); s++)
+            {
+                length += snprintf(sourceText + length, sizeof(sourceText) - length, " %s %ld (%.2f ms)",
+                                   ChunkSourceName(s), sources[s].chunks, sources[s].meanSeconds * 1000.0);
+            }
+            DrawText(sourceText, 10, 380, 20, WHITE);
+            // Pool : octets utilisés sur les octets réservés (jamais rendus au système)
+            PoolStats pool = GetPoolStats();
+            DrawText(TextFormat("Pool: %.1f Mo utilises / %.1f Mo reserves, %d blocs (%d grandes pages), %ld allocations",
+                                pool.used / 1048576.0, pool.reserved / 1048576.0, pool.slabs, pool.hugePages,
+                                pool.allocations), 10, 410, 20, WHITE);
             
         EndDrawing();
     }
@@ -155,7 +371,18 @@ int main(void) {
     
     // Libérer le tableau de chunks
     // Shutdown mesh system and free resources
+    ShutdownHorizon();
+    ShutdownChunkPipeline();
     ShutdownMeshSystem();
+    ShutdownResidency();
+
+    // Sauvegarder les chunks modifiés et attendre la fin des écritures (plus
+    // aucun job ne touche aux blocs, pas besoin du verrou)
+    SaveDirtyChunks(chunks, totalChunks, INFINITY);
+    ShutdownSaveSystem();
+    JobsShutdown();
+    RegionCloseWorld();
+    for (int i = 0; i < totalChunks; i++) freeChunkData(chunks[i].data);
     free(chunks);
 
     CloseWindow();
@@ -1,4 +1,12 @@
+#ifdef __linux__
+#define _GNU_SOURCE // writer-preferring rwlock
+#endif
 #include "mesh.h"
+#include "mesher.h"
+#include "meshcache.h"
+#include "light.h"
+#include "jobs.h"
+#include "pipeline.h"
 #include "atlas.h"
 #include "data.h"
 #include "raylib.h"
@@ -12,412 +20,345 @@
 #include <math.h>
 #include <time.h>
 
-// Simple job / ready queues
+// Jobs of the mesh system, run by the shared job system
+typedef enum {
+    JOB_MESH,     // mesh the chunk (the pipeline made the light around it final)
+    JOB_RELIGHT,  // incremental relight after a block edit
+} MeshJobKind;
+
 typedef struct MeshJob {
+    MeshJobKind kind;
     int chunkIndex;
     int priority;
-    struct MeshJob *next;
+    int worldX, worldY, worldZ; // JOB_RELIGHT: edited block
+    BlockData oldBlock;         // JOB_RELIGHT: block before the edit
+    unsigned epoch;             // JOB_RELIGHT: Chunk.epoch of the edited chunk
 } MeshJob;
 
-typedef struct ReadyMesh {
-    int chunkIndex;
-    float *positions; // x,y,z * vertexCount
-    float *normals;   // nx,ny,nz * vertexCount
-    float *texcoords; // u,v * vertexCount
-    unsigned int *indices;
-    int vertexCount;
-    int indexCount;
-    struct ReadyMesh *next;
-} ReadyMesh;
-
-static MeshJob *jobHead = NULL;
-static ReadyMesh *readyHead = NULL;
-static pthread_mutex_t jobMutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t jobCond = PTHREAD_COND_INITIALIZER;
-static pthread_mutex_t readyMutex = PTHREAD_MUTEX_INITIALIZER;
+// every job of the mesh system, uploads included, so shutdown can wait for them
+static JobCounter g_meshJobs = {0};
+// Lighting writes the light of neighbouring chunks: it holds the write lock,
+// while the mesh jobs, which read that light, share the read lock. Writers go
+// first: with the glibc default (readers first) the mesh jobs, some of them
+// always reading, could hold off a light job or the pipeline for ever. No
+// thread takes the read lock twice, which this kind of lock deadlocks on.
+#ifdef PTHREAD_RWLOCK_WRITER_NONRECURSIVE_INITIALIZER_NP
+static pthread_rwlock_t g_lightLock = PTHREAD_RWLOCK_WRITER_NONRECURSIVE_INITIALIZER_NP;
+#else
+static pthread_rwlock_t g_lightLock = PTHREAD_RWLOCK_INITIALIZER;
+#endif
 
 static Chunk *g_chunks = NULL;
 static int g_totalChunks = 0;
 static int g_shutdown = 0;
-static pthread_t workerThread;
 static Texture2D g_atlas = {0};
 static Material g_material = {0};
 
-// Utility to push job (no sorting for simplicity, but could be improved)
-static void push_job(int chunkIndex, int priority) {
+static ChunkLightMode g_lightMode = CHUNK_LIGHT_VOLUME;
+static int g_locUseLightVolume = -1;
+static int g_locChunkOrigin = -1;
+
+static double g_startTime = 0.0;
+static double g_startupTime = 0.0;
+static MeshJobStats g_jobStats = {0}; // updated by the worker with __atomic builtins (seconds under g_statsMutex)
+static pthread_mutex_t g_statsMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Chunk shader: texcoords hold the position inside a (possibly merged) quad in
+// blocks, texcoords2 the atlas origin of the tile. fract() wraps the former so
+// the tile repeats once per block instead of stretching across the quad.
+// Without baked light, the light of the block in front of the fragment is read
+// from the chunk light volume (see LightFillVolume for the layout).
+static const char *chunkVertexShader =
+    "#version 330\n"
+    "in vec3 vertexPosition;\n"
+    "in vec3 vertexNormal;\n"
+    "in vec2 vertexTexCoord;\n"
+    "in vec2 vertexTexCoord2;\n"
+    "in vec4 vertexColor;\n"
+    "uniform mat4 mvp;\n"
+    "out vec3 fragPosition;\n"
+    "flat out vec3 fragNormal;\n"
+    "out vec2 fragTexCoord;\n"
+    "flat out vec2 fragTileOrigin;\n"
+    "out vec4 fragColor;\n"
+    "void main() {\n"
+    "    fragPosition = vertexPosition;\n"
+    "    fragNormal = vertexNormal;\n"
+    "    fragTexCoord = vertexTexCoord;\n"
+    "    fragTileOrigin = vertexTexCoord2;\n"
+    "    fragColor = vertexColor;\n"
+    "    gl_Position = mvp*vec4(vertexPosition, 1.0);\n"
+    "}\n";
+static const char *chunkFragmentShader =
+    "#version 330\n"
+    "in vec3 fragPosition;\n"
+    "flat in vec3 fragNormal;\n"
+    "in vec2 fragTexCoord;\n"
+    "flat in vec2 fragTileOrigin;\n"
+    "in vec4 fragColor;\n"
+    "uniform sampler2D texture0;\n"
+    "uniform sampler2D lightVolume;\n"
+    "uniform int useLightVolume;\n"
+    "uniform vec3 chunkOrigin;\n"
+    "uniform vec4 colDiffuse;\n"
+    "uniform vec2 tileSize;\n"
+    "out vec4 finalColor;\n"
+    "void main() {\n"
+    "    vec2 uv = fragTileOrigin + fract(fragTexCoord)*tileSize;\n"
+    "    float shade = 1.0;\n"
+    "    if (useLightVolume != 0) {\n"
+    "        ivec3 cell = ivec3(floor(fragPosition - chunkOrigin + fragNormal*0.5));\n"
+    "        cell = clamp(cell, ivec3(-1, 0, -1), ivec3(16, 127, 16));\n"
+    "        float level = floor(texelFetch(lightVolume, ivec2((cell.x + 1)*18 + cell.z + 1, cell.y), 0).r*15.0 + 0.5);\n"
+    "        shade = pow(0.8, 15.0 - level);\n"
+    "    }\n"
+    "    finalColor = texture(texture0, uv)*colDiffuse*fragColor*vec4(vec3(shade), 1.0);\n"
+    "}\n";
+
+static void run_mesh_job(void *arg);
+
+// Block edits (relights and the remeshes they ask for) go before streaming
+static void push_job(MeshJob job) {
     MeshJob *j = malloc(sizeof(MeshJob));
-    j->chunkIndex = chunkIndex;
-    j->priority = priority;
-    j->next = NULL;
-    pthread_mutex_lock(&jobMutex);
-    // simple push at head
-    j->next = jobHead;
-    jobHead = j;
-    pthread_cond_signal(&jobCond);
-    pthread_mutex_unlock(&jobMutex);
+    *j = job;
+    JobPriority priority = job.priority > 0 ? JOB_PRIORITY_HIGH : JOB_PRIORITY_NORMAL;
+    JobSubmit(run_mesh_job, j, priority, &g_meshJobs);
 }
 
-static MeshJob *pop_job(void) {
-    pthread_mutex_lock(&jobMutex);
-    while (!jobHead && !g_shutdown) {
-        pthread_cond_wait(&jobCond, &jobMutex);
+// Show the new light of the chunks touched by a lighting call. A mesh with
+// baked light must be rebuilt (except `self`, which is about to be meshed
+// anyway), otherwise refilling the changed rows of the light volumes is
+// enough: the touched chunk and its neighbours, whose volume border reads it.
+// Chunks without a mesh yet will pick the light up when meshed.
+static void refresh_touched(const LightTouched *touched, Chunk *self) {
+    for (int i = 0; i < touched->count; i++) {
+        Chunk *c = touched->chunks[i];
+        c->render.lightVersion++;
+        if (c != self && c->render.meshReady && c->render.bakedLight) {
+            ScheduleChunkRemesh((int)(c - g_chunks), 0);
+        }
+        for (int dx = -1; dx <= 1; dx++) {
+            for (int dz = -1; dz <= 1; dz++) {
+                Chunk *n = findChunk(g_chunks, c->x + dx, c->z + dz);
+                if (n) __atomic_fetch_or(&n->render.lightDirty, touched->sections[i], __ATOMIC_RELAXED);
+            }
+        }
     }
-    if (g_shutdown) {
-        pthread_mutex_unlock(&jobMutex);
-        return NULL;
+}
+
+void LockChunkData(void) {
+    pthread_rwlock_wrlock(&g_lightLock);
+}
+
+int TryLockChunkDataRead(void) {
+    return pthread_rwlock_tryrdlock(&g_lightLock) == 0;
+}
+
+void UnlockChunkData(void) {
+    pthread_rwlock_unlock(&g_lightLock);
+}
+
+// Pipeline light stage: full lighting of one chunk, which also spreads into
+// its lit neighbours
+int LightChunk(int chunkIndex, unsigned epoch) {
+    LightTouched touched;
+    pthread_rwlock_wrlock(&g_lightLock);
+    if (__atomic_load_n(&g_chunks[chunkIndex].epoch, __ATOMIC_ACQUIRE) != epoch) {
+        pthread_rwlock_unlock(&g_lightLock);
+        return 0;
     }
-    MeshJob *j = jobHead;
-    jobHead = jobHead->next;
-    pthread_mutex_unlock(&jobMutex);
-    return j;
+    LightInitChunk(g_chunks, &g_chunks[chunkIndex], &touched);
+    refresh_touched(&touched, NULL);
+    pthread_rwlock_unlock(&g_lightLock);
+    return 1;
 }
 
-static void push_ready(ReadyMesh *r) {
-    pthread_mutex_lock(&readyMutex);
-    r->next = readyHead;
-    readyHead = r;
-    pthread_mutex_unlock(&readyMutex);
+static void relight_edit(MeshJob *job) {
+    LightTouched touched;
+    pthread_rwlock_wrlock(&g_lightLock);
+    // the chunk left range since the edit: its slot holds another one by now
+    if (__atomic_load_n(&g_chunks[job->chunkIndex].epoch, __ATOMIC_ACQUIRE) != job->epoch) {
+        pthread_rwlock_unlock(&g_lightLock);
+        __atomic_fetch_add(&g_jobStats.cancelled, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    LightBlockChanged(g_chunks, job->worldX, job->worldY, job->worldZ, job->oldBlock, &touched);
+    refresh_touched(&touched, NULL);
+    pthread_rwlock_unlock(&g_lightLock);
+    // the edited chunk, and the neighbours whose border holds the edited
+    // block (faces and ambient occlusion): the chunks setBlockAt made stale
+    int lx = job->worldX & 15, lz = job->worldZ & 15;
+    Chunk *chunk = &g_chunks[job->chunkIndex];
+    for (int dx = -1; dx <= 1; dx++) {
+        for (int dz = -1; dz <= 1; dz++) {
+            if ((dx < 0 && lx != 0) || (dx > 0 && lx != 15) || (dz < 0 && lz != 0) || (dz > 0 && lz != 15)) continue;
+            Chunk *n = findChunk(g_chunks, chunk->x + dx, chunk->z + dz);
+            if (n) ScheduleChunkRemesh((int)(n - g_chunks), 1);
+        }
+    }
 }
 
-static ReadyMesh *pop_ready(void) {
-    pthread_mutex_lock(&readyMutex);
-    ReadyMesh *r = readyHead;
-    if (r) readyHead = r->next;
-    pthread_mutex_unlock(&readyMutex);
-    return r;
+static inline uint64_t mix_key(uint64_t h, uint64_t value) {
+    h = (h ^ value) * 0x9E3779B97F4A7C15ull;
+    return h ^ (h >> 29);
 }
 
-// Basic face-culling mesher (no greedy) for simplicity and correctness.
-// It generates quads for each exposed face.
-// vertices layout per vertex: x,y,z, nx,ny,nz, u,v (8 floats)
-static ReadyMesh *mesh_chunk_improved(int chunkIndex) {
+// Cheap stand-in for MeshInputHash, from the block hashes kept up to date by
+// setBlockAt: the chunk's own blocks, the side of each neighbour facing it
+// (diagonal neighbours give their whole x side, which holds the corner
+// column), the light versions when the light is baked, and the settings. Two
+// equal keys mean the mesh would come out the same.
+static uint64_t remesh_key(int chunkIndex, int lod) {
     Chunk *chunk = &g_chunks[chunkIndex];
-    // We'll implement greedy merging for top faces (Y axis), and keep simple
-    // per-face meshing for vertical faces. This provides a large win for terrain.
-    int vcap = 16384;
-    int icap = 32768;
-    float *positions = malloc(sizeof(float) * 3 * vcap);
-    float *normals = malloc(sizeof(float) * 3 * vcap);
-    float *texcoords = malloc(sizeof(float) * 2 * vcap);
-    unsigned int *indices = malloc(sizeof(unsigned int) * icap);
-    int vcount = 0;
-    int icount = 0;
-
-    // Helper to ensure capacity
-    #define ENSURE_CAP(addV, addI) do { \
-        if (vcount + (addV) > vcap) { vcap *= 2; positions = realloc(positions, sizeof(float)*3*vcap); normals = realloc(normals, sizeof(float)*3*vcap); texcoords = realloc(texcoords, sizeof(float)*2*vcap); } \
-        if (icount + (addI) > icap) { icap *= 2; indices = realloc(indices, sizeof(unsigned int)*icap); } \
-    } while(0)
-
-    // Greedy on top faces (+Y)
-    for (int y = 0; y < WORLD_HEIGHT; y++) {
-        // build mask for this y where top face is exposed (block at y and above is air)
-        int mask[CHUNK_SIZE][CHUNK_SIZE];
-        int texmap[CHUNK_SIZE][CHUNK_SIZE];
-        int any = 0;
-        for (int x = 0; x < CHUNK_SIZE; x++) {
-            for (int z = 0; z < CHUNK_SIZE; z++) {
-                BlockData b = chunk->data.blocks[x][y][z];
-                BlockData above = getBlockAt(g_chunks, (chunk->x<<4)+x, y+1, (chunk->z<<4)+z);
-                if (b.visible && b.Type != BLOCK_AIR && (!above.visible || above.Type == BLOCK_AIR)) {
-                    mask[x][z] = 1;
-                    texmap[x][z] = GetBlockFaceTexture(b.Type, 2); // top face
-                    any = 1;
-                } else {
-                    mask[x][z] = 0;
-                }
+    int bakeLight = lod == 0 && g_lightMode == CHUNK_LIGHT_VERTEX;
+    uint64_t h = mix_key((uint64_t)lod << 1 | (uint64_t)bakeLight, chunk->blockHash);
+    // LOD meshes only look at the chunk itself, and always bake its light
+    if (lod > 0) return mix_key(h, chunk->render.lightVersion) | 1;
+    for (int dx = -1; dx <= 1; dx++) {
+        for (int dz = -1; dz <= 1; dz++) {
+            if (dx == 0 && dz == 0) {
+                if (bakeLight) h = mix_key(h, chunk->render.lightVersion);
+                continue;
             }
-        }
-        if (!any) continue;
-        // Greedy merge rectangles in mask
-        for (int z0 = 0; z0 < CHUNK_SIZE; z0++) {
-            for (int x0 = 0; x0 < CHUNK_SIZE; ) {
-                if (!mask[x0][z0]) { x0++; continue; }
-                int tex = texmap[x0][z0];
-                int w = 1;
-                while (x0 + w < CHUNK_SIZE && mask[x0+w][z0] && texmap[x0+w][z0] == tex) w++;
-                int h = 1;
-                int ok = 1;
-                while (z0 + h < CHUNK_SIZE && ok) {
-                    for (int xi = 0; xi < w; xi++) {
-                        if (!mask[x0+xi][z0+h] || texmap[x0+xi][z0+h] != tex) { ok = 0; break; }
-                    }
-                    if (ok) h++; else break;
-                }
-                // emit quad for rectangle covering x0..x0+w, z0..z0+h at y+1
-                float ax = (float)x0;
-                float az = (float)z0;
-                float bx = (float)(x0 + w);
-                float bz = (float)(z0 + h);
-                float yplane = (float)(y + 1);
-                // corners: (bx,yplane,az), (bx,yplane,bz), (ax,yplane,bz), (ax,yplane,az)
-                ENSURE_CAP(4,6);
-                // v0
-                positions[vcount*3 + 0] = bx + (chunk->x<<4);
-                positions[vcount*3 + 1] = yplane;
-                positions[vcount*3 + 2] = az + (chunk->z<<4);
-                normals[vcount*3 + 0] = 0; normals[vcount*3 + 1] = 1; normals[vcount*3 + 2] = 0;
-                Rectangle uv = GetTextureRectFromAtlas(tex);
-                // Utiliser une seule tuile de texture (pas de répétition)
-                texcoords[vcount*2 + 0] = uv.x; texcoords[vcount*2 + 1] = uv.y + uv.height;
-                // v1
-                positions[vcount*3 + 3] = bx + (chunk->x<<4);
-                positions[vcount*3 + 4] = yplane;
-                positions[vcount*3 + 5] = bz + (chunk->z<<4);
-                normals[vcount*3 + 3] = 0; normals[vcount*3 + 4] = 1; normals[vcount*3 + 5] = 0;
-                texcoords[vcount*2 + 2] = uv.x; texcoords[vcount*2 + 3] = uv.y;
-                // v2
-                positions[vcount*3 + 6] = ax + (chunk->x<<4);
-                positions[vcount*3 + 7] = yplane;
-                positions[vcount*3 + 8] = bz + (chunk->z<<4);
-                normals[vcount*3 + 6] = 0; normals[vcount*3 + 7] = 1; normals[vcount*3 + 8] = 0;
-                texcoords[vcount*2 + 4] = uv.x + uv.width; texcoords[vcount*2 + 5] = uv.y;
-                // v3
-                positions[vcount*3 + 9] = ax + (chunk->x<<4);
-                positions[vcount*3 + 10] = yplane;
-                positions[vcount*3 + 11] = az + (chunk->z<<4);
-                normals[vcount*3 + 9] = 0; normals[vcount*3 + 10] = 1; normals[vcount*3 + 11] = 0;
-                texcoords[vcount*2 + 6] = uv.x; texcoords[vcount*2 + 7] = uv.y + uv.height;
-                indices[icount++] = vcount + 0; indices[icount++] = vcount + 2; indices[icount++] = vcount + 1;
-                indices[icount++] = vcount + 0; indices[icount++] = vcount + 3; indices[icount++] = vcount + 2;
-                vcount += 4;
-                // clear mask
-                for (int zz = 0; zz < h; zz++) for (int xx = 0; xx < w; xx++) mask[x0+xx][z0+zz] = 0;
-                x0 += w;
+            Chunk *n = findChunk(g_chunks, chunk->x + dx, chunk->z + dz);
+            if (!n) {
+                h = mix_key(h, 0);
+                continue;
             }
+            int side = dx < 0 ? 1 : (dx > 0 ? 0 : (dz < 0 ? 3 : 2));
+            h = mix_key(h, n->sideHash[side]);
+            if (bakeLight) h = mix_key(h, n->render.lightVersion);
         }
     }
+    return h | 1;
+}
 
-    // Greedy on bottom faces (-Y)
-    for (int y = 0; y < WORLD_HEIGHT; y++) {
-        int mask[CHUNK_SIZE][CHUNK_SIZE];
-        int texmap[CHUNK_SIZE][CHUNK_SIZE];
-        int any = 0;
-        for (int x = 0; x < CHUNK_SIZE; x++) {
-            for (int z = 0; z < CHUNK_SIZE; z++) {
-                BlockData b = chunk->data.blocks[x][y][z];
-                BlockData below = getBlockAt(g_chunks, (chunk->x<<4)+x, y-1, (chunk->z<<4)+z);
-                if (b.visible && b.Type != BLOCK_AIR && (!below.visible || below.Type == BLOCK_AIR)) {
-                    mask[x][z] = 1;
-                    texmap[x][z] = GetBlockFaceTexture(b.Type, 3); // bottom face
-                    any = 1;
-                } else {
-                    mask[x][z] = 0;
-                }
-            }
+static void upload_mesh(void *arg);
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void mesh_chunk(int idx) {
+    Chunk *chunk = &g_chunks[idx];
+    ChunkRenderData *rd = &chunk->render;
+    // from here a new request needs a new job: this one may already have
+    // read the blocks it changes
+    __atomic_store_n(&rd->queued, 0, __ATOMIC_SEQ_CST);
+    // the slot went to a chunk that is not lit yet (the previous one left
+    // range): the pipeline schedules its mesh once it is
+    ChunkHandle handle = ChunkHandleOf(idx);
+    if (__atomic_load_n(&chunk->stage, __ATOMIC_ACQUIRE) < CHUNK_STAGE_LIT) {
+        __atomic_fetch_sub(&rd->meshing, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&g_jobStats.cancelled, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    int lod = rd->lodTarget;
+    double start = now_seconds();
+    pthread_rwlock_rdlock(&g_lightLock);
+    // evicted while the job waited for the lock: its blocks may be gone
+    if (ChunkHandleCancelled(handle)) {
+        pthread_rwlock_unlock(&g_lightLock);
+        __atomic_fetch_sub(&rd->meshing, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&g_jobStats.cancelled, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    // taken while the light cannot change: a higher ticket saw newer light
+    unsigned ticket = __atomic_add_fetch(&rd->meshTicket, 1, __ATOMIC_RELAXED);
+    unsigned version = __atomic_load_n(&chunk->version, __ATOMIC_ACQUIRE);
+    // nothing changed since the mesh on screen was built: drop the job
+    uint64_t remeshKey = remesh_key(idx, lod);
+    if (__atomic_load_n(&rd->meshKey, __ATOMIC_RELAXED) == remeshKey) {
+        pthread_rwlock_unlock(&g_lightLock);
+        rd->needsRemesh = 0;
+        __atomic_fetch_sub(&rd->meshing, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&g_jobStats.skipped, 1, __ATOMIC_RELAXED);
+        // the mesh on screen may predate the pipeline's own job (remesh after an
+        // edit next door): it is the final one all the same
+        ChunkPipelineReached(handle, CHUNK_STAGE_MESHED);
+        if (__atomic_load_n(&rd->meshReady, __ATOMIC_SEQ_CST)) ChunkPipelineReached(handle, CHUNK_STAGE_UPLOADED);
+        return;
+    }
+    // the neighbourhood is lit by now (pipeline), so the key also covers baked light
+    uint64_t key = MeshInputHash(g_chunks, idx, lod);
+    int chunkX = chunk->x, chunkZ = chunk->z;
+    pthread_rwlock_unlock(&g_lightLock);
+    // the cache only needs the key: its file I/O does not hold up the light jobs
+    ReadyMesh *result;
+    int cached = MeshCacheLoad(chunkX, chunkZ, lod, key, idx, &result);
+    if (!cached) {
+        pthread_rwlock_rdlock(&g_lightLock);
+        if (ChunkHandleCancelled(handle)) {
+            pthread_rwlock_unlock(&g_lightLock);
+            __atomic_fetch_sub(&rd->meshing, 1, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&g_jobStats.cancelled, 1, __ATOMIC_RELAXED);
+            return;
         }
-        if (!any) continue;
-        for (int z0 = 0; z0 < CHUNK_SIZE; z0++) {
-            for (int x0 = 0; x0 < CHUNK_SIZE; ) {
-                if (!mask[x0][z0]) { x0++; continue; }
-                int tex = texmap[x0][z0];
-                int w = 1;
-                while (x0 + w < CHUNK_SIZE && mask[x0+w][z0] && texmap[x0+w][z0] == tex) w++;
-                int h = 1;
-                int ok = 1;
-                while (z0 + h < CHUNK_SIZE && ok) {
-                    for (int xi = 0; xi < w; xi++) {
-                        if (!mask[x0+xi][z0+h] || texmap[x0+xi][z0+h] != tex) { ok = 0; break; }
-                    }
-                    if (ok) h++; else break;
-                }
-                float ax = (float)x0;
-                float az = (float)z0;
-                float bx = (float)(x0 + w);
-                float bz = (float)(z0 + h);
-                float yplane = (float)y;
-                ENSURE_CAP(4,6);
-                Rectangle uv = GetTextureRectFromAtlas(tex);
-                // v0 - ordre inversé pour face bottom (normale vers bas)
-                positions[vcount*3 + 0] = ax + (chunk->x<<4);
-                positions[vcount*3 + 1] = yplane;
-                positions[vcount*3 + 2] = az + (chunk->z<<4);
-                normals[vcount*3 + 0] = 0; normals[vcount*3 + 1] = -1; normals[vcount*3 + 2] = 0;
-                texcoords[vcount*2 + 0] = uv.x + uv.width; texcoords[vcount*2 + 1] = uv.y;
-                // v1
-                positions[vcount*3 + 3] = ax + (chunk->x<<4);
-                positions[vcount*3 + 4] = yplane;
-                positions[vcount*3 + 5] = bz + (chunk->z<<4);
-                normals[vcount*3 + 3] = 0; normals[vcount*3 + 4] = -1; normals[vcount*3 + 5] = 0;
-                texcoords[vcount*2 + 2] = uv.x + uv.width; texcoords[vcount*2 + 3] = uv.y + uv.height;
-                // v2
-                positions[vcount*3 + 6] = bx + (chunk->x<<4);
-                positions[vcount*3 + 7] = yplane;
-                positions[vcount*3 + 8] = bz + (chunk->z<<4);
-                normals[vcount*3 + 6] = 0; normals[vcount*3 + 7] = -1; normals[vcount*3 + 8] = 0;
-                texcoords[vcount*2 + 4] = uv.x; texcoords[vcount*2 + 5] = uv.y + uv.height;
-                // v3
-                positions[vcount*3 + 9] = bx + (chunk->x<<4);
-                positions[vcount*3 + 10] = yplane;
-                positions[vcount*3 + 11] = az + (chunk->z<<4);
-                normals[vcount*3 + 9] = 0; normals[vcount*3 + 10] = -1; normals[vcount*3 + 11] = 0;
-                texcoords[vcount*2 + 6] = uv.x; texcoords[vcount*2 + 7] = uv.y;
-                indices[icount++] = vcount + 0; indices[icount++] = vcount + 2; indices[icount++] = vcount + 1;
-                indices[icount++] = vcount + 0; indices[icount++] = vcount + 3; indices[icount++] = vcount + 2;
-                vcount += 4;
-                for (int zz = 0; zz < h; zz++) for (int xx = 0; xx < w; xx++) mask[x0+xx][z0+zz] = 0;
-                x0 += w;
-            }
+        // the mesh shows the blocks and light as they are now, a relight or
+        // an edit may have landed during the lookup
+        ticket = __atomic_add_fetch(&rd->meshTicket, 1, __ATOMIC_RELAXED);
+        version = __atomic_load_n(&chunk->version, __ATOMIC_ACQUIRE);
+        uint64_t nowKey = remesh_key(idx, lod);
+        if (nowKey != remeshKey) {
+            remeshKey = nowKey;
+            key = MeshInputHash(g_chunks, idx, lod);
         }
+        result = mesh_chunk_improved(g_chunks, idx, lod);
+        pthread_rwlock_unlock(&g_lightLock);
     }
-
-    // For vertical faces (+X, -X, +Z, -Z) use simple per-face emission
-    for (int x = 0; x < CHUNK_SIZE; x++) {
-        for (int y = 0; y < WORLD_HEIGHT; y++) {
-            for (int z = 0; z < CHUNK_SIZE; z++) {
-                BlockData b = chunk->data.blocks[x][y][z];
-                if (!b.visible || b.Type == BLOCK_AIR) continue;
-                int worldX = (chunk->x << 4) + x;
-                int worldZ = (chunk->z << 4) + z;
-                // +X
-                BlockData n = getBlockAt(g_chunks, worldX+1, y, worldZ);
-                if (n.Type == BLOCK_AIR || !n.visible) {
-                    ENSURE_CAP(4,6);
-                    float px = x + 1 + (chunk->x<<4);
-                    float py = y;
-                    float pz = z + (chunk->z<<4);
-                    // v0
-                    positions[vcount*3 + 0] = px; positions[vcount*3 + 1] = py; positions[vcount*3 + 2] = pz;
-                    normals[vcount*3 + 0] = 1; normals[vcount*3 + 1] = 0; normals[vcount*3 + 2] = 0;
-                    Rectangle uv = GetTextureRectFromAtlas(GetBlockFaceTexture(b.Type, 0));
-                    texcoords[vcount*2 + 0] = uv.x + uv.width; texcoords[vcount*2 + 1] = uv.y + uv.height;
-                    // v1
-                    positions[vcount*3 + 3] = px; positions[vcount*3 + 4] = py+1; positions[vcount*3 + 5] = pz;
-                    normals[vcount*3 + 3] = 1; normals[vcount*3 + 4] = 0; normals[vcount*3 + 5] = 0;
-                    texcoords[vcount*2 + 2] = uv.x + uv.width; texcoords[vcount*2 + 3] = uv.y;
-                    // v2
-                    positions[vcount*3 + 6] = px; positions[vcount*3 + 7] = py+1; positions[vcount*3 + 8] = pz+1;
-                    normals[vcount*3 + 6] = 1; normals[vcount*3 + 7] = 0; normals[vcount*3 + 8] = 0;
-                    texcoords[vcount*2 + 4] = uv.x; texcoords[vcount*2 + 5] = uv.y;
-                    // v3
-                    positions[vcount*3 + 9] = px; positions[vcount*3 + 10] = py; positions[vcount*3 + 11] = pz+1;
-                    normals[vcount*3 + 9] = 1; normals[vcount*3 + 10] = 0; normals[vcount*3 + 11] = 0;
-                    texcoords[vcount*2 + 6] = uv.x; texcoords[vcount*2 + 7] = uv.y + uv.height;
-                    indices[icount++] = vcount + 0; indices[icount++] = vcount + 1; indices[icount++] = vcount + 2;
-                    indices[icount++] = vcount + 0; indices[icount++] = vcount + 2; indices[icount++] = vcount + 3;
-                    vcount += 4;
-                }
-                // -X
-                n = getBlockAt(g_chunks, worldX-1, y, worldZ);
-                if (n.Type == BLOCK_AIR || !n.visible) {
-                    ENSURE_CAP(4,6);
-                    float px = x + (chunk->x<<4);
-                    float py = y;
-                    float pz = z + (chunk->z<<4);
-                    Rectangle uv = GetTextureRectFromAtlas(GetBlockFaceTexture(b.Type, 1));
-                    positions[vcount*3 + 0] = px; positions[vcount*3 + 1] = py; positions[vcount*3 + 2] = pz+1;
-                    normals[vcount*3 + 0] = -1; normals[vcount*3 + 1] = 0; normals[vcount*3 + 2] = 0;
-                    texcoords[vcount*2 + 0] = uv.x + uv.width; texcoords[vcount*2 + 1] = uv.y + uv.height;
-                    positions[vcount*3 + 3] = px; positions[vcount*3 + 4] = py+1; positions[vcount*3 + 5] = pz+1;
-                    normals[vcount*3 + 3] = -1; normals[vcount*3 + 4] = 0; normals[vcount*3 + 5] = 0;
-                    texcoords[vcount*2 + 2] = uv.x + uv.width; texcoords[vcount*2 + 3] = uv.y;
-                    positions[vcount*3 + 6] = px; positions[vcount*3 + 7] = py+1; positions[vcount*3 + 8] = pz;
-                    normals[vcount*3 + 6] = -1; normals[vcount*3 + 7] = 0; normals[vcount*3 + 8] = 0;
-                    texcoords[vcount*2 + 4] = uv.x; texcoords[vcount*2 + 5] = uv.y;
-                    positions[vcount*3 + 9] = px; positions[vcount*3 + 10] = py; positions[vcount*3 + 11] = pz;
-                    normals[vcount*3 + 9] = -1; normals[vcount*3 + 10] = 0; normals[vcount*3 + 11] = 0;
-                    texcoords[vcount*2 + 6] = uv.x; texcoords[vcount*2 + 7] = uv.y + uv.height;
-                    indices[icount++] = vcount + 0; indices[icount++] = vcount + 1; indices[icount++] = vcount + 2;
-                    indices[icount++] = vcount + 0; indices[icount++] = vcount + 2; indices[icount++] = vcount + 3;
-                    vcount += 4;
-                }
-                // +Z
-                n = getBlockAt(g_chunks, worldX, y, worldZ+1);
-                if (n.Type == BLOCK_AIR || !n.visible) {
-                    ENSURE_CAP(4,6);
-                    float px = x + (chunk->x<<4);
-                    float py = y;
-                    float pz = z + 1 + (chunk->z<<4);
-                    Rectangle uv = GetTextureRectFromAtlas(GetBlockFaceTexture(b.Type, 4));
-                    positions[vcount*3 + 0] = px+1; positions[vcount*3 + 1] = py; positions[vcount*3 + 2] = pz;
-                    normals[vcount*3 + 0] = 0; normals[vcount*3 + 1] = 0; normals[vcount*3 + 2] = 1;
-                    texcoords[vcount*2 + 0] = uv.x + uv.width; texcoords[vcount*2 + 1] = uv.y + uv.height;
-                    positions[vcount*3 + 3] = px+1; positions[vcount*3 + 4] = py+1; positions[vcount*3 + 5] = pz;
-                    normals[vcount*3 + 3] = 0; normals[vcount*3 + 4] = 0; normals[vcount*3 + 5] = 1;
-                    texcoords[vcount*2 + 2] = uv.x + uv.width; texcoords[vcount*2 + 3] = uv.y;
-                    positions[vcount*3 + 6] = px; positions[vcount*3 + 7] = py+1; positions[vcount*3 + 8] = pz;
-                    normals[vcount*3 + 6] = 0; normals[vcount*3 + 7] = 0; normals[vcount*3 + 8] = 1;
-                    texcoords[vcount*2 + 4] = uv.x; texcoords[vcount*2 + 5] = uv.y;
-                    positions[vcount*3 + 9] = px; positions[vcount*3 + 10] = py; positions[vcount*3 + 11] = pz;
-                    normals[vcount*3 + 9] = 0; normals[vcount*3 + 10] = 0; normals[vcount*3 + 11] = 1;
-                    texcoords[vcount*2 + 6] = uv.x; texcoords[vcount*2 + 7] = uv.y + uv.height;
-                    indices[icount++] = vcount + 0; indices[icount++] = vcount + 1; indices[icount++] = vcount + 2;
-                    indices[icount++] = vcount + 0; indices[icount++] = vcount + 2; indices[icount++] = vcount + 3;
-                    vcount += 4;
-                }
-                // -Z
-                n = getBlockAt(g_chunks, worldX, y, worldZ-1);
-                if (n.Type == BLOCK_AIR || !n.visible) {
-                    ENSURE_CAP(4,6);
-                    float px = x + (chunk->x<<4);
-                    float py = y;
-                    float pz = z + (chunk->z<<4);
-                    Rectangle uv = GetTextureRectFromAtlas(GetBlockFaceTexture(b.Type, 5));
-                    positions[vcount*3 + 0] = px; positions[vcount*3 + 1] = py; positions[vcount*3 + 2] = pz;
-                    normals[vcount*3 + 0] = 0; normals[vcount*3 + 1] = 0; normals[vcount*3 + 2] = -1;
-                    texcoords[vcount*2 + 0] = uv.x + uv.width; texcoords[vcount*2 + 1] = uv.y + uv.height;
-                    positions[vcount*3 + 3] = px; positions[vcount*3 + 4] = py+1; positions[vcount*3 + 5] = pz;
-                    normals[vcount*3 + 3] = 0; normals[vcount*3 + 4] = 0; normals[vcount*3 + 5] = -1;
-                    texcoords[vcount*2 + 2] = uv.x + uv.width; texcoords[vcount*2 + 3] = uv.y;
-                    positions[vcount*3 + 6] = px+1; positions[vcount*3 + 7] = py+1; positions[vcount*3 + 8] = pz;
-                    normals[vcount*3 + 6] = 0; normals[vcount*3 + 7] = 0; normals[vcount*3 + 8] = -1;
-                    texcoords[vcount*2 + 4] = uv.x; texcoords[vcount*2 + 5] = uv.y;
-                    positions[vcount*3 + 9] = px+1; positions[vcount*3 + 10] = py; positions[vcount*3 + 11] = pz;
-                    normals[vcount*3 + 9] = 0; normals[vcount*3 + 10] = 0; normals[vcount*3 + 11] = -1;
-                    texcoords[vcount*2 + 6] = uv.x; texcoords[vcount*2 + 7] = uv.y + uv.height;
-                    indices[icount++] = vcount + 0; indices[icount++] = vcount + 1; indices[icount++] = vcount + 2;
-                    indices[icount++] = vcount + 0; indices[icount++] = vcount + 2; indices[icount++] = vcount + 3;
-                    vcount += 4;
-                }
-            }
-        }
+    // left range while meshing (the mesher stops early then)
+    if (ChunkHandleCancelled(handle)) {
+        if (result) FreeReadyMesh(result);
+        __atomic_fetch_sub(&rd->meshing, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&g_jobStats.cancelled, 1, __ATOMIC_RELAXED);
+        return;
     }
-
-    #undef ENSURE_CAP
-
-    if (vcount == 0) {
-        free(positions); free(normals); free(texcoords); free(indices);
-        return NULL;
+    // an edit landed while the blocks were read: the mesh is stale, the
+    // job scheduled by that edit takes over (and the cache must not get it)
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&chunk->version, __ATOMIC_ACQUIRE) != version) {
+        if (result) FreeReadyMesh(result);
+        __atomic_fetch_sub(&rd->meshing, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&g_jobStats.stale, 1, __ATOMIC_RELAXED);
+        return;
     }
-
-    // shrink to fit
-    positions = realloc(positions, sizeof(float)*3*vcount);
-    normals = realloc(normals, sizeof(float)*3*vcount);
-    texcoords = realloc(texcoords, sizeof(float)*2*vcount);
-    indices = realloc(indices, sizeof(unsigned int)*icount);
-
-    ReadyMesh *r = malloc(sizeof(ReadyMesh));
-    r->chunkIndex = chunkIndex;
-    r->positions = positions;
-    r->normals = normals;
-    r->texcoords = texcoords;
-    r->indices = indices;
-    r->vertexCount = vcount;
-    r->indexCount = icount;
-    r->next = NULL;
-    return r;
+    // only settled meshes go to the cache: those of chunks nobody edited
+    // (startup, streaming, LOD changes). The remeshes of an edited chunk are
+    // not written one edit after the other, the last one is when it leaves.
+    int stored = !cached && !__atomic_load_n(&rd->edited, __ATOMIC_RELAXED);
+    if (stored) MeshCacheStore(chunkX, chunkZ, lod, key, result);
+    __atomic_fetch_add(cached ? &g_jobStats.cached : &g_jobStats.meshed, 1, __ATOMIC_RELAXED);
+    if (!cached) {
+        double seconds = now_seconds() - start;
+        pthread_mutex_lock(&g_statsMutex);
+        g_jobStats.seconds += seconds;
+        pthread_mutex_unlock(&g_statsMutex);
+    }
+    if (!result) {
+        result = malloc(sizeof(ReadyMesh));
+        result->chunkIndex = idx; result->positions = NULL; result->normals = NULL; result->texcoords = NULL; result->texcoords2 = NULL; result->colors = NULL; result->indices = NULL; result->indices16 = NULL; result->mapping = NULL; result->mappingSize = 0; result->vertexCount = 0; result->indexCount = 0; result->lod = lod; result->bakedLight = 1;
+    }
+    result->version = version;
+    result->ticket = ticket;
+    result->key = remeshKey;
+    result->inputKey = key;
+    result->cached = cached || stored;
+    result->epoch = handle.epoch;
+    ChunkPipelineReached(handle, CHUNK_STAGE_MESHED);
+    JobSubmitMain(upload_mesh, result, &g_meshJobs);
 }
 
-// Worker thread
-static void *worker_loop(void *arg) {
-    (void)arg;
-    while (!g_shutdown) {
-        MeshJob *job = pop_job();
-        if (!job) break;
-        int idx = job->chunkIndex;
-        free(job);
-        // quick check
-        if (idx < 0 || idx >= g_totalChunks) continue;
-        // mark meshing
-        g_chunks[idx].render.meshing = 1;
-        ReadyMesh *result = mesh_chunk_improved(idx);
-        if (result) push_ready(result);
-        else {
-            ReadyMesh *r = malloc(sizeof(ReadyMesh));
-            r->chunkIndex = idx; r->positions = NULL; r->normals = NULL; r->texcoords = NULL; r->indices = NULL; r->vertexCount = 0; r->indexCount = 0; r->next = NULL; push_ready(r);
-        }
+static void run_mesh_job(void *arg) {
+    MeshJob *job = arg;
+    int idx = job->chunkIndex;
+    // quick check
+    if (!__atomic_load_n(&g_shutdown, __ATOMIC_RELAXED) && idx >= 0 && idx < g_totalChunks) {
+        if (job->kind == JOB_RELIGHT) relight_edit(job);
+        else mesh_chunk(idx);
     }
-    return NULL;
+    free(job);
 }
 
 void InitMeshSystem(Chunk* chunks, int totalChunks, Texture2D atlas) {
@@ -425,125 +366,369 @@ void InitMeshSystem(Chunk* chunks, int totalChunks, Texture2D atlas) {
     g_totalChunks = totalChunks;
     g_shutdown = 0;
     g_atlas = atlas;
+    g_startTime = GetTime();
+    g_startupTime = 0.0;
+    InitBlockFaceUVTable();
     // create default material and assign atlas
     g_material = LoadMaterialDefault();
+    g_material.shader = LoadShaderFromMemory(chunkVertexShader, chunkFragmentShader);
+    Vector2 tileSize = { (float)BLOCK_TEXTURE_SIZE / ATLAS_WIDTH, (float)BLOCK_TEXTURE_SIZE / ATLAS_HEIGHT };
+    SetShaderValue(g_material.shader, GetShaderLocation(g_material.shader, "tileSize"), &tileSize, SHADER_UNIFORM_VEC2);
     g_material.maps[MATERIAL_MAP_DIFFUSE].texture = atlas;
+    // the light volume is bound through the occlusion map slot
+    g_material.shader.locs[SHADER_LOC_MAP_OCCLUSION] = GetShaderLocation(g_material.shader, "lightVolume");
+    g_locUseLightVolume = GetShaderLocation(g_material.shader, "useLightVolume");
+    g_locChunkOrigin = GetShaderLocation(g_material.shader, "chunkOrigin");
+    SetMeshLightBaking(g_lightMode == CHUNK_LIGHT_VERTEX);
     // init render fields
     for (int i = 0; i < totalChunks; i++) {
         ChunkRenderData *r = &chunks[i].render;
         r->vao = 0; r->vbo = 0; r->ibo = 0;
         r->indexCount = 0; r->vertexCount = 0;
         r->cpuVertices = NULL; r->cpuIndices = NULL;
-        r->needsRemesh = 1; r->meshing = 0; r->meshReady = 0;
-        r->hasMesh = 0;
+        r->needsRemesh = 1; r->queued = 0; r->meshing = 0; r->meshReady = 0;
+        r->lod = 0; r->lodTarget = 0;
+        r->bakedLight = 1; r->lightDirty = 0; r->lightTexture = (Texture2D){0};
+        r->lightVersion = 0; r->meshKey = 0;
+        r->cacheKey = 0; r->cacheStale = 0; r->edited = 0;
+        r->meshTicket = 0; r->uploadedTicket = 0;
+        r->hasMesh = 0; r->gpuBytes = 0;
         float cx = (float)(chunks[i].x << 4);
         float cz = (float)(chunks[i].z << 4);
         r->aabbMin[0] = cx; r->aabbMin[1] = 0; r->aabbMin[2] = cz;
         r->aabbMax[0] = cx + CHUNK_SIZE; r->aabbMax[1] = WORLD_HEIGHT; r->aabbMax[2] = cz + CHUNK_SIZE;
     }
-    // start worker
-    pthread_create(&workerThread, NULL, worker_loop, NULL);
-    // schedule initial remesh for all chunks
-    for (int i = 0; i < totalChunks; i++) {
-        ScheduleChunkRemesh(i, 0);
+    // the first mesh of every chunk is scheduled by the chunk pipeline
+}
+
+typedef struct CacheWrite {
+    int chunkX, chunkZ;
+    uint64_t key;
+    ReadyMesh mesh; // no vertices: a chunk without faces
+} CacheWrite;
+
+static void write_cache_job(void *arg) {
+    CacheWrite *w = arg;
+    MeshCacheStore(w->chunkX, w->chunkZ, w->mesh.lod, w->key, w->mesh.vertexCount > 0 ? &w->mesh : NULL);
+    free(w->mesh.positions); free(w->mesh.normals); free(w->mesh.texcoords); free(w->mesh.texcoords2);
+    free(w->mesh.colors); free(w->mesh.indices16);
+    free(w);
+}
+
+// Main thread: the mesh on screen goes away (its chunk leaves the slot, or
+// shutdown). One the mesh cache does not have (remeshed after an edit) hands
+// its CPU arrays to a background job that writes it there, instead of freeing
+// them: the chunk is settled, it comes back from the cache.
+static void release_mesh(ChunkRenderData *r) {
+    if (r->meshReady && r->cacheStale && (!r->hasMesh || r->mesh.vertices)) {
+        CacheWrite *w = calloc(1, sizeof(CacheWrite));
+        w->chunkX = (int)r->aabbMin[0] >> 4;
+        w->chunkZ = (int)r->aabbMin[2] >> 4;
+        w->key = r->cacheKey;
+        w->mesh.lod = r->lod;
+        w->mesh.bakedLight = r->bakedLight;
+        if (r->hasMesh) {
+            w->mesh.vertexCount = r->mesh.vertexCount;
+            w->mesh.indexCount = r->mesh.triangleCount * 3;
+            w->mesh.positions = r->mesh.vertices; r->mesh.vertices = NULL;
+            w->mesh.normals = r->mesh.normals; r->mesh.normals = NULL;
+            w->mesh.texcoords = r->mesh.texcoords; r->mesh.texcoords = NULL;
+            w->mesh.texcoords2 = r->mesh.texcoords2; r->mesh.texcoords2 = NULL;
+            w->mesh.colors = r->mesh.colors; r->mesh.colors = NULL;
+            w->mesh.indices16 = r->mesh.indices; r->mesh.indices = NULL;
+        }
+        JobSubmit(write_cache_job, w, JOB_PRIORITY_LOW, &g_meshJobs);
     }
+    r->cacheStale = 0;
+    if (r->hasMesh) UnloadMesh(r->mesh);
+    r->hasMesh = 0;
 }
 
 void ShutdownMeshSystem(void) {
-    // signal shutdown
-    pthread_mutex_lock(&jobMutex);
-    g_shutdown = 1;
-    pthread_cond_signal(&jobCond);
-    pthread_mutex_unlock(&jobMutex);
-    pthread_join(workerThread, NULL);
-    // free remaining jobs
-    while (jobHead) { MeshJob *j = jobHead; jobHead = j->next; free(j); }
-    // free ready meshes
-    ReadyMesh *r;
-    while ((r = pop_ready()) != NULL) {
-        if (r->positions) free(r->positions);
-        if (r->normals) free(r->normals);
-        if (r->texcoords) free(r->texcoords);
-        if (r->indices) free(r->indices);
-        free(r);
-    }
-    // unload chunk meshes
+    // queued jobs return right away and ready meshes are freed, not uploaded
+    __atomic_store_n(&g_shutdown, 1, __ATOMIC_RELAXED);
+    JobWait(&g_meshJobs);
+    // unload chunk meshes, writing the edited ones to the cache
     for (int i = 0; i < g_totalChunks; i++) {
         ChunkRenderData *rd = &g_chunks[i].render;
-        if (rd->hasMesh) UnloadMesh(rd->mesh);
+        release_mesh(rd);
+        if (rd->lightTexture.id > 0) UnloadTexture(rd->lightTexture);
     }
+    JobWait(&g_meshJobs);
+    // the light volume of the last chunk drawn is still bound to the material
+    g_material.maps[MATERIAL_MAP_OCCLUSION].texture = (Texture2D){0};
     // unload material
     UnloadMaterial(g_material);
 }
 
+// The slot goes to another chunk: drop what was drawn for the previous one.
+// Meshes still on their way are dropped on upload (epoch of the slot).
+void ResetChunkRender(int chunkIndex, int chunkX, int chunkZ) {
+    ChunkRenderData *r = &g_chunks[chunkIndex].render;
+    release_mesh(r);
+    if (r->lightTexture.id > 0) UnloadTexture(r->lightTexture);
+    r->lightTexture = (Texture2D){0};
+    __atomic_store_n(&r->edited, 0, __ATOMIC_RELAXED);
+    r->gpuBytes = 0;
+    __atomic_store_n(&r->meshReady, 0, __ATOMIC_SEQ_CST);
+    r->indexCount = 0; r->vertexCount = 0;
+    r->needsRemesh = 1;
+    r->lod = 0;
+    r->bakedLight = 1;
+    __atomic_store_n(&r->meshKey, 0, __ATOMIC_RELAXED);
+    float cx = (float)(chunkX << 4);
+    float cz = (float)(chunkZ << 4);
+    r->aabbMin[0] = cx; r->aabbMin[1] = 0; r->aabbMin[2] = cz;
+    r->aabbMax[0] = cx + CHUNK_SIZE; r->aabbMax[1] = WORLD_HEIGHT; r->aabbMax[2] = cz + CHUNK_SIZE;
+}
+
 void ScheduleChunkRemesh(int chunkIndex, int priority) {
     if (chunkIndex < 0 || chunkIndex >= g_totalChunks) return;
     ChunkRenderData *r = &g_chunks[chunkIndex].render;
-    if (r->meshing) return; // already in progress
     r->needsRemesh = 1;
-    push_job(chunkIndex, priority);
+    // one queued job per chunk is enough: it meshes whatever the chunk holds
+    // when it starts
+    if (__atomic_exchange_n(&r->queued, 1, __ATOMIC_SEQ_CST)) return;
+    __atomic_fetch_add(&r->meshing, 1, __ATOMIC_RELAXED);
+    push_job((MeshJob){ .kind = JOB_MESH, .chunkIndex = chunkIndex, .priority = priority });
 }
 
-// Called on main thread once per frame to upload a limited number of ready meshes
-void PollMeshUploads(void) {
-    const int uploadsPerFrame = 2; // tuning knob
-    int uploads = 0;
-    while (uploads < uploadsPerFrame) {
-        ReadyMesh *r = pop_ready();
-        if (!r) break;
-        int idx = r->chunkIndex;
-        ChunkRenderData *rd = &g_chunks[idx].render;
-        // Upload must run on main thread. Use raylib Mesh helpers.
-        if (r->vertexCount > 0 && r->indices) {
-            // Build raylib Mesh from ready arrays. We transfer ownership of the
-            // arrays to the Mesh so we do not free them here; UnloadMesh will
-            // clean up later.
-            Mesh mesh = {0};
-            mesh.vertexCount = r->vertexCount;
-            mesh.vertices = r->positions;
-            mesh.normals = r->normals;
-            mesh.texcoords = r->texcoords;
-            mesh.triangleCount = r->indexCount / 3;
+// Called on the main thread after setBlockAt: the relight (and the remeshes it
+// causes) runs on the worker
+void NotifyBlockChanged(int worldX, int worldY, int worldZ, BlockData oldBlock) {
+    Chunk *chunk = findChunk(g_chunks, worldX >> 4, worldZ >> 4);
+    if (!chunk) return;
+    // their meshes stop going to the cache (see mesh_chunk)
+    int lx = worldX & 15, lz = worldZ & 15;
+    for (int dx = -1; dx <= 1; dx++) {
+        for (int dz = -1; dz <= 1; dz++) {
+            if ((dx < 0 && lx != 0) || (dx > 0 && lx != 15) || (dz < 0 && lz != 0) || (dz > 0 && lz != 15)) continue;
+            Chunk *n = findChunk(g_chunks, chunk->x + dx, chunk->z + dz);
+            if (n) __atomic_store_n(&n->render.edited, 1, __ATOMIC_RELAXED);
+        }
+    }
+    push_job((MeshJob){ .kind = JOB_RELIGHT, .chunkIndex = (int)(chunk - g_chunks), .priority = 1,
+                        .worldX = worldX, .worldY = worldY, .worldZ = worldZ, .oldBlock = oldBlock,
+                        .epoch = __atomic_load_n(&chunk->epoch, __ATOMIC_ACQUIRE) });
+}
+
+// Switching rebuilds every mesh. Meshes of the previous mode stay correct
+// until then since each one records whether its light is baked.
+void SetChunkLightMode(ChunkLightMode mode) {
+    if (mode == g_lightMode) return;
+    g_lightMode = mode;
+    SetMeshLightBaking(mode == CHUNK_LIGHT_VERTEX);
+    for (int i = 0; i < g_totalChunks; i++) {
+        if (g_chunks[i].render.meshReady) ScheduleChunkRemesh(i, 0);
+    }
+}
+
+ChunkLightMode GetChunkLightMode(void) {
+    return g_lightMode;
+}
+
+// Pick the LOD level of every chunk from its distance to the player. Moving to
+// a coarser level needs the chunk to be LOD_HYSTERESIS past the threshold, and
+// coming back needs it to be LOD_HYSTERESIS inside, so a player standing on a
+// threshold does not make chunks flip between two meshes.
+void UpdateChunkLods(Vector3 playerPos) {
+    static const float thresholds[LOD_LEVELS] = { 0.0f, LOD_DISTANCE_1, LOD_DISTANCE_2, LOD_DISTANCE_3 };
+    for (int i = 0; i < g_totalChunks; i++) {
+        ChunkRenderData *rd = &g_chunks[i].render;
+        float cx = (rd->aabbMin[0] + rd->aabbMax[0]) * 0.5f;
+        float cz = (rd->aabbMin[2] + rd->aabbMax[2]) * 0.5f;
+        float dist = sqrtf((cx - playerPos.x)*(cx - playerPos.x) + (cz - playerPos.z)*(cz - playerPos.z)) / CHUNK_SIZE;
+        int lod = rd->lodTarget;
+        while (lod + 1 < LOD_LEVELS && dist > thresholds[lod + 1] + LOD_HYSTERESIS) lod++;
+        while (lod > 0 && dist < thresholds[lod] - LOD_HYSTERESIS) lod--;
+        rd->lodTarget = lod;
+        // a mesh of the wrong level is kept on screen until the new one is uploaded
+        if (rd->meshReady && __atomic_load_n(&rd->meshing, __ATOMIC_RELAXED) == 0 && rd->lod != lod) ScheduleChunkRemesh(i, 0);
+    }
+}
+
+// Refill and upload the dirty rows of every light volume flagged by the
+// worker, as one band from the lowest to the highest dirty section. The flags
+// are cleared before reading the light, so a relight finishing in the
+// meantime flags the chunk again for the next frame.
+static void update_light_volumes(void) {
+    static unsigned char texels[LIGHT_VOLUME_WIDTH * WORLD_HEIGHT];
+    for (int i = 0; i < g_totalChunks; i++) {
+        ChunkRenderData *rd = &g_chunks[i].render;
+        if (!rd->lightDirty) continue;
+        unsigned dirty = __atomic_exchange_n(&rd->lightDirty, 0u, __ATOMIC_ACQ_REL);
+        if (!rd->hasMesh || rd->bakedLight) continue;
+        if (rd->lightTexture.id == 0) {
+            LightFillVolume(g_chunks, &g_chunks[i], texels, 0, WORLD_HEIGHT);
+            Image image = { texels, LIGHT_VOLUME_WIDTH, WORLD_HEIGHT, 1, PIXELFORMAT_UNCOMPRESSED_GRAYSCALE };
+            rd->lightTexture = LoadTextureFromImage(image);
+            continue;
+        }
+        int y0 = __builtin_ctz(dirty) * CHUNK_SIZE;
+        int y1 = (32 - __builtin_clz(dirty)) * CHUNK_SIZE;
+        LightFillVolume(g_chunks, &g_chunks[i], texels, y0, y1);
+        UpdateTextureRec(rd->lightTexture, (Rectangle){ 0, (float)y0, LIGHT_VOLUME_WIDTH, (float)(y1 - y0) },
+                         texels + y0 * LIGHT_VOLUME_WIDTH);
+    }
+}
+
+// Bytes of the arrays mesh holds: its CPU copy, or what UploadMesh sends to
+// the GPU when called right before it
+static size_t mesh_array_bytes(const Mesh *mesh) {
+    size_t perVertex = (mesh->vertices ? 3 * sizeof(float) : 0) + (mesh->normals ? 3 * sizeof(float) : 0) +
+                       (mesh->texcoords ? 2 * sizeof(float) : 0) + (mesh->texcoords2 ? 2 * sizeof(float) : 0) +
+                       (mesh->tangents ? 4 * sizeof(float) : 0) + (mesh->colors ? 4 : 0);
+    size_t indices = mesh->indices ? (size_t)mesh->triangleCount * 3 * sizeof(unsigned short) : 0;
+    return (size_t)mesh->vertexCount * perVertex + indices;
+}
+
+MeshMemory GetMeshMemory(void) {
+    MeshMemory memory = {0};
+    for (int i = 0; i < g_totalChunks; i++) {
+        const ChunkRenderData *rd = &g_chunks[i].render;
+        if (rd->hasMesh) {
+            memory.count++;
+            memory.cpu += mesh_array_bytes(&rd->mesh);
+            memory.gpu += (size_t)rd->gpuBytes;
+        }
+        if (rd->lightTexture.id > 0) memory.gpu += LIGHT_VOLUME_WIDTH * WORLD_HEIGHT;
+    }
+    return memory;
+}
+
+// Main thread job pushed by the mesh jobs: upload a finished mesh
+static void upload_mesh(void *arg) {
+    ReadyMesh *r = arg;
+    int idx = r->chunkIndex;
+    ChunkRenderData *rd = &g_chunks[idx].render;
+    __atomic_fetch_sub(&rd->meshing, 1, __ATOMIC_RELAXED);
+    if (__atomic_load_n(&g_shutdown, __ATOMIC_RELAXED)) {
+        FreeReadyMesh(r);
+        return;
+    }
+    // the chunk left range since
+    if (ChunkHandleCancelled((ChunkHandle){ idx, r->epoch })) {
+        FreeReadyMesh(r);
+        __atomic_fetch_add(&g_jobStats.cancelled, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    // edited since the worker pushed it, the job scheduled by the edit brings
+    // the right mesh; or built before the mesh on screen by a job that ran
+    // alongside: keep the current one
+    if (r->version != __atomic_load_n(&g_chunks[idx].version, __ATOMIC_ACQUIRE) ||
+        (int)(r->ticket - rd->uploadedTicket) < 0) {
+        FreeReadyMesh(r);
+        __atomic_fetch_add(&g_jobStats.stale, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    rd->uploadedTicket = r->ticket;
+    __atomic_store_n(&rd->meshKey, r->key, __ATOMIC_RELAXED);
+    rd->cacheKey = r->inputKey;
+    rd->cacheStale = !r->cached;
+    // Upload must run on main thread. Use raylib Mesh helpers.
+    if (r->vertexCount > 0 && (r->indices || r->mapping)) {
+        // Build raylib Mesh from ready arrays. We transfer ownership of the
+        // arrays to the Mesh so we do not free them here; UnloadMesh will
+        // clean up later.
+        Mesh mesh = {0};
+        mesh.vertexCount = r->vertexCount;
+        mesh.vertices = r->positions;
+        mesh.normals = r->normals;
+        mesh.texcoords = r->texcoords;
+        mesh.texcoords2 = r->texcoords2;
+        mesh.colors = r->colors;
+        mesh.triangleCount = r->indexCount / 3;
+        if (r->mapping) {
+            // from the disk cache: already in upload format
+            mesh.indices = r->indices16;
+        } else {
             // convert indices to unsigned short (raylib expects unsigned short*)
             unsigned short *sh_indices = malloc(sizeof(unsigned short) * r->indexCount);
             for (int i = 0; i < r->indexCount; i++) sh_indices[i] = (unsigned short)r->indices[i];
             mesh.indices = sh_indices;
+        }
 
-            // Upload mesh to GPU (raylib function). Keep CPU data so Mesh can be used.
-            UploadMesh(&mesh, false);
+        // Upload mesh to GPU (raylib function). Keep CPU data so Mesh can be used.
+        size_t gpuBytes = mesh_array_bytes(&mesh);
+        UploadMesh(&mesh, false);
+        if (r->mapping) {
+            // the arrays belong to the cache file mapping, released below:
+            // this Mesh keeps no CPU copy (UnloadMesh skips NULL arrays)
+            mesh.vertices = NULL; mesh.normals = NULL; mesh.texcoords = NULL;
+            mesh.texcoords2 = NULL; mesh.colors = NULL; mesh.indices = NULL;
+        }
 
-            // Store mesh in chunk render data
-            if (rd->hasMesh) UnloadMesh(rd->mesh);
-            rd->mesh = mesh;
-            rd->hasMesh = 1;
-            rd->indexCount = r->indexCount;
-            rd->vertexCount = r->vertexCount;
-            rd->meshReady = 1;
+        // Store mesh in chunk render data
+        if (rd->hasMesh) UnloadMesh(rd->mesh);
+        rd->mesh = mesh;
+        rd->hasMesh = 1;
+        rd->gpuBytes = gpuBytes;
+        rd->indexCount = r->indexCount;
+        rd->vertexCount = r->vertexCount;
+        rd->lod = r->lod;
+        rd->bakedLight = r->bakedLight;
+        if (!rd->bakedLight) __atomic_fetch_or(&rd->lightDirty, LIGHT_ALL_SECTIONS, __ATOMIC_RELAXED);
+        __atomic_store_n(&rd->meshReady, 1, __ATOMIC_SEQ_CST);
+        ChunkPipelineReached((ChunkHandle){ idx, r->epoch }, CHUNK_STAGE_UPLOADED);
 
-            // free r struct but NOT the arrays (now referenced by rd->mesh)
-            free(r->indices);
-            free(r);
+        // free r struct but NOT the arrays (now referenced by rd->mesh)
+        if (r->mapping) {
+            FreeReadyMesh(r);
         } else {
-            // empty mesh case: mark as ready but no geometry
-            rd->indexCount = 0;
-            rd->vertexCount = 0;
-            rd->meshReady = 1;
-            rd->meshing = 0;
+            free(r->indices);
             free(r);
         }
-        uploads++;
+    } else {
+        // empty mesh case: mark as ready but no geometry
+        rd->indexCount = 0;
+        rd->vertexCount = 0;
+        rd->lod = r->lod;
+        rd->bakedLight = r->bakedLight;
+        __atomic_store_n(&rd->meshReady, 1, __ATOMIC_SEQ_CST);
+        ChunkPipelineReached((ChunkHandle){ idx, r->epoch }, CHUNK_STAGE_UPLOADED);
+        free(r);
     }
 }
 
-// Simple AABB frustum culling using camera position + distance (cheap)
-static int chunk_in_view(ChunkRenderData *r, Camera3D camera, Vector3 playerPos) {
-    // cheap distance cull
+// Called on main thread once per frame to upload a limited number of ready meshes
+void PollMeshUploads(void) {
+    const int uploadsPerFrame = 2; // tuning knob
+    int uploads = JobsRunMain(uploadsPerFrame);
+    update_light_volumes();
+    if (g_startupTime == 0.0 && uploads > 0) {
+        int ready = 0;
+        while (ready < g_totalChunks && g_chunks[ready].render.meshReady) ready++;
+        if (ready == g_totalChunks) g_startupTime = GetTime() - g_startTime;
+    }
+}
+
+double GetMeshStartupTime(void) {
+    return g_startupTime;
+}
+
+MeshJobStats GetMeshJobStats(void) {
+    MeshJobStats stats;
+    stats.meshed = __atomic_load_n(&g_jobStats.meshed, __ATOMIC_RELAXED);
+    stats.cached = __atomic_load_n(&g_jobStats.cached, __ATOMIC_RELAXED);
+    stats.skipped = __atomic_load_n(&g_jobStats.skipped, __ATOMIC_RELAXED);
+    stats.stale = __atomic_load_n(&g_jobStats.stale, __ATOMIC_RELAXED);
+    stats.cancelled = __atomic_load_n(&g_jobStats.cancelled, __ATOMIC_RELAXED);
+    pthread_mutex_lock(&g_statsMutex);
+    stats.seconds = g_jobStats.seconds;
+    pthread_mutex_unlock(&g_statsMutex);
+    return stats;
+}
+
+// Distance cull only (cheap): the horizon relies on it, see ChunkDrawn
+int ChunkDrawn(const Chunk *chunk, Vector3 playerPos) {
+    const ChunkRenderData *r = &chunk->render;
+    if (!r->meshReady) return 0;
     float cx = (r->aabbMin[0] + r->aabbMax[0]) * 0.5f;
     float cz = (r->aabbMin[2] + r->aabbMax[2]) * 0.5f;
     float dx = cx - playerPos.x;
     float dz = cz - playerPos.z;
     float dist2 = dx*dx + dz*dz;
-    float maxDist = (RENDER_DISTANCE + 1) * CHUNK_SIZE;
+    float maxDist = (VIEW_DISTANCE + 1) * CHUNK_SIZE;
     return dist2 <= (maxDist * maxDist);
 }
 
@@ -551,11 +736,15 @@ void DrawChunks(Chunk* chunks, Camera3D camera, Vector3 playerPos) {
     int total = g_totalChunks;
     for (int i = 0; i < total; i++) {
         ChunkRenderData *r = &chunks[i].render;
-        if (!r->meshReady) continue;
         if (r->indexCount == 0) continue;
-        if (!chunk_in_view(r, camera, playerPos)) continue;
+        if (!ChunkDrawn(&chunks[i], playerPos)) continue;
         // Draw stored mesh using shared material
         if (r->hasMesh) {
+            int useLightVolume = !r->bakedLight && r->lightTexture.id > 0;
+            Vector3 origin = { r->aabbMin[0], 0.0f, r->aabbMin[2] };
+            SetShaderValue(g_material.shader, g_locUseLightVolume, &useLightVolume, SHADER_UNIFORM_INT);
+            SetShaderValue(g_material.shader, g_locChunkOrigin, &origin, SHADER_UNIFORM_VEC3);
+            g_material.maps[MATERIAL_MAP_OCCLUSION].texture = r->lightTexture;
             Matrix transform = MatrixIdentity();
             DrawMesh(r->mesh, g_material, transform);
         }
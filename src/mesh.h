@@ -4,10 +4,81 @@
 #include "data.h"
 #include "raylib.h"
 
+// Distant chunks are meshed from a 2x, 4x or 8x downsampled copy of their voxels.
+// A chunk switches to level N once it is farther than LOD_DISTANCE_N +
+// LOD_HYSTERESIS chunks, and back only once it is closer than
+// LOD_DISTANCE_N - LOD_HYSTERESIS. Chunks are drawn out to VIEW_DISTANCE + 1
+// chunks: full detail up to RENDER_DISTANCE + 1, then three rings of equal
+// width, one per level.
+#define LOD_LEVELS 4
+#define LOD_DISTANCE_1 (RENDER_DISTANCE + 1.0f)
+#define LOD_DISTANCE_2 (LOD_DISTANCE_1 + (VIEW_DISTANCE - RENDER_DISTANCE) / 3.0f)
+#define LOD_DISTANCE_3 (LOD_DISTANCE_1 + 2.0f * (VIEW_DISTANCE - RENDER_DISTANCE) / 3.0f)
+#define LOD_HYSTERESIS 0.5f
+
+// Where chunk light reaches the shader. CHUNK_LIGHT_VERTEX bakes it into the
+// vertex colors, so a light change remeshes every chunk it reaches.
+// CHUNK_LIGHT_VOLUME keeps it in a small per-chunk texture sampled by the
+// shader, so a light change only re-uploads that texture.
+typedef enum {
+    CHUNK_LIGHT_VERTEX,
+    CHUNK_LIGHT_VOLUME,
+} ChunkLightMode;
+
+// Outcome of the mesh jobs so far: built by the mesher, read from the disk
+// cache, dropped because the inputs of the mesh on screen did not change,
+// thrown away because the chunk was edited before the mesh was uploaded, or
+// cancelled because the chunk left range (relights included)
+typedef struct MeshJobStats {
+    long meshed;
+    long cached;
+    long skipped;
+    long stale;
+    long cancelled;
+    double seconds; // worker time spent on the meshes built by the mesher
+} MeshJobStats;
+
+// Memory held by the meshes of the chunks on the main thread side: the CPU
+// copies raylib keeps with the uploaded meshes (none for meshes mapped from
+// the disk cache), and the GPU vertex buffers and light volume textures
+typedef struct MeshMemory {
+    int count; // chunks with a mesh
+    size_t cpu;
+    size_t gpu;
+} MeshMemory;
+
 void InitMeshSystem(Chunk* chunks, int totalChunks, Texture2D atlas);
 void ShutdownMeshSystem(void);
 void ScheduleChunkRemesh(int chunkIndex, int priority);
+// Main thread: the slot goes to chunk (chunkX, chunkZ), drop the mesh of the
+// previous one
+void ResetChunkRender(int chunkIndex, int chunkX, int chunkZ);
+// Light stage of the chunk pipeline (job): full lighting of one chunk.
+// Returns 0, without lighting, once the slot moved past epoch (Chunk.epoch).
+int LightChunk(int chunkIndex, unsigned epoch);
+// Block every light and mesh job (they read or write blocks and light of
+// several chunks), for the pipeline to put a new chunk in a slot
+void LockChunkData(void);
+// Main thread: share the blocks with the mesh jobs, to read them while no job
+// writes them. Returns 0, without the lock, when a light job or the pipeline
+// holds or waits for it. Released by UnlockChunkData.
+int TryLockChunkDataRead(void);
+void UnlockChunkData(void);
+void NotifyBlockChanged(int worldX, int worldY, int worldZ, BlockData oldBlock);
+void SetChunkLightMode(ChunkLightMode mode);
+ChunkLightMode GetChunkLightMode(void);
+void UpdateChunkLods(Vector3 playerPos);
 void PollMeshUploads(void);
+// Seconds from InitMeshSystem to the first frame with every chunk meshed and
+// uploaded (0 until then)
+double GetMeshStartupTime(void);
+MeshJobStats GetMeshJobStats(void);
+// Main thread
+MeshMemory GetMeshMemory(void);
 void DrawChunks(Chunk* chunks, Camera3D camera, Vector3 playerPos);
+// The chunk is drawn by DrawChunks for a player at playerPos (its mesh is
+// ready and it is within the draw distance): the horizon hides only the
+// cells of these chunks, so no gap shows between the two
+int ChunkDrawn(const Chunk *chunk, Vector3 playerPos);
 
 #endif // MESH_H
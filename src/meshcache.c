@@ -0,0 +1,295 @@
+#include "meshcache.h"
+#include "mesher.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+
+#define MESH_CACHE_MAGIC "MSH1"
+// bump when the vertex layout or the mesher output changes
+#define MESH_CACHE_VERSION 2
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+// Stored as is at the start of the file, in host byte order, followed by
+// positions, normals, texcoords, texcoords2 (floats), colors (bytes) and the
+// 16 bit indices
+typedef struct MeshCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    int32_t lod;
+    int32_t bakedLight;
+    int32_t vertexCount;
+    int32_t indexCount;
+} MeshCacheHeader;
+
+static char g_directory[512] = "";
+// bytes of the files in the directory: counted by MeshCacheOpen and each trim,
+// kept up to date by the stores in between
+static long long g_bytes = 0;
+static int g_trimming = 0;
+
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#define make_dir(path) _mkdir(path)
+#else
+#include <sys/mman.h>
+#define make_dir(path) mkdir(path, 0755)
+#endif
+
+static size_t payload_size(int vertexCount, int indexCount) {
+    return (size_t)vertexCount * (10 * sizeof(float) + 4) + (size_t)indexCount * sizeof(unsigned short);
+}
+
+static void cache_path(char *path, size_t size, int chunkX, int chunkZ, int lod, const char *suffix) {
+    snprintf(path, size, "%s/c.%d.%d.%d.mesh%s", g_directory, chunkX, chunkZ, lod, suffix);
+}
+
+#ifdef _WIN32
+// No mmap here (and windows.h clashes with raylib.h): read the file instead
+static void *map_file(int fd, size_t size) {
+    unsigned char *p = malloc(size);
+    size_t done = 0;
+    while (p && done < size) {
+        long n = read(fd, p + done, (unsigned int)(size - done));
+        if (n <= 0) {
+            free(p);
+            return NULL;
+        }
+        done += (size_t)n;
+    }
+    return p;
+}
+
+static void unmap_file(void *map, size_t size) {
+    (void)size;
+    free(map);
+}
+#else
+// Populated up front where possible, so the upload on the main thread does
+// not wait on page faults
+static void *map_file(int fd, size_t size) {
+#ifdef MAP_POPULATE
+    void *p = mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+#else
+    void *p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+#endif
+    return p == MAP_FAILED ? NULL : p;
+}
+
+static void unmap_file(void *map, size_t size) {
+    munmap(map, size);
+}
+#endif
+
+typedef struct CacheFile {
+    char name[64];
+    time_t mtime;
+    long long size;
+} CacheFile;
+
+static int by_mtime(const void *a, const void *b) {
+    const CacheFile *fa = a, *fb = b;
+    return (fa->mtime > fb->mtime) - (fa->mtime < fb->mtime);
+}
+
+// The cache files of the directory (temporary files left by a crash too),
+// oldest use first. Returns their count, *total their size.
+static int list_files(CacheFile **out, long long *total) {
+    *out = NULL;
+    *total = 0;
+    DIR *dir = opendir(g_directory);
+    if (!dir) return 0;
+    int count = 0, capacity = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strncmp(entry->d_name, "c.", 2) != 0 || strlen(entry->d_name) >= sizeof((*out)->name)) continue;
+        char path[600];
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", g_directory, entry->d_name);
+        if (stat(path, &st) != 0) continue;
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            CacheFile *grown = realloc(*out, (size_t)capacity * sizeof(CacheFile));
+            if (!grown) break;
+            *out = grown;
+        }
+        CacheFile *f = &(*out)[count++];
+        snprintf(f->name, sizeof(f->name), "%s", entry->d_name);
+        f->mtime = st.st_mtime;
+        f->size = (long long)st.st_size;
+        *total += f->size;
+    }
+    closedir(dir);
+    if (count > 0) qsort(*out, (size_t)count, sizeof(CacheFile), by_mtime);
+    return count;
+}
+
+// Delete the least recently used files (a hit touches its file) until the
+// directory is back under 3/4 of the budget, so trims stay rare. One at a
+// time; the stores going on meanwhile only shift the count a little.
+static void trim(void) {
+    if (__atomic_exchange_n(&g_trimming, 1, __ATOMIC_ACQUIRE)) return;
+    CacheFile *files;
+    long long total;
+    int count = list_files(&files, &total);
+    for (int i = 0; i < count && total > MESH_CACHE_BUDGET / 4 * 3; i++) {
+        char path[600];
+        snprintf(path, sizeof(path), "%s/%s", g_directory, files[i].name);
+        if (remove(path) == 0) total -= files[i].size;
+    }
+    free(files);
+    __atomic_store_n(&g_bytes, total, __ATOMIC_RELAXED);
+    __atomic_store_n(&g_trimming, 0, __ATOMIC_RELEASE);
+}
+
+int MeshCacheOpen(const char *directory) {
+    if (!directory) {
+        g_directory[0] = '\0';
+        return 1;
+    }
+    if (make_dir(directory) != 0 && errno != EEXIST) {
+        fprintf(stderr, "meshcache: cannot create %s: %s\n", directory, strerror(errno));
+        g_directory[0] = '\0';
+        return 0;
+    }
+    snprintf(g_directory, sizeof(g_directory), "%s", directory);
+    CacheFile *files;
+    long long total;
+    list_files(&files, &total);
+    free(files);
+    __atomic_store_n(&g_bytes, total, __ATOMIC_RELAXED);
+    if (total > MESH_CACHE_BUDGET) trim();
+    return 1;
+}
+
+int MeshCacheLoad(int chunkX, int chunkZ, int lod, uint64_t key, int chunkIndex, ReadyMesh **out) {
+    *out = NULL;
+    if (!g_directory[0]) return 0;
+    char path[600];
+    cache_path(path, sizeof(path), chunkX, chunkZ, lod, "");
+    int fd = open(path, O_RDONLY | O_BINARY);
+    if (fd < 0) return 0;
+    struct stat st;
+    MeshCacheHeader header;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(header) ||
+        read(fd, &header, sizeof(header)) != (long)sizeof(header) ||
+        memcmp(header.magic, MESH_CACHE_MAGIC, 4) != 0 || header.version != MESH_CACHE_VERSION ||
+        header.key != key || header.lod != lod ||
+        header.vertexCount < 0 || header.vertexCount > 65536 || header.indexCount < 0 ||
+        (size_t)st.st_size != sizeof(header) + payload_size(header.vertexCount, header.indexCount)) {
+        close(fd);
+        return 0;
+    }
+    // its mtime is the last use, for trim
+    utime(path, NULL);
+    if (header.vertexCount == 0) {
+        close(fd);
+        return 1;
+    }
+    size_t size = (size_t)st.st_size;
+    unsigned char *map = map_file(fd, size);
+    close(fd);
+    if (!map) return 0;
+
+    ReadyMesh *r = malloc(sizeof(ReadyMesh));
+    size_t vc = (size_t)header.vertexCount;
+    unsigned char *p = map + sizeof(header);
+    r->positions = (float *)p;         p += vc * 3 * sizeof(float);
+    r->normals = (float *)p;           p += vc * 3 * sizeof(float);
+    r->texcoords = (float *)p;         p += vc * 2 * sizeof(float);
+    r->texcoords2 = (float *)p;        p += vc * 2 * sizeof(float);
+    r->colors = p;                     p += vc * 4;
+    r->indices16 = (unsigned short *)p;
+    r->indices = NULL;
+    r->mapping = map;
+    r->mappingSize = size;
+    r->chunkIndex = chunkIndex;
+    r->vertexCount = header.vertexCount;
+    r->indexCount = header.indexCount;
+    r->lod = lod;
+    r->bakedLight = header.bakedLight;
+    // a torn or corrupted file must not send out of range indices to the GPU
+    for (int i = 0; i < r->indexCount; i++) {
+        if (r->indices16[i] >= r->vertexCount) {
+            MeshCacheRelease(r);
+            return 0;
+        }
+    }
+    *out = r;
+    return 1;
+}
+
+// Written to a temporary file renamed over the old entry, so a reader sees
+// either of the two whole
+void MeshCacheStore(int chunkX, int chunkZ, int lod, uint64_t key, const ReadyMesh *mesh) {
+    if (!g_directory[0]) return;
+    MeshCacheHeader header = {
+        .magic = MESH_CACHE_MAGIC, .version = MESH_CACHE_VERSION, .key = key, .lod = lod,
+        .bakedLight = mesh ? mesh->bakedLight : 1,
+        .vertexCount = mesh ? mesh->vertexCount : 0,
+        .indexCount = mesh ? mesh->indexCount : 0,
+    };
+    if (header.vertexCount > 65536) return; // does not fit 16 bit indices
+    size_t size = sizeof(header) + payload_size(header.vertexCount, header.indexCount);
+    unsigned char *data = malloc(size);
+    if (!data) return;
+    unsigned char *p = data;
+    size_t vc = (size_t)header.vertexCount;
+    memcpy(p, &header, sizeof(header));                      p += sizeof(header);
+    if (mesh) {
+        memcpy(p, mesh->positions, vc * 3 * sizeof(float));   p += vc * 3 * sizeof(float);
+        memcpy(p, mesh->normals, vc * 3 * sizeof(float));     p += vc * 3 * sizeof(float);
+        memcpy(p, mesh->texcoords, vc * 2 * sizeof(float));   p += vc * 2 * sizeof(float);
+        memcpy(p, mesh->texcoords2, vc * 2 * sizeof(float));  p += vc * 2 * sizeof(float);
+        memcpy(p, mesh->colors, vc * 4);                      p += vc * 4;
+        for (int i = 0; i < mesh->indexCount; i++) {
+            unsigned short index = mesh->indices ? (unsigned short)mesh->indices[i] : mesh->indices16[i];
+            memcpy(p, &index, sizeof(index));
+            p += sizeof(index);
+        }
+    }
+
+    // one temporary file per store: two mesh jobs may write the same entry
+    static unsigned long storeCounter = 0;
+    char path[600], tmpPath[600], suffix[32];
+    snprintf(suffix, sizeof(suffix), ".tmp%lu", __atomic_fetch_add(&storeCounter, 1, __ATOMIC_RELAXED));
+    cache_path(path, sizeof(path), chunkX, chunkZ, lod, "");
+    cache_path(tmpPath, sizeof(tmpPath), chunkX, chunkZ, lod, suffix);
+    int fd = open(tmpPath, O_WRONLY | O_BINARY | O_CREAT | O_TRUNC, 0644);
+    int ok = fd >= 0;
+    for (size_t done = 0; ok && done < size; ) {
+        long n = write(fd, data + done, (unsigned int)(size - done));
+        if (n < 0 && errno == EINTR) continue;
+        ok = n > 0;
+        if (ok) done += (size_t)n;
+    }
+    if (fd >= 0) close(fd);
+    free(data);
+#ifdef _WIN32
+    if (ok) remove(path); // rename does not replace an existing file here
+#endif
+    struct stat old;
+    long long replaced = stat(path, &old) == 0 ? (long long)old.st_size : 0;
+    if (!ok || rename(tmpPath, path) != 0) {
+        remove(tmpPath);
+        return;
+    }
+    long long bytes = __atomic_add_fetch(&g_bytes, (long long)size - replaced, __ATOMIC_RELAXED);
+    if (bytes > MESH_CACHE_BUDGET) trim();
+}
+
+void MeshCacheRelease(ReadyMesh *mesh) {
+    unmap_file(mesh->mapping, mesh->mappingSize);
+    free(mesh);
+}
@@ -0,0 +1,31 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include "mesher.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Finished chunk meshes kept on disk so that a restart uploads them instead of
+// meshing again. One file per chunk and LOD level, holding the vertex arrays
+// in upload layout (16 bit indices) behind a header with the MeshInputHash
+// they were built from. A mesh whose inputs changed since is a miss and gets
+// overwritten by the new one. The files are a cache: nothing is synced, and
+// any file that looks wrong is ignored. Past MESH_CACHE_BUDGET bytes, the
+// files used least recently are deleted.
+#define MESH_CACHE_BUDGET (64LL << 20)
+
+// Use `directory` (created if missing) for the cache files. The cache stays
+// disabled until this is called, and again after a call with NULL.
+int MeshCacheOpen(const char *directory);
+// Look up the mesh of chunk (chunkX, chunkZ) at level lod built from inputs
+// hashing to key. Returns 1 on a hit, with *out the mesh mapped from the file
+// (NULL for a chunk without faces), 0 on a miss.
+int MeshCacheLoad(int chunkX, int chunkZ, int lod, uint64_t key, int chunkIndex, ReadyMesh **out);
+// Write mesh (NULL when the chunk has no faces) as the entry for key. Its
+// indices are read from indices, or indices16 when that is NULL.
+void MeshCacheStore(int chunkX, int chunkZ, int lod, uint64_t key, const ReadyMesh *mesh);
+// Release the file mapping behind a mesh returned by MeshCacheLoad
+void MeshCacheRelease(ReadyMesh *mesh);
+
+#endif // MESHCACHE_H
@@ -0,0 +1,488 @@
+#include "mesher.h"
+#include "meshcache.h"
+#include "atlas.h"
+#include "light.h"
+#include "data.h"
+#include "raylib.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Growable vertex/index arrays filled by the meshers
+typedef struct MeshBuilder {
+    float *positions;
+    float *normals;
+    float *texcoords;  // position inside the quad, in blocks (repeats the tile)
+    float *texcoords2; // atlas origin of the tile
+    unsigned char *colors; // r,g,b,a: ambient occlusion and light shade
+    unsigned int *indices;
+    int vcount, icount;
+    int vcap, icap;
+} MeshBuilder;
+
+// Unit cube corners of each face, in counter-clockwise order seen from outside.
+// Face order matches GetBlockFaceTexture: +X, -X, +Y, -Y, +Z, -Z
+static const float faceCorners[6][4][3] = {
+    {{1,0,0}, {1,1,0}, {1,1,1}, {1,0,1}},
+    {{0,0,1}, {0,1,1}, {0,1,0}, {0,0,0}},
+    {{1,1,0}, {0,1,0}, {0,1,1}, {1,1,1}},
+    {{0,0,0}, {1,0,0}, {1,0,1}, {0,0,1}},
+    {{1,0,1}, {1,1,1}, {0,1,1}, {0,0,1}},
+    {{0,0,0}, {0,1,0}, {1,1,0}, {1,0,0}},
+};
+static const float faceNormals[6][3] = {
+    { 1, 0, 0}, {-1, 0, 0}, { 0, 1, 0}, { 0,-1, 0}, { 0, 0, 1}, { 0, 0,-1},
+};
+// Axis along which the texture v (resp. u) coordinate runs on each face:
+// corner 0 -> 1 walks along v, corner 1 -> 2 along u
+static const int faceAxisV[6] = { 1, 1, 0, 0, 1, 1 };
+static const int faceAxisU[6] = { 2, 2, 2, 2, 0, 0 };
+
+static void builder_init(MeshBuilder *b) {
+    b->vcap = 4096;
+    b->icap = 6144;
+    b->vcount = 0;
+    b->icount = 0;
+    b->positions = malloc(sizeof(float) * 3 * b->vcap);
+    b->normals = malloc(sizeof(float) * 3 * b->vcap);
+    b->texcoords = malloc(sizeof(float) * 2 * b->vcap);
+    b->texcoords2 = malloc(sizeof(float) * 2 * b->vcap);
+    b->colors = malloc(4 * b->vcap);
+    b->indices = malloc(sizeof(unsigned int) * b->icap);
+}
+
+// Vertex shade for each ambient occlusion level (0 = corner fully enclosed)
+static const unsigned char aoShade[4] = { 102, 153, 204, 255 };
+// Brightness of each light level, 0.8 per level below the maximum
+static const unsigned char lightShade[LIGHT_MAX + 1] = {
+    9, 11, 14, 18, 22, 27, 34, 43, 53, 67, 84, 104, 131, 163, 204, 255,
+};
+
+// Emit one face of the box [x,x+sx] x [y,y+sy] x [z,z+sz] (world coordinates).
+// The atlas tile is repeated once per block across the face, the fragment
+// shader wraps the quad coordinates back into the tile with fract().
+// ao holds the occlusion level of each corner (NULL = unoccluded) and light
+// the light level in front of the face. The quad is split along the brighter
+// diagonal so a dark corner does not bleed across the whole face.
+static void builder_box_face(MeshBuilder *b, int face, float x, float y, float z,
+                             float sx, float sy, float sz, FaceUV uv, const int *ao, int light) {
+    if (b->vcount + 4 > b->vcap) {
+        b->vcap *= 2;
+        b->positions = realloc(b->positions, sizeof(float)*3*b->vcap);
+        b->normals = realloc(b->normals, sizeof(float)*3*b->vcap);
+        b->texcoords = realloc(b->texcoords, sizeof(float)*2*b->vcap);
+        b->texcoords2 = realloc(b->texcoords2, sizeof(float)*2*b->vcap);
+        b->colors = realloc(b->colors, 4*b->vcap);
+    }
+    if (b->icount + 6 > b->icap) {
+        b->icap *= 2;
+        b->indices = realloc(b->indices, sizeof(unsigned int)*b->icap);
+    }
+    const float size[3] = { sx, sy, sz };
+    const float w = size[faceAxisU[face]];
+    const float h = size[faceAxisV[face]];
+    // same corner -> uv assignment as the original single block faces
+    const float us[4] = { w, w, 0, 0 };
+    const float vs[4] = { h, 0, 0, h };
+    for (int c = 0; c < 4; c++) {
+        int v = b->vcount + c;
+        b->positions[v*3 + 0] = x + faceCorners[face][c][0] * sx;
+        b->positions[v*3 + 1] = y + faceCorners[face][c][1] * sy;
+        b->positions[v*3 + 2] = z + faceCorners[face][c][2] * sz;
+        b->normals[v*3 + 0] = faceNormals[face][0];
+        b->normals[v*3 + 1] = faceNormals[face][1];
+        b->normals[v*3 + 2] = faceNormals[face][2];
+        b->texcoords[v*2 + 0] = us[c];
+        b->texcoords[v*2 + 1] = vs[c];
+        b->texcoords2[v*2 + 0] = uv.u;
+        b->texcoords2[v*2 + 1] = uv.v;
+        unsigned char shade = (unsigned char)(aoShade[ao ? ao[c] : 3] * lightShade[light] / 255);
+        b->colors[v*4 + 0] = shade;
+        b->colors[v*4 + 1] = shade;
+        b->colors[v*4 + 2] = shade;
+        b->colors[v*4 + 3] = 255;
+    }
+    int flip = ao && ao[0] + ao[2] < ao[1] + ao[3];
+    int d = flip ? 1 : 0;
+    b->indices[b->icount++] = b->vcount + d; b->indices[b->icount++] = b->vcount + d + 1; b->indices[b->icount++] = b->vcount + d + 2;
+    b->indices[b->icount++] = b->vcount + d; b->indices[b->icount++] = b->vcount + (d + 2); b->indices[b->icount++] = b->vcount + (d + 3) % 4;
+    b->vcount += 4;
+}
+
+// Hand the builder arrays over to a ReadyMesh (NULL when nothing was emitted)
+static ReadyMesh *builder_finish(MeshBuilder *b, int chunkIndex, int lod) {
+    if (b->vcount == 0) {
+        free(b->positions); free(b->normals); free(b->texcoords); free(b->texcoords2); free(b->colors); free(b->indices);
+        return NULL;
+    }
+    // shrink to fit
+    ReadyMesh *r = malloc(sizeof(ReadyMesh));
+    r->chunkIndex = chunkIndex;
+    r->positions = realloc(b->positions, sizeof(float)*3*b->vcount);
+    r->normals = realloc(b->normals, sizeof(float)*3*b->vcount);
+    r->texcoords = realloc(b->texcoords, sizeof(float)*2*b->vcount);
+    r->texcoords2 = realloc(b->texcoords2, sizeof(float)*2*b->vcount);
+    r->colors = realloc(b->colors, 4*b->vcount);
+    r->indices = realloc(b->indices, sizeof(unsigned int)*b->icount);
+    r->indices16 = NULL;
+    r->mapping = NULL;
+    r->mappingSize = 0;
+    r->vertexCount = b->vcount;
+    r->indexCount = b->icount;
+    r->lod = lod;
+    r->bakedLight = 1;
+    return r;
+}
+
+// The slot of the chunk being meshed went to another chunk: the mesh would be
+// thrown away, stop (checked once per slice)
+static inline int left_range(Chunk *chunk, unsigned epoch) {
+    return __atomic_load_n(&chunk->epoch, __ATOMIC_RELAXED) != epoch;
+}
+
+static ReadyMesh *builder_abort(MeshBuilder *b) {
+    b->vcount = 0;
+    return builder_finish(b, 0, 0);
+}
+
+// A solid cell with an empty cell next to it inside the chunk (or above it):
+// part of a surface the neighbour across the border may not close
+static int cell_exposed(unsigned short cells[CHUNK_SIZE/2][WORLD_HEIGHT/2][CHUNK_SIZE/2],
+                        int cx, int cy, int cz, int nx, int ny, int nz) {
+    for (int face = 0; face < 6; face++) {
+        int ncx = cx + (int)faceNormals[face][0];
+        int ncy = cy + (int)faceNormals[face][1];
+        int ncz = cz + (int)faceNormals[face][2];
+        if (ncx < 0 || ncx >= nx || ncz < 0 || ncz >= nz || ncy < 0) continue;
+        if (ncy >= ny || cells[ncx][ncy][ncz] == BLOCK_AIR) return 1;
+    }
+    return 0;
+}
+
+// Mesh a chunk at LOD level 1..3 (cells of 2, 4 or 8 blocks per side).
+// A cell is solid as soon as one of its blocks is visible and takes the type
+// of its highest visible block, so a coarse surface never sits below the real
+// one. A face is lit by the brightest block of the cell in front of it (the
+// light is baked), so the levels shade like the full detail meshes. The mesh only reads the chunk itself, so cracks against neighbours of
+// another level are closed from this side: every exposed solid cell of a
+// border column gets its outward face (overhangs, cave mouths), and the top
+// cell's face is extended one cell further down as a skirt, whatever the
+// neighbour contains.
+static ReadyMesh *mesh_chunk_lod(Chunk *chunks, int chunkIndex, int lod) {
+    Chunk *chunk = &chunks[chunkIndex];
+    const unsigned epoch = __atomic_load_n(&chunk->epoch, __ATOMIC_RELAXED);
+    const int s = 1 << lod;
+    const int nx = CHUNK_SIZE / s;
+    const int ny = WORLD_HEIGHT / s;
+    const int nz = CHUNK_SIZE / s;
+    // largest grid is lod 1: 8 x 64 x 8 cells
+    static _Thread_local unsigned short cells[CHUNK_SIZE/2][WORLD_HEIGHT/2][CHUNK_SIZE/2];
+    static _Thread_local short topCell[CHUNK_SIZE/2][CHUNK_SIZE/2];
+    static _Thread_local unsigned char cellLight[CHUNK_SIZE/2][WORLD_HEIGHT/2][CHUNK_SIZE/2];
+
+    for (int cx = 0; cx < nx; cx++) {
+        for (int cz = 0; cz < nz; cz++) {
+            topCell[cx][cz] = -1;
+            for (int cy = 0; cy < ny; cy++) {
+                unsigned short type = BLOCK_AIR;
+                unsigned char light = 0;
+                for (int y = cy*s + s - 1; y >= cy*s; y--) {
+                    for (int x = cx*s; x < cx*s + s; x++) {
+                        for (int z = cz*s; z < cz*s + s; z++) {
+                            BlockData b = chunk->data->blocks[x][y][z];
+                            unsigned char sky = chunk->data->skyLight[x][y][z];
+                            if (type == BLOCK_AIR && b.visible && b.Type != BLOCK_AIR) type = b.Type;
+                            if (sky > light) light = sky;
+                            if (b.lightLevel > light) light = b.lightLevel;
+                        }
+                    }
+                }
+                cells[cx][cy][cz] = type;
+                cellLight[cx][cy][cz] = light;
+                if (type != BLOCK_AIR) topCell[cx][cz] = (short)cy;
+            }
+        }
+    }
+
+    MeshBuilder b;
+    builder_init(&b);
+    const float ox = (float)(chunk->x << 4);
+    const float oz = (float)(chunk->z << 4);
+    for (int cx = 0; cx < nx; cx++) {
+        if (left_range(chunk, epoch)) return builder_abort(&b);
+        for (int cy = 0; cy < ny; cy++) {
+            for (int cz = 0; cz < nz; cz++) {
+                int type = cells[cx][cy][cz];
+                if (type == BLOCK_AIR) continue;
+                float px = ox + cx*s, py = (float)(cy*s), pz = oz + cz*s;
+                for (int face = 0; face < 6; face++) {
+                    int ncx = cx + (int)faceNormals[face][0];
+                    int ncy = cy + (int)faceNormals[face][1];
+                    int ncz = cz + (int)faceNormals[face][2];
+                    int outside = ncx < 0 || ncx >= nx || ncz < 0 || ncz >= nz;
+                    FaceUV tex = blockFaceUV[type][face];
+                    if (outside) {
+                        // the neighbour is not read: the light of the cell
+                        // itself, or of the one above it
+                        int light = cellLight[cx][cy][cz];
+                        int above = cy + 1 < ny ? cellLight[cx][cy + 1][cz] : LIGHT_MAX;
+                        if (above > light) light = above;
+                        // the column top, hanging one cell below it (skirt)
+                        if (cy == topCell[cx][cz]) {
+                            float skirtY = py - s > 0 ? py - s : 0;
+                            builder_box_face(&b, face, px, skirtY, pz, s, py + s - skirtY, s, tex, NULL, light);
+                        } else if (cell_exposed(cells, cx, cy, cz, nx, ny, nz)) {
+                            builder_box_face(&b, face, px, py, pz, s, s, s, tex, NULL, light);
+                        }
+                        continue;
+                    }
+                    if (ncy >= 0 && ncy < ny && cells[ncx][ncy][ncz] != BLOCK_AIR) continue;
+                    if (ncy < 0) continue; // bottom of the world is never seen
+                    builder_box_face(&b, face, px, py, pz, s, s, s, tex, NULL,
+                                     ncy < ny ? cellLight[ncx][ncy][ncz] : LIGHT_MAX);
+                }
+            }
+        }
+    }
+    return builder_finish(&b, chunkIndex, lod);
+}
+
+static int g_ambientOcclusion = 1;
+static int g_bakeLight = 1;
+
+void SetMeshAmbientOcclusion(int enabled) {
+    g_ambientOcclusion = enabled;
+}
+
+void SetMeshLightBaking(int enabled) {
+    g_bakeLight = enabled;
+}
+
+static inline int occludes(BlockData b) {
+    return b.visible && b.Type != BLOCK_AIR;
+}
+
+// Occupancy (1 = hides the faces behind it) and light (max of sky and block
+// light) of the chunk blocks plus a one block border taken from the 8
+// surrounding chunks, empty and fully lit where a neighbour is not loaded and
+// above the world. The mesher reads neighbours from here instead of calling
+// getBlockAt.
+typedef struct PaddedChunk {
+    unsigned char solid[CHUNK_SIZE+2][WORLD_HEIGHT+2][CHUNK_SIZE+2];
+    unsigned char light[CHUNK_SIZE+2][WORLD_HEIGHT+2][CHUNK_SIZE+2];
+} PaddedChunk;
+
+static void pad_chunk(Chunk *chunks, Chunk *chunk, PaddedChunk *pad) {
+    memset(pad->solid, 0, sizeof(pad->solid));
+    memset(pad->light, LIGHT_MAX, sizeof(pad->light));
+    for (int dx = -1; dx <= 1; dx++) {
+        for (int dz = -1; dz <= 1; dz++) {
+            Chunk *src = (dx == 0 && dz == 0) ? chunk : findChunk(chunks, chunk->x + dx, chunk->z + dz);
+            if (!src) continue;
+            // local range copied from `src` and where it lands in the padded grid
+            int x0 = dx < 0 ? CHUNK_SIZE - 1 : 0, x1 = dx > 0 ? 1 : CHUNK_SIZE;
+            int z0 = dz < 0 ? CHUNK_SIZE - 1 : 0, z1 = dz > 0 ? 1 : CHUNK_SIZE;
+            int px = dx < 0 ? 0 : (dx > 0 ? CHUNK_SIZE + 1 : 1);
+            int pz = dz < 0 ? 0 : (dz > 0 ? CHUNK_SIZE + 1 : 1);
+            for (int x = x0; x < x1; x++) {
+                for (int y = 0; y < WORLD_HEIGHT; y++) {
+                    unsigned char *dst = &pad->solid[px + x - x0][y + 1][pz];
+                    unsigned char *lit = &pad->light[px + x - x0][y + 1][pz];
+                    for (int z = z0; z < z1; z++) {
+                        BlockData b = src->data->blocks[x][y][z];
+                        unsigned char sky = src->data->skyLight[x][y][z];
+                        dst[z - z0] = (unsigned char)occludes(b);
+                        lit[z - z0] = sky > b.lightLevel ? sky : b.lightLevel;
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Occupancy at chunk-local (x,y,z), which may be one step outside the chunk
+static inline int padded_solid(const PaddedChunk *pad, int x, int y, int z) {
+    return pad->solid[x + 1][y + 1][z + 1];
+}
+
+// Occlusion level of the 4 corners of a face: the three blocks touching each
+// corner in the layer in front of the face decide it (both sides solid = 0,
+// otherwise 3 minus the number of solid ones). Returns them packed 2 bits each.
+static int face_ao(const PaddedChunk *pad, const int pos[3], int face, int ao[4]) {
+    const int axis = face >> 1;
+    const int ua = (axis + 1) % 3;
+    const int va = (axis + 2) % 3;
+    int front[3] = { pos[0] + (int)faceNormals[face][0], pos[1] + (int)faceNormals[face][1], pos[2] + (int)faceNormals[face][2] };
+    int packed = 0;
+    for (int c = 0; c < 4; c++) {
+        int su = faceCorners[face][c][ua] > 0.5f ? 1 : -1;
+        int sv = faceCorners[face][c][va] > 0.5f ? 1 : -1;
+        int p1[3] = { front[0], front[1], front[2] };
+        int p2[3] = { front[0], front[1], front[2] };
+        int p3[3] = { front[0], front[1], front[2] };
+        p1[ua] += su;
+        p2[va] += sv;
+        p3[ua] += su; p3[va] += sv;
+        int side1 = padded_solid(pad, p1[0], p1[1], p1[2]);
+        int side2 = padded_solid(pad, p2[0], p2[1], p2[2]);
+        int corner = padded_solid(pad, p3[0], p3[1], p3[2]);
+        ao[c] = (side1 && side2) ? 0 : 3 - (side1 + side2 + corner);
+        packed |= ao[c] << (c * 2);
+    }
+    return packed;
+}
+
+// Greedy mesher: for each of the 6 face directions, every slice of the chunk
+// is turned into a mask of exposed faces and rectangles of equal mask values
+// are merged into a single quad. The mask holds the atlas tile + 1, the packed
+// corner occlusion levels and the light in front of the face (when baked), so
+// only faces that look the same merge.
+// Textures repeat per block in the shader, so merging works on every face.
+// vertices layout per vertex: x,y,z, nx,ny,nz, u,v (tiling), u2,v2 (tile origin), rgba (shade)
+ReadyMesh *mesh_chunk_improved(Chunk *chunks, int chunkIndex, int lod) {
+    if (lod > 0) return mesh_chunk_lod(chunks, chunkIndex, lod);
+    Chunk *chunk = &chunks[chunkIndex];
+    const unsigned epoch = __atomic_load_n(&chunk->epoch, __ATOMIC_RELAXED);
+    const int bakeLight = g_bakeLight;
+    static const int dims[3] = { CHUNK_SIZE, WORLD_HEIGHT, CHUNK_SIZE };
+    static _Thread_local PaddedChunk pad;
+    int mask[WORLD_HEIGHT * CHUNK_SIZE];
+    pad_chunk(chunks, chunk, &pad);
+
+    MeshBuilder b;
+    builder_init(&b);
+    for (int face = 0; face < 6; face++) {
+        const int axis = face >> 1;
+        const int ua = (axis + 1) % 3;
+        const int va = (axis + 2) % 3;
+        const int nu = dims[ua];
+        const int nv = dims[va];
+        const int n[3] = { (int)faceNormals[face][0], (int)faceNormals[face][1], (int)faceNormals[face][2] };
+        for (int p = 0; p < dims[axis]; p++) {
+            if (left_range(chunk, epoch)) return builder_abort(&b);
+            // build mask for this slice
+            int any = 0;
+            int pos[3];
+            pos[axis] = p;
+            for (int v = 0; v < nv; v++) {
+                pos[va] = v;
+                for (int u = 0; u < nu; u++) {
+                    pos[ua] = u;
+                    int m = 0;
+                    if (padded_solid(&pad, pos[0], pos[1], pos[2]) && pos[1] + n[1] >= 0 &&
+                        !padded_solid(&pad, pos[0] + n[0], pos[1] + n[1], pos[2] + n[2])) {
+                        BlockData blk = chunk->data->blocks[pos[0]][pos[1]][pos[2]];
+                        int ao[4];
+                        int sig = g_ambientOcclusion ? face_ao(&pad, pos, face, ao) : 0xFF;
+                        int light = bakeLight ? pad.light[pos[0] + n[0] + 1][pos[1] + n[1] + 1][pos[2] + n[2] + 1] : LIGHT_MAX;
+                        m = (blockFaceUV[blk.Type][face].tile + 1) | (sig << 16) | (light << 24);
+                        any = 1;
+                    }
+                    mask[u + v*nu] = m;
+                }
+            }
+            if (!any) continue;
+            // Greedy merge rectangles in mask
+            for (int v0 = 0; v0 < nv; v0++) {
+                for (int u0 = 0; u0 < nu; ) {
+                    int key = mask[u0 + v0*nu];
+                    if (!key) { u0++; continue; }
+                    int w = 1;
+                    while (u0 + w < nu && mask[u0 + w + v0*nu] == key) w++;
+                    int h = 1;
+                    int ok = 1;
+                    while (v0 + h < nv && ok) {
+                        for (int ui = 0; ui < w; ui++) {
+                            if (mask[u0 + ui + (v0 + h)*nu] != key) { ok = 0; break; }
+                        }
+                        if (ok) h++;
+                    }
+                    float origin[3], size[3];
+                    origin[axis] = (float)p;  size[axis] = 1.0f;
+                    origin[ua] = (float)u0;   size[ua] = (float)w;
+                    origin[va] = (float)v0;   size[va] = (float)h;
+                    int first[3];
+                    first[axis] = p; first[ua] = u0; first[va] = v0;
+                    FaceUV uv = blockFaceUV[chunk->data->blocks[first[0]][first[1]][first[2]].Type][face];
+                    int ao[4];
+                    for (int c = 0; c < 4; c++) ao[c] = (key >> (16 + c * 2)) & 3;
+                    builder_box_face(&b, face, origin[0] + (chunk->x<<4), origin[1], origin[2] + (chunk->z<<4),
+                                     size[0], size[1], size[2], uv, ao, (key >> 24) & 15);
+                    // clear mask
+                    for (int vv = 0; vv < h; vv++) for (int uu = 0; uu < w; uu++) mask[u0 + uu + (v0 + vv)*nu] = 0;
+                    u0 += w;
+                }
+            }
+        }
+    }
+    ReadyMesh *r = builder_finish(&b, chunkIndex, 0);
+    if (r) r->bakedLight = bakeLight;
+    return r;
+}
+
+// 64 bit multiply / xor-shift mix over whole words, enough to tell meshes
+// apart (not meant to resist collisions on purpose)
+static uint64_t hash_bytes(uint64_t h, const void *data, size_t size) {
+    const unsigned char *p = data;
+    for (; size >= 8; size -= 8, p += 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        h = (h ^ word) * 0x9E3779B97F4A7C15ull;
+        h ^= h >> 29;
+    }
+    for (; size > 0; size--, p++) h = (h ^ *p) * 0x100000001B3ull;
+    return h;
+}
+
+// The atlas tiles end up in the texture coordinates. The table is filled once
+// at startup, so it is hashed on first use only.
+static uint64_t face_table_hash(void) {
+    static uint64_t hash = 0;
+    uint64_t h = __atomic_load_n(&hash, __ATOMIC_RELAXED);
+    if (!h) {
+        // mesh jobs may race here, they all store the same value
+        h = hash_bytes(0xcbf29ce484222325ull, blockFaceUV, sizeof(blockFaceUV)) | 1;
+        __atomic_store_n(&hash, h, __ATOMIC_RELAXED);
+    }
+    return h;
+}
+
+uint64_t MeshInputHash(Chunk *chunks, int chunkIndex, int lod) {
+    static _Thread_local PaddedChunk pad;
+    static _Thread_local uint16_t bits[CHUNK_SIZE * WORLD_HEIGHT * CHUNK_SIZE];
+    Chunk *chunk = &chunks[chunkIndex];
+    const int bakeLight = g_bakeLight;
+    // block light is only read through pad.light
+    const BlockData *blocks = &chunk->data->blocks[0][0][0];
+    for (int i = 0; i < CHUNK_SIZE * WORLD_HEIGHT * CHUNK_SIZE; i++) {
+        BlockData b = blocks[i];
+        b.lightLevel = 0;
+        memcpy(&bits[i], &b, sizeof(bits[i]));
+    }
+    const int settings[5] = { lod, g_ambientOcclusion, lod > 0 || bakeLight, chunk->x, chunk->z };
+    uint64_t h = hash_bytes(face_table_hash(), settings, sizeof(settings));
+    h = hash_bytes(h, bits, sizeof(bits));
+    // LOD meshes only look at the chunk itself, light included
+    if (lod > 0) {
+        h = hash_bytes(h, chunk->data->blocks, sizeof(chunk->data->blocks));
+        return hash_bytes(h, chunk->data->skyLight, sizeof(chunk->data->skyLight));
+    }
+    pad_chunk(chunks, chunk, &pad);
+    h = hash_bytes(h, pad.solid, sizeof(pad.solid));
+    if (bakeLight) h = hash_bytes(h, pad.light, sizeof(pad.light));
+    return h;
+}
+
+void FreeReadyMesh(ReadyMesh *r) {
+    if (r->mapping) {
+        MeshCacheRelease(r);
+        return;
+    }
+    if (r->positions) free(r->positions);
+    if (r->normals) free(r->normals);
+    if (r->texcoords) free(r->texcoords);
+    if (r->texcoords2) free(r->texcoords2);
+    if (r->colors) free(r->colors);
+    if (r->indices) free(r->indices);
+    free(r);
+}
@@ -0,0 +1,47 @@
+#ifndef MESHER_H
+#define MESHER_H
+
+#include "data.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CPU side of chunk meshing: turns voxels into vertex arrays. Runs on the
+// mesh worker, no GPU call is made here.
+typedef struct ReadyMesh {
+    int chunkIndex;
+    float *positions; // x,y,z * vertexCount
+    float *normals;   // nx,ny,nz * vertexCount
+    float *texcoords; // u,v * vertexCount (tiling, in blocks)
+    float *texcoords2; // u,v * vertexCount (atlas tile origin)
+    unsigned char *colors; // r,g,b,a * vertexCount (ambient occlusion shade)
+    unsigned int *indices;
+    unsigned short *indices16; // mesh from the disk cache: indices already in upload format, indices is NULL
+    void *mapping;             // mesh from the disk cache: file mapping the arrays point into
+    size_t mappingSize;
+    int vertexCount;
+    int indexCount;
+    int lod;
+    int bakedLight; // colors include the light shade (always for LOD meshes)
+    unsigned version; // Chunk.version the mesh was built from
+    unsigned ticket;  // ChunkRenderData.meshTicket of the job that built it
+    uint64_t key;     // remesh key of its inputs
+    uint64_t inputKey; // MeshInputHash of its inputs
+    int cached;        // in the mesh cache (read from it or written by the job)
+    unsigned epoch;   // Chunk.epoch of the slot when the job started
+} ReadyMesh;
+
+// Stops early, returning NULL, once the slot goes to another chunk
+// (Chunk.epoch changes): the caller drops the result then
+ReadyMesh *mesh_chunk_improved(Chunk *chunks, int chunkIndex, int lod);
+// Hash of everything mesh_chunk_improved reads for this chunk and level
+// (blocks, neighbour border, baked light, settings, atlas tiles): equal hashes
+// give the same mesh
+uint64_t MeshInputHash(Chunk *chunks, int chunkIndex, int lod);
+void FreeReadyMesh(ReadyMesh *r);
+void SetMeshAmbientOcclusion(int enabled);
+// Bake the light level into the vertex colors (default), or leave it out for
+// the shader to sample from the chunk light volume
+void SetMeshLightBaking(int enabled);
+
+#endif // MESHER_H
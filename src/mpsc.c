@@ -0,0 +1,46 @@
+#include "mpsc.h"
+
+#include <stddef.h>
+
+// Dmitry Vyukov's intrusive MPSC queue. Producers swap themselves in as head
+// and then link the previous head to them; the consumer follows the links from
+// tail. The stub node is pushed back whenever the consumer takes the last real
+// node, so tail always has a node behind it.
+
+void MpscInit(MpscQueue *q) {
+    q->stub.next = NULL;
+    q->head = &q->stub;
+    q->tail = &q->stub;
+}
+
+void MpscPush(MpscQueue *q, MpscNode *node) {
+    __atomic_store_n(&node->next, NULL, __ATOMIC_RELAXED);
+    MpscNode *prev = __atomic_exchange_n(&q->head, node, __ATOMIC_ACQ_REL);
+    // until this store, the consumer sees the queue end at prev
+    __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+}
+
+MpscNode *MpscPop(MpscQueue *q) {
+    MpscNode *tail = q->tail;
+    MpscNode *next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    if (tail == &q->stub) {
+        if (!next) return NULL; // empty
+        q->tail = next;
+        tail = next;
+        next = __atomic_load_n(&next->next, __ATOMIC_ACQUIRE);
+    }
+    if (next) {
+        q->tail = next;
+        return tail;
+    }
+    // tail is the last linked node: it can only go if it is also the head,
+    // otherwise a producer swapped the head but has not linked its node yet
+    if (tail != __atomic_load_n(&q->head, __ATOMIC_ACQUIRE)) return NULL;
+    MpscPush(q, &q->stub);
+    next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    if (next) {
+        q->tail = next;
+        return tail;
+    }
+    return NULL;
+}
@@ -0,0 +1,28 @@
+#ifndef MPSC_H
+#define MPSC_H
+
+// Lock-free FIFO with any number of producer threads and a single consumer,
+// intrusive: the items embed an MpscNode and the queue never allocates.
+// A push is one atomic exchange and one store, it never waits on the consumer
+// or on other producers. A pop never waits either, it can only come back
+// empty early while a producer is between its two steps (that item shows up
+// on a later pop). Items from one producer come out in the order it pushed
+// them.
+typedef struct MpscNode {
+    struct MpscNode *next;
+} MpscNode;
+
+typedef struct MpscQueue {
+    MpscNode *head;      // last node pushed, swapped by the producers
+    char pad[64 - sizeof(MpscNode *)]; // keeps head and tail on their own cache lines
+    MpscNode *tail;      // next node to pop, consumer only
+    MpscNode stub;       // holds the place of the first node while the queue is empty
+} MpscQueue;
+
+// The queue must not move once initialized (tail and head can point at stub)
+void MpscInit(MpscQueue *queue);
+void MpscPush(MpscQueue *queue, MpscNode *node);
+// Next node in FIFO order, NULL when there is none ready yet. Consumer thread only.
+MpscNode *MpscPop(MpscQueue *queue);
+
+#endif // MPSC_H
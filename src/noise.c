@@ -0,0 +1,440 @@
+#include "noise.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+// Lattice point hash: a multiply per axis, then a 32-bit mix (SSE4.1 and AVX2
+// multiply 32-bit lanes, SSE2 could not)
+#define HASH_X 0x27D4EB2Du
+#define HASH_Y 0x9E3779B1u
+#define HASH_Z 0x165667B1u
+#define HASH_M1 0x2C1B3C6Du
+#define HASH_M2 0x297A2D39u
+// Added to the seed at each octave, so octaves do not share their lattice
+#define OCTAVE_SEED 0x85EBCA6Bu
+
+// Raw Perlin noise peaks below these: the sums are brought back to [-1, 1]
+#define SCALE_2D 0.55f
+#define SCALE_3D 1.0f
+
+// Largest batch a backend evaluates at once
+#define MAX_LANES 8
+
+static inline uint32_t mix_scalar(uint32_t h) {
+    h ^= h >> 15;
+    h *= HASH_M1;
+    h ^= h >> 12;
+    h *= HASH_M2;
+    h ^= h >> 15;
+    return h;
+}
+
+static inline float fade_scalar(float t) {
+    return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+static inline float lerp_scalar(float a, float b, float t) {
+    return a + t * (b - a);
+}
+
+static inline float clamp_unit(float v) {
+    return v < -1.0f ? -1.0f : (v > 1.0f ? 1.0f : v);
+}
+
+// 8 gradients: (+-1, +-2) and (+-2, +-1)
+static inline float grad2_scalar(uint32_t h, float x, float z) {
+    float u = h & 4 ? z : x, v = h & 4 ? x : z;
+    return (h & 1 ? -u : u) + 2.0f * (h & 2 ? -v : v);
+}
+
+// 12 edge gradients of the cube (and 4 repeated), as in improved Perlin noise
+static inline float grad3_scalar(uint32_t h, float x, float y, float z) {
+    h &= 15;
+    float u = h < 8 ? x : y;
+    float v = h < 4 ? y : (h == 12 || h == 14 ? x : z);
+    return (h & 1 ? -u : u) + (h & 2 ? -v : v);
+}
+
+static float perlin2_scalar(uint32_t seed, float x, float z) {
+    float fx = floorf(x), fz = floorf(z);
+    uint32_t hx = (uint32_t)(int32_t)fx * HASH_X, hz = (uint32_t)(int32_t)fz * HASH_Z;
+    float tx = x - fx, tz = z - fz;
+    float n00 = grad2_scalar(mix_scalar(seed ^ hx ^ hz), tx, tz);
+    float n10 = grad2_scalar(mix_scalar(seed ^ (hx + HASH_X) ^ hz), tx - 1.0f, tz);
+    float n01 = grad2_scalar(mix_scalar(seed ^ hx ^ (hz + HASH_Z)), tx, tz - 1.0f);
+    float n11 = grad2_scalar(mix_scalar(seed ^ (hx + HASH_X) ^ (hz + HASH_Z)), tx - 1.0f, tz - 1.0f);
+    float u = fade_scalar(tx), w = fade_scalar(tz);
+    return lerp_scalar(lerp_scalar(n00, n10, u), lerp_scalar(n01, n11, u), w);
+}
+
+static float perlin3_scalar(uint32_t seed, float x, float y, float z) {
+    float fx = floorf(x), fy = floorf(y), fz = floorf(z);
+    uint32_t hx = (uint32_t)(int32_t)fx * HASH_X, hy = (uint32_t)(int32_t)fy * HASH_Y, hz = (uint32_t)(int32_t)fz * HASH_Z;
+    float tx = x - fx, ty = y - fy, tz = z - fz;
+    float n[8];
+    for (int c = 0; c < 8; c++) {
+        uint32_t h = seed ^ (hx + (c & 1 ? HASH_X : 0)) ^ (hy + (c & 2 ? HASH_Y : 0)) ^ (hz + (c & 4 ? HASH_Z : 0));
+        n[c] = grad3_scalar(mix_scalar(h), c & 1 ? tx - 1.0f : tx, c & 2 ? ty - 1.0f : ty, c & 4 ? tz - 1.0f : tz);
+    }
+    float u = fade_scalar(tx), v = fade_scalar(ty), w = fade_scalar(tz);
+    float a = lerp_scalar(lerp_scalar(n[0], n[1], u), lerp_scalar(n[2], n[3], u), v);
+    float b = lerp_scalar(lerp_scalar(n[4], n[5], u), lerp_scalar(n[6], n[7], u), v);
+    return lerp_scalar(a, b, w);
+}
+
+static void fbm2_scalar(NoiseParams params, const float *x, const float *z, float *out) {
+    float sum = 0.0f, amplitude = 1.0f, total = 0.0f, frequency = params.frequency;
+    uint32_t seed = params.seed;
+    for (int o = 0; o < params.octaves; o++) {
+        sum += amplitude * perlin2_scalar(seed, *x * frequency, *z * frequency);
+        total += amplitude;
+        amplitude *= 0.5f;
+        frequency *= 2.0f;
+        seed += OCTAVE_SEED;
+    }
+    *out = clamp_unit(sum * (SCALE_2D / total));
+}
+
+static void fbm3_scalar(NoiseParams params, const float *x, const float *y, const float *z, float *out) {
+    float sum = 0.0f, amplitude = 1.0f, total = 0.0f, frequency = params.frequency;
+    uint32_t seed = params.seed;
+    for (int o = 0; o < params.octaves; o++) {
+        sum += amplitude * perlin3_scalar(seed, *x * frequency, *y * frequency, *z * frequency);
+        total += amplitude;
+        amplitude *= 0.5f;
+        frequency *= 2.0f;
+        seed += OCTAVE_SEED;
+    }
+    *out = clamp_unit(sum * (SCALE_3D / total));
+}
+
+#ifdef __SSE4_1__
+// Same steps as the scalar code, 4 points per instruction. The gradient
+// choices become blends on bits of the hash moved to the sign bit, and the
+// sign flips xors of the sign bit.
+
+static inline __m128i mix_sse41(__m128i h) {
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+    h = _mm_mullo_epi32(h, _mm_set1_epi32((int)HASH_M1));
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 12));
+    h = _mm_mullo_epi32(h, _mm_set1_epi32((int)HASH_M2));
+    return _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+}
+
+static inline __m128 fade_sse41(__m128 t) {
+    __m128 p = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f))), _mm_set1_ps(10.0f));
+    return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), p);
+}
+
+static inline __m128 lerp_sse41(__m128 a, __m128 b, __m128 t) {
+    return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+}
+
+// Flip the sign of v where bit of h is set
+static inline __m128 flip_sse41(__m128 v, __m128i h, int bit) {
+    __m128i sign = _mm_slli_epi32(_mm_srli_epi32(h, bit), 31);
+    return _mm_xor_ps(v, _mm_castsi128_ps(sign));
+}
+
+static inline __m128 grad2_sse41(__m128i h, __m128 x, __m128 z) {
+    __m128 swap = _mm_castsi128_ps(_mm_slli_epi32(h, 29));
+    __m128 u = _mm_blendv_ps(x, z, swap), v = _mm_blendv_ps(z, x, swap);
+    return _mm_add_ps(flip_sse41(u, h, 0), _mm_mul_ps(_mm_set1_ps(2.0f), flip_sse41(v, h, 1)));
+}
+
+static inline __m128 grad3_sse41(__m128i h, __m128 x, __m128 y, __m128 z) {
+    __m128 high = _mm_castsi128_ps(_mm_slli_epi32(h, 28));
+    __m128 low = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(h, _mm_set1_epi32(12)), _mm_setzero_si128()));
+    __m128 edge = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(h, _mm_set1_epi32(13)), _mm_set1_epi32(12)));
+    __m128 u = _mm_blendv_ps(x, y, high);
+    __m128 v = _mm_blendv_ps(_mm_blendv_ps(z, x, edge), y, low);
+    return _mm_add_ps(flip_sse41(u, h, 0), flip_sse41(v, h, 1));
+}
+
+static __m128 perlin2_sse41(__m128i seed, __m128 x, __m128 z) {
+    __m128 fx = _mm_floor_ps(x), fz = _mm_floor_ps(z);
+    __m128i hx = _mm_mullo_epi32(_mm_cvttps_epi32(fx), _mm_set1_epi32((int)HASH_X));
+    __m128i hz = _mm_mullo_epi32(_mm_cvttps_epi32(fz), _mm_set1_epi32((int)HASH_Z));
+    __m128i hx1 = _mm_add_epi32(hx, _mm_set1_epi32((int)HASH_X)), hz1 = _mm_add_epi32(hz, _mm_set1_epi32((int)HASH_Z));
+    __m128 tx = _mm_sub_ps(x, fx), tz = _mm_sub_ps(z, fz);
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 tx1 = _mm_sub_ps(tx, one), tz1 = _mm_sub_ps(tz, one);
+    __m128 n00 = grad2_sse41(mix_sse41(_mm_xor_si128(seed, _mm_xor_si128(hx, hz))), tx, tz);
+    __m128 n10 = grad2_sse41(mix_sse41(_mm_xor_si128(seed, _mm_xor_si128(hx1, hz))), tx1, tz);
+    __m128 n01 = grad2_sse41(mix_sse41(_mm_xor_si128(seed, _mm_xor_si128(hx, hz1))), tx, tz1);
+    __m128 n11 = grad2_sse41(mix_sse41(_mm_xor_si128(seed, _mm_xor_si128(hx1, hz1))), tx1, tz1);
+    __m128 u = fade_sse41(tx), w = fade_sse41(tz);
+    return lerp_sse41(lerp_sse41(n00, n10, u), lerp_sse41(n01, n11, u), w);
+}
+
+static __m128 perlin3_sse41(__m128i seed, __m128 x, __m128 y, __m128 z) {
+    __m128 fx = _mm_floor_ps(x), fy = _mm_floor_ps(y), fz = _mm_floor_ps(z);
+    __m128i h[2][3];
+    h[0][0] = _mm_mullo_epi32(_mm_cvttps_epi32(fx), _mm_set1_epi32((int)HASH_X));
+    h[0][1] = _mm_mullo_epi32(_mm_cvttps_epi32(fy), _mm_set1_epi32((int)HASH_Y));
+    h[0][2] = _mm_mullo_epi32(_mm_cvttps_epi32(fz), _mm_set1_epi32((int)HASH_Z));
+    h[1][0] = _mm_add_epi32(h[0][0], _mm_set1_epi32((int)HASH_X));
+    h[1][1] = _mm_add_epi32(h[0][1], _mm_set1_epi32((int)HASH_Y));
+    h[1][2] = _mm_add_epi32(h[0][2], _mm_set1_epi32((int)HASH_Z));
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 t[2][3];
+    t[0][0] = _mm_sub_ps(x, fx);
+    t[0][1] = _mm_sub_ps(y, fy);
+    t[0][2] = _mm_sub_ps(z, fz);
+    for (int a = 0; a < 3; a++) t[1][a] = _mm_sub_ps(t[0][a], one);
+    __m128 n[8];
+    for (int c = 0; c < 8; c++) {
+        int i = c & 1, j = (c >> 1) & 1, k = (c >> 2) & 1;
+        __m128i hash = _mm_xor_si128(seed, _mm_xor_si128(h[i][0], _mm_xor_si128(h[j][1], h[k][2])));
+        n[c] = grad3_sse41(mix_sse41(hash), t[i][0], t[j][1], t[k][2]);
+    }
+    __m128 u = fade_sse41(t[0][0]), v = fade_sse41(t[0][1]), w = fade_sse41(t[0][2]);
+    __m128 a = lerp_sse41(lerp_sse41(n[0], n[1], u), lerp_sse41(n[2], n[3], u), v);
+    __m128 b = lerp_sse41(lerp_sse41(n[4], n[5], u), lerp_sse41(n[6], n[7], u), v);
+    return lerp_sse41(a, b, w);
+}
+
+static __m128 clamp_sse41(__m128 v) {
+    return _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+}
+
+static void fbm2_sse41(NoiseParams params, const float *x, const float *z, float *out) {
+    __m128 px = _mm_loadu_ps(x), pz = _mm_loadu_ps(z);
+    __m128 sum = _mm_setzero_ps();
+    float amplitude = 1.0f, total = 0.0f, frequency = params.frequency;
+    uint32_t seed = params.seed;
+    for (int o = 0; o < params.octaves; o++) {
+        __m128 f = _mm_set1_ps(frequency);
+        __m128 n = perlin2_sse41(_mm_set1_epi32((int)seed), _mm_mul_ps(px, f), _mm_mul_ps(pz, f));
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(amplitude), n));
+        total += amplitude;
+        amplitude *= 0.5f;
+        frequency *= 2.0f;
+        seed += OCTAVE_SEED;
+    }
+    _mm_storeu_ps(out, clamp_sse41(_mm_mul_ps(sum, _mm_set1_ps(SCALE_2D / total))));
+}
+
+static void fbm3_sse41(NoiseParams params, const float *x, const float *y, const float *z, float *out) {
+    __m128 px = _mm_loadu_ps(x), py = _mm_loadu_ps(y), pz = _mm_loadu_ps(z);
+    __m128 sum = _mm_setzero_ps();
+    float amplitude = 1.0f, total = 0.0f, frequency = params.frequency;
+    uint32_t seed = params.seed;
+    for (int o = 0; o < params.octaves; o++) {
+        __m128 f = _mm_set1_ps(frequency);
+        __m128 n = perlin3_sse41(_mm_set1_epi32((int)seed), _mm_mul_ps(px, f), _mm_mul_ps(py, f), _mm_mul_ps(pz, f));
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(amplitude), n));
+        total += amplitude;
+        amplitude *= 0.5f;
+        frequency *= 2.0f;
+        seed += OCTAVE_SEED;
+    }
+    _mm_storeu_ps(out, clamp_sse41(_mm_mul_ps(sum, _mm_set1_ps(SCALE_3D / total))));
+}
+#endif
+
+#ifdef __AVX2__
+// The SSE4.1 code on 8 points
+
+static inline __m256i mix_avx2(__m256i h) {
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+    h = _mm256_mullo_epi32(h, _mm256_set1_epi32((int)HASH_M1));
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 12));
+    h = _mm256_mullo_epi32(h, _mm256_set1_epi32((int)HASH_M2));
+    return _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+}
+
+static inline __m256 fade_avx2(__m256 t) {
+    __m256 p = _mm256_add_ps(_mm256_mul_ps(t, _mm256_sub_ps(_mm256_mul_ps(t, _mm256_set1_ps(6.0f)), _mm256_set1_ps(15.0f))), _mm256_set1_ps(10.0f));
+    return _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(t, t), t), p);
+}
+
+static inline __m256 lerp_avx2(__m256 a, __m256 b, __m256 t) {
+    return _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a)));
+}
+
+static inline __m256 flip_avx2(__m256 v, __m256i h, int bit) {
+    __m256i sign = _mm256_slli_epi32(_mm256_srli_epi32(h, bit), 31);
+    return _mm256_xor_ps(v, _mm256_castsi256_ps(sign));
+}
+
+static inline __m256 grad2_avx2(__m256i h, __m256 x, __m256 z) {
+    __m256 swap = _mm256_castsi256_ps(_mm256_slli_epi32(h, 29));
+    __m256 u = _mm256_blendv_ps(x, z, swap), v = _mm256_blendv_ps(z, x, swap);
+    return _mm256_add_ps(flip_avx2(u, h, 0), _mm256_mul_ps(_mm256_set1_ps(2.0f), flip_avx2(v, h, 1)));
+}
+
+static inline __m256 grad3_avx2(__m256i h, __m256 x, __m256 y, __m256 z) {
+    __m256 high = _mm256_castsi256_ps(_mm256_slli_epi32(h, 28));
+    __m256 low = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(h, _mm256_set1_epi32(12)), _mm256_setzero_si256()));
+    __m256 edge = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(h, _mm256_set1_epi32(13)), _mm256_set1_epi32(12)));
+    __m256 u = _mm256_blendv_ps(x, y, high);
+    __m256 v = _mm256_blendv_ps(_mm256_blendv_ps(z, x, edge), y, low);
+    return _mm256_add_ps(flip_avx2(u, h, 0), flip_avx2(v, h, 1));
+}
+
+static __m256 perlin2_avx2(__m256i seed, __m256 x, __m256 z) {
+    __m256 fx = _mm256_floor_ps(x), fz = _mm256_floor_ps(z);
+    __m256i hx = _mm256_mullo_epi32(_mm256_cvttps_epi32(fx), _mm256_set1_epi32((int)HASH_X));
+    __m256i hz = _mm256_mullo_epi32(_mm256_cvttps_epi32(fz), _mm256_set1_epi32((int)HASH_Z));
+    __m256i hx1 = _mm256_add_epi32(hx, _mm256_set1_epi32((int)HASH_X)), hz1 = _mm256_add_epi32(hz, _mm256_set1_epi32((int)HASH_Z));
+    __m256 tx = _mm256_sub_ps(x, fx), tz = _mm256_sub_ps(z, fz);
+    __m256 one = _mm256_set1_ps(1.0f);
+    __m256 tx1 = _mm256_sub_ps(tx, one), tz1 = _mm256_sub_ps(tz, one);
+    __m256 n00 = grad2_avx2(mix_avx2(_mm256_xor_si256(seed, _mm256_xor_si256(hx, hz))), tx, tz);
+    __m256 n10 = grad2_avx2(mix_avx2(_mm256_xor_si256(seed, _mm256_xor_si256(hx1, hz))), tx1, tz);
+    __m256 n01 = grad2_avx2(mix_avx2(_mm256_xor_si256(seed, _mm256_xor_si256(hx, hz1))), tx, tz1);
+    __m256 n11 = grad2_avx2(mix_avx2(_mm256_xor_si256(seed, _mm256_xor_si256(hx1, hz1))), tx1, tz1);
+    __m256 u = fade_avx2(tx), w = fade_avx2(tz);
+    return lerp_avx2(lerp_avx2(n00, n10, u), lerp_avx2(n01, n11, u), w);
+}
+
+static __m256 perlin3_avx2(__m256i seed, __m256 x, __m256 y, __m256 z) {
+    __m256 fx = _mm256_floor_ps(x), fy = _mm256_floor_ps(y), fz = _mm256_floor_ps(z);
+    __m256i h[2][3];
+    h[0][0] = _mm256_mullo_epi32(_mm256_cvttps_epi32(fx), _mm256_set1_epi32((int)HASH_X));
+    h[0][1] = _mm256_mullo_epi32(_mm256_cvttps_epi32(fy), _mm256_set1_epi32((int)HASH_Y));
+    h[0][2] = _mm256_mullo_epi32(_mm256_cvttps_epi32(fz), _mm256_set1_epi32((int)HASH_Z));
+    h[1][0] = _mm256_add_epi32(h[0][0], _mm256_set1_epi32((int)HASH_X));
+    h[1][1] = _mm256_add_epi32(h[0][1], _mm256_set1_epi32((int)HASH_Y));
+    h[1][2] = _mm256_add_epi32(h[0][2], _mm256_set1_epi32((int)HASH_Z));
+    __m256 one = _mm256_set1_ps(1.0f);
+    __m256 t[2][3];
+    t[0][0] = _mm256_sub_ps(x, fx);
+    t[0][1] = _mm256_sub_ps(y, fy);
+    t[0][2] = _mm256_sub_ps(z, fz);
+    for (int a = 0; a < 3; a++) t[1][a] = _mm256_sub_ps(t[0][a], one);
+    __m256 n[8];
+    for (int c = 0; c < 8; c++) {
+        int i = c & 1, j = (c >> 1) & 1, k = (c >> 2) & 1;
+        __m256i hash = _mm256_xor_si256(seed, _mm256_xor_si256(h[i][0], _mm256_xor_si256(h[j][1], h[k][2])));
+        n[c] = grad3_avx2(mix_avx2(hash), t[i][0], t[j][1], t[k][2]);
+    }
+    __m256 u = fade_avx2(t[0][0]), v = fade_avx2(t[0][1]), w = fade_avx2(t[0][2]);
+    __m256 a = lerp_avx2(lerp_avx2(n[0], n[1], u), lerp_avx2(n[2], n[3], u), v);
+    __m256 b = lerp_avx2(lerp_avx2(n[4], n[5], u), lerp_avx2(n[6], n[7], u), v);
+    return lerp_avx2(a, b, w);
+}
+
+static __m256 clamp_avx2(__m256 v) {
+    return _mm256_min_ps(_mm256_max_ps(v, _mm256_set1_ps(-1.0f)), _mm256_set1_ps(1.0f));
+}
+
+static void fbm2_avx2(NoiseParams params, const float *x, const float *z, float *out) {
+    __m256 px = _mm256_loadu_ps(x), pz = _mm256_loadu_ps(z);
+    __m256 sum = _mm256_setzero_ps();
+    float amplitude = 1.0f, total = 0.0f, frequency = params.frequency;
+    uint32_t seed = params.seed;
+    for (int o = 0; o < params.octaves; o++) {
+        __m256 f = _mm256_set1_ps(frequency);
+        __m256 n = perlin2_avx2(_mm256_set1_epi32((int)seed), _mm256_mul_ps(px, f), _mm256_mul_ps(pz, f));
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(amplitude), n));
+        total += amplitude;
+        amplitude *= 0.5f;
+        frequency *= 2.0f;
+        seed += OCTAVE_SEED;
+    }
+    _mm256_storeu_ps(out, clamp_avx2(_mm256_mul_ps(sum, _mm256_set1_ps(SCALE_2D / total))));
+}
+
+static void fbm3_avx2(NoiseParams params, const float *x, const float *y, const float *z, float *out) {
+    __m256 px = _mm256_loadu_ps(x), py = _mm256_loadu_ps(y), pz = _mm256_loadu_ps(z);
+    __m256 sum = _mm256_setzero_ps();
+    float amplitude = 1.0f, total = 0.0f, frequency = params.frequency;
+    uint32_t seed = params.seed;
+    for (int o = 0; o < params.octaves; o++) {
+        __m256 f = _mm256_set1_ps(frequency);
+        __m256 n = perlin3_avx2(_mm256_set1_epi32((int)seed), _mm256_mul_ps(px, f), _mm256_mul_ps(py, f), _mm256_mul_ps(pz, f));
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(amplitude), n));
+        total += amplitude;
+        amplitude *= 0.5f;
+        frequency *= 2.0f;
+        seed += OCTAVE_SEED;
+    }
+    _mm256_storeu_ps(out, clamp_avx2(_mm256_mul_ps(sum, _mm256_set1_ps(SCALE_3D / total))));
+}
+#endif
+
+typedef void (*Fbm2Batch)(NoiseParams params, const float *x, const float *z, float *out);
+typedef void (*Fbm3Batch)(NoiseParams params, const float *x, const float *y, const float *z, float *out);
+
+typedef struct NoiseKernel {
+    const char *name;
+    int lanes;         // 0: not compiled in
+    Fbm2Batch fbm2;
+    Fbm3Batch fbm3;
+} NoiseKernel;
+
+static const NoiseKernel g_kernels[NOISE_BACKEND_COUNT] = {
+    [NOISE_SCALAR] = { "scalar", 1, fbm2_scalar, fbm3_scalar },
+#ifdef __SSE4_1__
+    [NOISE_SSE41] = { "sse4.1", 4, fbm2_sse41, fbm3_sse41 },
+#else
+    [NOISE_SSE41] = { "sse4.1", 0, NULL, NULL },
+#endif
+#ifdef __AVX2__
+    [NOISE_AVX2] = { "avx2", 8, fbm2_avx2, fbm3_avx2 },
+#else
+    [NOISE_AVX2] = { "avx2", 0, NULL, NULL },
+#endif
+};
+
+NoiseBackend NoiseBestBackend(void) {
+    NoiseBackend best = NOISE_SCALAR;
+    for (int b = 0; b < NOISE_BACKEND_COUNT; b++) {
+        if (g_kernels[b].lanes > g_kernels[best].lanes) best = (NoiseBackend)b;
+    }
+    return best;
+}
+
+int NoiseBackendAvailable(NoiseBackend backend) {
+    return backend >= 0 && backend < NOISE_BACKEND_COUNT && g_kernels[backend].lanes > 0;
+}
+
+const char *NoiseBackendName(NoiseBackend backend) {
+    return NoiseBackendAvailable(backend) ? g_kernels[backend].name : "none";
+}
+
+void NoiseFbm2DOn(NoiseBackend backend, NoiseParams params, const float *x, const float *z, float *out, int count) {
+    const NoiseKernel *k = &g_kernels[NoiseBackendAvailable(backend) ? backend : NOISE_SCALAR];
+    int i = 0;
+    for (; i + k->lanes <= count; i += k->lanes) k->fbm2(params, x + i, z + i, out + i);
+    if (i < count) {
+        // the rest, padded with copies of its first point
+        float px[MAX_LANES], pz[MAX_LANES], po[MAX_LANES];
+        for (int l = 0; l < k->lanes; l++) {
+            px[l] = x[i + l < count ? i + l : i];
+            pz[l] = z[i + l < count ? i + l : i];
+        }
+        k->fbm2(params, px, pz, po);
+        memcpy(out + i, po, (count - i) * sizeof(float));
+    }
+}
+
+void NoiseFbm3DOn(NoiseBackend backend, NoiseParams params, const float *x, const float *y, const float *z, float *out, int count) {
+    const NoiseKernel *k = &g_kernels[NoiseBackendAvailable(backend) ? backend : NOISE_SCALAR];
+    int i = 0;
+    for (; i + k->lanes <= count; i += k->lanes) k->fbm3(params, x + i, y + i, z + i, out + i);
+    if (i < count) {
+        float px[MAX_LANES], py[MAX_LANES], pz[MAX_LANES], po[MAX_LANES];
+        for (int l = 0; l < k->lanes; l++) {
+            px[l] = x[i + l < count ? i + l : i];
+            py[l] = y[i + l < count ? i + l : i];
+            pz[l] = z[i + l < count ? i + l : i];
+        }
+        k->fbm3(params, px, py, pz, po);
+        memcpy(out + i, po, (count - i) * sizeof(float));
+    }
+}
+
+void NoiseFbm2D(NoiseParams params, const float *x, const float *z, float *out, int count) {
+    NoiseFbm2DOn(NoiseBestBackend(), params, x, z, out, count);
+}
+
+void NoiseFbm3D(NoiseParams params, const float *x, const float *y, const float *z, float *out, int count) {
+    NoiseFbm3DOn(NoiseBestBackend(), params, x, y, z, out, count);
+}
@@ -0,0 +1,43 @@
+#ifndef NOISE_H
+#define NOISE_H
+
+#include <stdint.h>
+
+// Gradient (Perlin) noise for the terrain generator, summed over octaves. It
+// has no state: gradients come from a hash of the seed and the lattice
+// coordinates, so the same seed and point give the same value on any thread.
+//
+// Points are evaluated in batches, 8 at a time with AVX2 or 4 with SSE4.1 when
+// the compiler targets them (-march=native), one at a time otherwise.
+// The end of a batch is padded, so every point goes through the same code and
+// a lone point (terrainHeightAt) gets exactly the value it has in a chunk.
+
+typedef enum {
+    NOISE_SCALAR,
+    NOISE_SSE41,
+    NOISE_AVX2,
+    NOISE_BACKEND_COUNT
+} NoiseBackend;
+
+typedef struct NoiseParams {
+    uint32_t seed;
+    int octaves;     // each one twice the frequency and half the amplitude of the previous
+    float frequency; // of the first octave, per block
+} NoiseParams;
+
+// Widest backend compiled in: the one NoiseFbm2D and NoiseFbm3D use
+NoiseBackend NoiseBestBackend(void);
+// 0 if backend was not compiled in (the scalar one always is)
+int NoiseBackendAvailable(NoiseBackend backend);
+const char *NoiseBackendName(NoiseBackend backend);
+
+// out[i]: noise at (x[i], z[i]), in [-1, 1]
+void NoiseFbm2D(NoiseParams params, const float *x, const float *z, float *out, int count);
+// out[i]: noise at (x[i], y[i], z[i]), in [-1, 1]
+void NoiseFbm3D(NoiseParams params, const float *x, const float *y, const float *z, float *out, int count);
+// Same on a given backend (benchmarks). Every backend gives the same bits as
+// long as the compiler does not fuse multiplies and adds (-ffp-contract=off).
+void NoiseFbm2DOn(NoiseBackend backend, NoiseParams params, const float *x, const float *z, float *out, int count);
+void NoiseFbm3DOn(NoiseBackend backend, NoiseParams params, const float *x, const float *y, const float *z, float *out, int count);
+
+#endif // NOISE_H
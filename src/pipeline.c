@@ -0,0 +1,607 @@
+#include "pipeline.h"
+#include "region.h"
+#include "save.h"
+#include "residency.h"
+#include "mesh.h"
+#include "jobs.h"
+#include "data.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+// Steps a chunk finishes on the way, each one waited for by the chunks
+// around it
+enum {
+    STEP_GENERATE,
+    STEP_POPULATE,
+    STEP_LIGHT, // its light job ran
+    STEP_LIT,   // its light is final
+    STEP_COUNT
+};
+
+typedef struct ChunkSlot {
+    int x, z;      // chunk of the slot (Chunk.x/z only follow once it is generated)
+    int present;   // cleared while a batch of slots changes hands
+    int filled;    // Chunk.data holds the generated chunk Chunk.x/z (under LockChunkData)
+    unsigned done; // steps finished, one bit each
+    // per step, chunks of the 3x3 neighbourhood (this one included, missing
+    // ones left out) that have not finished it; the last one starts the next
+    // step of this chunk, and the count stays at 0 from then on
+    int wait[STEP_COUNT];
+    double since;  // when the chunk entered its current stage
+    int seen;      // within view of the player (main thread)
+    int evicted;   // in range, but its blocks were freed for the memory budget (main thread)
+} ChunkSlot;
+
+// Chunks loaded on each side of the centre of the grid
+#define LOAD_DISTANCE ((CHUNK_GRID_SIDE - 1) / 2)
+// How far ahead the player's position is extrapolated to place the grid
+#define PREFETCH_SECONDS 1.5f
+// Below this speed (blocks per second) the grid stays put while it still
+// covers the view, so that looking around does not move chunks in and out
+#define PREFETCH_MIN_SPEED 1.0f
+
+// A generation job waiting to be submitted, with how far its chunk is from
+// where the player is heading
+typedef struct PendingGeneration {
+    ChunkHandle handle;
+    float distance;
+} PendingGeneration;
+
+static Chunk *g_chunks = NULL;
+static int g_totalChunks = 0;
+static ChunkSlot *g_slots = NULL;
+static int g_centerX = 0, g_centerZ = 0;
+static int g_playerX = 0, g_playerZ = 0;
+// Guards the slots, the stage changes and the statistics. Held for a few
+// counter updates per finished step, never while the work of a step runs.
+static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+static JobCounter g_pipelineJobs = {0};
+static int g_releasing = 0; // evicted chunks whose blocks release_job did not free yet
+static ChunkStageStats g_stats[CHUNK_STAGE_COUNT];
+static double g_latencySum[CHUNK_STAGE_COUNT];
+static ChunkCancelStats g_cancel;
+static ChunkPrefetchStats g_prefetch;
+static double g_generateSeconds = 0.0, g_lightSeconds = 0.0; // worker time of the jobs that went through
+static long g_generateJobs = 0, g_lightJobs = 0;
+static long g_sourceChunks[CHUNK_SOURCE_COUNT];
+static double g_sourceSeconds[CHUNK_SOURCE_COUNT];
+
+static const char *g_stageNames[CHUNK_STAGE_COUNT] = {
+    "empty", "generated", "neighbors", "populated", "lit", "meshed", "uploaded",
+};
+
+static const char *g_sourceNames[CHUNK_SOURCE_COUNT] = {
+    "kept", "cold", "save", "region", "generated",
+};
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Jobs get their handle packed in the argument pointer (64 bit pointers)
+static void *pack_handle(ChunkHandle handle) {
+    return (void *)(uintptr_t)((uint64_t)handle.epoch << 32 | (uint32_t)handle.index);
+}
+
+static ChunkHandle unpack_handle(void *arg) {
+    uint64_t bits = (uint64_t)(uintptr_t)arg;
+    return (ChunkHandle){ (int)(bits & 0xFFFFFFFFu), (unsigned)(bits >> 32) };
+}
+
+ChunkHandle ChunkHandleOf(int chunkIndex) {
+    return (ChunkHandle){ chunkIndex, __atomic_load_n(&g_chunks[chunkIndex].epoch, __ATOMIC_ACQUIRE) };
+}
+
+int ChunkHandleCancelled(ChunkHandle handle) {
+    return __atomic_load_n(&g_chunks[handle.index].epoch, __ATOMIC_ACQUIRE) != handle.epoch;
+}
+
+// Called with g_mutex held
+static void enter_stage(int index, ChunkStage stage) {
+    double now = now_seconds();
+    ChunkSlot *slot = &g_slots[index];
+    double latency = now - slot->since;
+    slot->since = now;
+    ChunkStageStats *s = &g_stats[stage];
+    g_stats[stage - 1].chunks--;
+    s->chunks++;
+    s->entered++;
+    g_latencySum[stage] += latency;
+    if (latency > s->maxLatency) s->maxLatency = latency;
+    __atomic_store_n(&g_chunks[index].stage, (int)stage, __ATOMIC_RELEASE);
+}
+
+// Slots of the chunks in range around slot index, itself included
+static int neighbors(int index, int out[9]) {
+    const ChunkSlot *slot = &g_slots[index];
+    int count = 0;
+    for (int dx = -1; dx <= 1; dx++) {
+        for (int dz = -1; dz <= 1; dz++) {
+            int n = chunkSlot(slot->x + dx, slot->z + dz);
+            const ChunkSlot *other = &g_slots[n];
+            if (other->present && other->x == slot->x + dx && other->z == slot->z + dz) out[count++] = n;
+        }
+    }
+    return count;
+}
+
+static void light_job(void *arg);
+static void finish_step(int index, int step);
+
+// Every chunk around `index` is done with `step`: start what comes after
+static void start_next(int index, int step) {
+    switch (step) {
+    case STEP_GENERATE:
+        // nothing to place across borders yet: populated right away
+        enter_stage(index, CHUNK_STAGE_NEIGHBORS_READY);
+        enter_stage(index, CHUNK_STAGE_POPULATED);
+        finish_step(index, STEP_POPULATE);
+        break;
+    case STEP_POPULATE:
+        JobSubmit(light_job, pack_handle(ChunkHandleOf(index)), JOB_PRIORITY_NORMAL, &g_pipelineJobs);
+        break;
+    case STEP_LIGHT:
+        // lighting a chunk also spreads into its lit neighbours, so the light
+        // is final once they all ran
+        enter_stage(index, CHUNK_STAGE_LIT);
+        finish_step(index, STEP_LIT);
+        break;
+    case STEP_LIT:
+        ScheduleChunkRemesh(index, 0);
+        break;
+    }
+}
+
+// Called with g_mutex held
+static void finish_step(int index, int step) {
+    g_slots[index].done |= 1u << step;
+    int around[9];
+    for (int i = neighbors(index, around) - 1; i >= 0; i--) {
+        int *wait = &g_slots[around[i]].wait[step];
+        if (*wait == 0) {
+            // went on before this chunk came into range: its border was
+            // meshed against nothing
+            if (step == STEP_LIT) ScheduleChunkRemesh(around[i], 0);
+            continue;
+        }
+        if (--*wait == 0) start_next(around[i], step);
+    }
+}
+
+// The chunk of slot index came into range (called with g_mutex held, slot
+// coordinates set): it waits for every neighbour in range, and they wait for
+// it unless they already went on
+static void arrive(int index) {
+    ChunkSlot *slot = &g_slots[index];
+    slot->present = 1;
+    slot->done = 0;
+    int around[9];
+    int count = neighbors(index, around);
+    for (int step = 0; step < STEP_COUNT; step++) {
+        slot->wait[step] = 0;
+        for (int i = 0; i < count; i++) {
+            ChunkSlot *other = &g_slots[around[i]];
+            if (!(other->done & (1u << step))) slot->wait[step]++;
+            if (around[i] != index && other->wait[step] > 0) other->wait[step]++;
+        }
+    }
+}
+
+// The chunk of slot index left range (called with g_mutex held, once the slot
+// is no longer present): its neighbours stop waiting for it
+static void leave(int index) {
+    const ChunkSlot *slot = &g_slots[index];
+    int around[9];
+    for (int step = 0; step < STEP_COUNT; step++) {
+        if (slot->done & (1u << step)) continue;
+        for (int i = neighbors(index, around) - 1; i >= 0; i--) {
+            int *wait = &g_slots[around[i]].wait[step];
+            if (*wait > 0 && --*wait == 0) start_next(around[i], step);
+        }
+    }
+}
+
+// Generate (or load) into a thread-local chunk, then take the slot over while
+// no light or mesh job reads it. A chunk back before its slot was reused still
+// has its blocks there, unsaved edits included.
+static void generate_job(void *arg) {
+    ChunkHandle handle = unpack_handle(arg);
+    if (ChunkHandleCancelled(handle)) {
+        __atomic_fetch_add(&g_cancel.generateSkipped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    double start = now_seconds();
+    Chunk *chunk = &g_chunks[handle.index];
+    pthread_mutex_lock(&g_mutex);
+    int x = g_slots[handle.index].x, z = g_slots[handle.index].z;
+    pthread_mutex_unlock(&g_mutex);
+
+    LockChunkData();
+    int kept = g_slots[handle.index].filled && chunk->x == x && chunk->z == z;
+    if (kept) chunk->lit = 0;
+    UnlockChunkData();
+    ChunkSource source = CHUNK_SOURCE_KEPT;
+    double loadSeconds = 0.0;
+    if (!kept) {
+        static _Thread_local Chunk fresh;
+        // back from the cold tier if it left range or was evicted a moment
+        // ago; edits of a chunk that left may still wait for the save job
+        double loadStart = now_seconds();
+        if (ResidencyRestore(&fresh, x, z)) source = CHUNK_SOURCE_COLD;
+        else if (RestorePendingSave(&fresh, x, z)) source = CHUNK_SOURCE_SAVE;
+        else source = RegionLoadChunk(&fresh, x, z) ? CHUNK_SOURCE_REGION : CHUNK_SOURCE_GENERATED;
+        loadSeconds = now_seconds() - loadStart;
+        LockChunkData();
+        if (ChunkHandleCancelled(handle)) {
+            UnlockChunkData();
+            __atomic_fetch_add(&g_cancel.generateWasted, 1, __ATOMIC_RELAXED);
+            return;
+        }
+        // the chunk that left the slot goes to the save job if it has unsaved
+        // edits, and to the cold tier (encoded while nothing reads or lights
+        // it, a fraction of a generation)
+        if (g_slots[handle.index].filled) {
+            if (chunk->dirty) SaveChunk(chunk);
+            ResidencyStoreChunk(chunk);
+        }
+        chunk->x = fresh.x;
+        chunk->z = fresh.z;
+        chunk->lit = 0;
+        chunk->dirty = 0;
+        chunk->blockHash = fresh.blockHash;
+        for (int side = 0; side < 4; side++) chunk->sideHash[side] = fresh.sideHash[side];
+        // the blocks of the previous chunk become this worker's buffer for the
+        // next load (NULL after an eviction: allocated again then)
+        ChunkData *previous = chunk->data;
+        chunk->data = fresh.data;
+        fresh.data = previous;
+        // meshes still reading the previous chunk are stale
+        __atomic_fetch_add(&chunk->version, 1, __ATOMIC_SEQ_CST);
+        g_slots[handle.index].filled = 1;
+        UnlockChunkData();
+    }
+
+    pthread_mutex_lock(&g_mutex);
+    if (kept) g_cancel.kept++;
+    g_sourceChunks[source]++;
+    g_sourceSeconds[source] += loadSeconds;
+    g_generateSeconds += now_seconds() - start;
+    g_generateJobs++;
+    if (!ChunkHandleCancelled(handle)) {
+        enter_stage(handle.index, CHUNK_STAGE_GENERATED);
+        finish_step(handle.index, STEP_GENERATE);
+    }
+    pthread_mutex_unlock(&g_mutex);
+}
+
+static void light_job(void *arg) {
+    ChunkHandle handle = unpack_handle(arg);
+    double start = now_seconds();
+    if (!LightChunk(handle.index, handle.epoch)) {
+        __atomic_fetch_add(&g_cancel.lightSkipped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    pthread_mutex_lock(&g_mutex);
+    g_lightSeconds += now_seconds() - start;
+    g_lightJobs++;
+    if (!ChunkHandleCancelled(handle)) finish_step(handle.index, STEP_LIGHT);
+    pthread_mutex_unlock(&g_mutex);
+}
+
+static int chunk_of(Vector3 playerPos, int axis) {
+    return (int)floorf((axis == 0 ? playerPos.x : playerPos.z) / CHUNK_SIZE);
+}
+
+// Coordinate on one axis of the chunk in range that falls in slot row `row`
+static int coordinate_in_range(int row, int center) {
+    int first = center - LOAD_DISTANCE;
+    int offset = (row - first) % CHUNK_GRID_SIDE;
+    if (offset < 0) offset += CHUNK_GRID_SIDE;
+    return first + offset;
+}
+
+static int clamp_prefetch(int offset) {
+    return offset < -PREFETCH_DISTANCE ? -PREFETCH_DISTANCE : offset > PREFETCH_DISTANCE ? PREFETCH_DISTANCE : offset;
+}
+
+// Where the player is heading: the position PREFETCH_SECONDS ahead at the
+// current velocity, nudged a chunk along the look direction
+static Vector3 heading_point(Vector3 playerPos, Vector3 velocity, Vector3 direction) {
+    float length = sqrtf(direction.x * direction.x + direction.z * direction.z);
+    float lookX = length > 0.0f ? direction.x / length : 0.0f;
+    float lookZ = length > 0.0f ? direction.z / length : 0.0f;
+    return (Vector3){
+        playerPos.x + velocity.x * PREFETCH_SECONDS + lookX * CHUNK_SIZE,
+        playerPos.y,
+        playerPos.z + velocity.z * PREFETCH_SECONDS + lookZ * CHUNK_SIZE,
+    };
+}
+
+// Centre of the grid: shifted up to PREFETCH_DISTANCE chunks from the
+// player's chunk toward where the velocity takes them, so that the chunks
+// ahead are loaded before they come into view. Either way the view stays
+// inside the grid.
+static void predict_center(Vector3 playerPos, Vector3 velocity, int *centerX, int *centerZ) {
+    int playerX = chunk_of(playerPos, 0), playerZ = chunk_of(playerPos, 2);
+    if (velocity.x * velocity.x + velocity.z * velocity.z < PREFETCH_MIN_SPEED * PREFETCH_MIN_SPEED) {
+        if (abs(g_centerX - playerX) <= PREFETCH_DISTANCE && abs(g_centerZ - playerZ) <= PREFETCH_DISTANCE) {
+            *centerX = g_centerX;
+            *centerZ = g_centerZ;
+        } else {
+            *centerX = playerX;
+            *centerZ = playerZ;
+        }
+        return;
+    }
+    Vector3 ahead = { playerPos.x + velocity.x * PREFETCH_SECONDS, 0.0f, playerPos.z + velocity.z * PREFETCH_SECONDS };
+    *centerX = playerX + clamp_prefetch(chunk_of(ahead, 0) - playerX);
+    *centerZ = playerZ + clamp_prefetch(chunk_of(ahead, 2) - playerZ);
+}
+
+// Called with g_mutex held: the chunk of slot index starts over as an empty
+// chunk waiting for its generation job
+static ChunkHandle restart_slot(int index) {
+    ChunkSlot *slot = &g_slots[index];
+    Chunk *chunk = &g_chunks[index];
+    slot->since = now_seconds();
+    slot->seen = 0;
+    slot->evicted = 0;
+    ChunkHandle handle = { index, __atomic_add_fetch(&chunk->epoch, 1, __ATOMIC_ACQ_REL) };
+    g_stats[chunk->stage].chunks--;
+    g_stats[CHUNK_STAGE_EMPTY].chunks++;
+    __atomic_store_n(&chunk->stage, CHUNK_STAGE_EMPTY, __ATOMIC_RELEASE);
+    ResetChunkRender(index, slot->x, slot->z);
+    arrive(index);
+    return handle;
+}
+
+// Called with g_mutex held: slot index goes to the chunk in range that maps to
+// it
+static ChunkHandle assign_slot(int index) {
+    ChunkSlot *slot = &g_slots[index];
+    slot->x = coordinate_in_range(index / CHUNK_GRID_SIDE, g_centerX);
+    slot->z = coordinate_in_range(index % CHUNK_GRID_SIDE, g_centerZ);
+    return restart_slot(index);
+}
+
+static int compare_pending(const void *a, const void *b) {
+    float da = ((const PendingGeneration *)a)->distance, db = ((const PendingGeneration *)b)->distance;
+    return (da < db) - (da > db);
+}
+
+// Called with g_mutex held: submit the generation of the chunks in pending,
+// farthest from `heading` first. A worker runs the newest job of its deque
+// first, so the chunks the player is about to see go before the others.
+static void submit_generations(PendingGeneration *pending, int count, Vector3 heading) {
+    for (int i = 0; i < count; i++) {
+        const ChunkSlot *slot = &g_slots[pending[i].handle.index];
+        float dx = (slot->x + 0.5f) * CHUNK_SIZE - heading.x;
+        float dz = (slot->z + 0.5f) * CHUNK_SIZE - heading.z;
+        pending[i].distance = dx * dx + dz * dz;
+    }
+    qsort(pending, count, sizeof(PendingGeneration), compare_pending);
+    for (int i = 0; i < count; i++) {
+        JobSubmit(generate_job, pack_handle(pending[i].handle), JOB_PRIORITY_NORMAL, &g_pipelineJobs);
+    }
+}
+
+// Called with g_mutex held, once the player is in chunk playerX/Z: the chunks
+// now within view distance that were not before count as prefetch hits if
+// they are already on screen, misses if not (only marked when `count` is 0,
+// for the chunks in view when the pipeline starts)
+static void track_view(int playerX, int playerZ, int count) {
+    g_playerX = playerX;
+    g_playerZ = playerZ;
+    for (int i = 0; i < g_totalChunks; i++) {
+        ChunkSlot *slot = &g_slots[i];
+        int inView = slot->present && abs(slot->x - playerX) <= VIEW_DISTANCE && abs(slot->z - playerZ) <= VIEW_DISTANCE;
+        if (inView && !slot->seen && count) {
+            if (__atomic_load_n(&g_chunks[i].stage, __ATOMIC_ACQUIRE) == CHUNK_STAGE_UPLOADED) g_prefetch.hits++;
+            else g_prefetch.misses++;
+        }
+        slot->seen = inView;
+    }
+}
+
+void StartChunkPipeline(Chunk *chunks, int totalChunks, Vector3 playerPos) {
+    static PendingGeneration pending[CHUNK_GRID_SIDE * CHUNK_GRID_SIDE];
+    g_chunks = chunks;
+    g_totalChunks = totalChunks;
+    free(g_slots);
+    g_slots = calloc(totalChunks, sizeof(ChunkSlot));
+    for (int s = 0; s < CHUNK_STAGE_COUNT; s++) {
+        g_stats[s] = (ChunkStageStats){0};
+        g_latencySum[s] = 0.0;
+    }
+    g_stats[CHUNK_STAGE_EMPTY].chunks = totalChunks;
+    g_cancel = (ChunkCancelStats){0};
+    g_prefetch = (ChunkPrefetchStats){0};
+    g_generateSeconds = g_lightSeconds = 0.0;
+    g_generateJobs = g_lightJobs = 0;
+    for (int source = 0; source < CHUNK_SOURCE_COUNT; source++) {
+        g_sourceChunks[source] = 0;
+        g_sourceSeconds[source] = 0.0;
+    }
+    g_centerX = chunk_of(playerPos, 0);
+    g_centerZ = chunk_of(playerPos, 2);
+    pthread_mutex_lock(&g_mutex);
+    for (int i = 0; i < totalChunks; i++) chunks[i].stage = CHUNK_STAGE_EMPTY;
+    for (int i = 0; i < totalChunks; i++) pending[i].handle = assign_slot(i);
+    submit_generations(pending, totalChunks, playerPos);
+    track_view(g_centerX, g_centerZ, 0);
+    pthread_mutex_unlock(&g_mutex);
+}
+
+// Slots change hands as a batch: all the leaving chunks are taken out before
+// their neighbours stop waiting for them, so none of them starts a step just
+// to be cancelled. Edits not saved yet are snapshotted by the generation that
+// takes the slot over, off the main thread: until then the blocks stay in the
+// slot, where the chunk would come back to.
+void StreamChunks(Vector3 playerPos, Vector3 velocity, Vector3 direction) {
+    static PendingGeneration pending[CHUNK_GRID_SIDE * CHUNK_GRID_SIDE];
+    int playerX = chunk_of(playerPos, 0), playerZ = chunk_of(playerPos, 2);
+    int centerX, centerZ;
+    predict_center(playerPos, velocity, &centerX, &centerZ);
+    if (centerX == g_centerX && centerZ == g_centerZ && playerX == g_playerX && playerZ == g_playerZ) return;
+    pthread_mutex_lock(&g_mutex);
+    if (centerX != g_centerX || centerZ != g_centerZ) {
+        int count = 0;
+        g_centerX = centerX;
+        g_centerZ = centerZ;
+        for (int i = 0; i < g_totalChunks; i++) {
+            ChunkSlot *slot = &g_slots[i];
+            if (abs(slot->x - centerX) <= LOAD_DISTANCE && abs(slot->z - centerZ) <= LOAD_DISTANCE) continue;
+            slot->present = 0;
+            pending[count++].handle.index = i;
+        }
+        // evicted chunks already left the pipeline
+        for (int i = 0; i < count; i++) {
+            if (!g_slots[pending[i].handle.index].evicted) leave(pending[i].handle.index);
+        }
+        for (int i = 0; i < count; i++) pending[i].handle = assign_slot(pending[i].handle.index);
+        submit_generations(pending, count, heading_point(playerPos, velocity, direction));
+        g_cancel.left += count;
+    }
+    track_view(playerX, playerZ, 1);
+    g_prefetch.aheadX = centerX - playerX;
+    g_prefetch.aheadZ = centerZ - playerZ;
+    pthread_mutex_unlock(&g_mutex);
+}
+
+int ChunkSlotCoords(int chunkIndex, int *chunkX, int *chunkZ) {
+    pthread_mutex_lock(&g_mutex);
+    const ChunkSlot *slot = &g_slots[chunkIndex];
+    *chunkX = slot->x;
+    *chunkZ = slot->z;
+    int resident = !slot->evicted;
+    pthread_mutex_unlock(&g_mutex);
+    return resident;
+}
+
+// Moves the blocks of an evicted chunk to the cold tier and frees them once no
+// light or mesh job of a neighbour reads them. A job and not the main thread:
+// the write lock waits for every mesh job in flight, and the compression takes
+// a fraction of a generation. A chunk readmitted meanwhile (the epoch moved
+// on) keeps its blocks, the generation finds them in place.
+static void release_job(void *arg) {
+    ChunkHandle handle = unpack_handle(arg);
+    Chunk *chunk = &g_chunks[handle.index];
+    LockChunkData();
+    __atomic_fetch_sub(&g_releasing, 1, __ATOMIC_RELAXED);
+    if (!ChunkHandleCancelled(handle)) {
+        if (chunk->dirty) SaveChunk(chunk);
+        ResidencyStoreChunk(chunk);
+        freeChunkData(chunk->data);
+        chunk->data = NULL;
+        g_slots[handle.index].filled = 0;
+    }
+    UnlockChunkData();
+}
+
+// Like a chunk leaving range, except that the slot keeps its coordinates
+void EvictChunk(int chunkIndex) {
+    Chunk *chunk = &g_chunks[chunkIndex];
+    pthread_mutex_lock(&g_mutex);
+    ChunkSlot *slot = &g_slots[chunkIndex];
+    if (!slot->present) {
+        pthread_mutex_unlock(&g_mutex);
+        return;
+    }
+    slot->present = 0;
+    slot->evicted = 1;
+    leave(chunkIndex);
+    ChunkHandle handle = { chunkIndex, __atomic_add_fetch(&chunk->epoch, 1, __ATOMIC_ACQ_REL) };
+    g_stats[chunk->stage].chunks--;
+    g_stats[CHUNK_STAGE_EMPTY].chunks++;
+    __atomic_store_n(&chunk->stage, CHUNK_STAGE_EMPTY, __ATOMIC_RELEASE);
+    ResetChunkRender(chunkIndex, slot->x, slot->z);
+    __atomic_fetch_add(&g_releasing, 1, __ATOMIC_RELAXED);
+    JobSubmit(release_job, pack_handle(handle), JOB_PRIORITY_NORMAL, &g_pipelineJobs);
+    pthread_mutex_unlock(&g_mutex);
+}
+
+size_t ChunkDataReleasing(void) {
+    return (size_t)__atomic_load_n(&g_releasing, __ATOMIC_RELAXED) * sizeof(ChunkData);
+}
+
+void ReadmitChunk(int chunkIndex) {
+    pthread_mutex_lock(&g_mutex);
+    if (g_slots[chunkIndex].evicted) {
+        JobSubmit(generate_job, pack_handle(restart_slot(chunkIndex)), JOB_PRIORITY_NORMAL, &g_pipelineJobs);
+    }
+    pthread_mutex_unlock(&g_mutex);
+}
+
+void ShutdownChunkPipeline(void) {
+    JobWait(&g_pipelineJobs);
+}
+
+void ChunkPipelineReached(ChunkHandle handle, ChunkStage stage) {
+    if (handle.index < 0 || handle.index >= g_totalChunks) return;
+    // the mesh system only reports meshes and uploads; a mesh built before the
+    // neighbourhood is lit (remesh after an edit next door) does not count
+    if (stage < CHUNK_STAGE_MESHED) return;
+    pthread_mutex_lock(&g_mutex);
+    Chunk *chunk = &g_chunks[handle.index];
+    if (!ChunkHandleCancelled(handle) && chunk->stage == (int)stage - 1 &&
+        (stage != CHUNK_STAGE_MESHED || g_slots[handle.index].wait[STEP_LIT] == 0)) {
+        enter_stage(handle.index, stage);
+    }
+    pthread_mutex_unlock(&g_mutex);
+}
+
+void GetChunkPipelineStats(ChunkStageStats stats[CHUNK_STAGE_COUNT]) {
+    pthread_mutex_lock(&g_mutex);
+    for (int s = 0; s < CHUNK_STAGE_COUNT; s++) {
+        stats[s] = g_stats[s];
+        stats[s].queued = s > 0 ? g_stats[s - 1].chunks : 0;
+        stats[s].meanLatency = g_stats[s].entered > 0 ? g_latencySum[s] / g_stats[s].entered : 0.0;
+    }
+    pthread_mutex_unlock(&g_mutex);
+}
+
+ChunkCancelStats GetChunkCancelStats(void) {
+    MeshJobStats mesh = GetMeshJobStats();
+    pthread_mutex_lock(&g_mutex);
+    ChunkCancelStats stats = g_cancel;
+    stats.generateSkipped = __atomic_load_n(&g_cancel.generateSkipped, __ATOMIC_RELAXED);
+    stats.generateWasted = __atomic_load_n(&g_cancel.generateWasted, __ATOMIC_RELAXED);
+    stats.lightSkipped = __atomic_load_n(&g_cancel.lightSkipped, __ATOMIC_RELAXED);
+    double generate = g_generateJobs > 0 ? g_generateSeconds / g_generateJobs : 0.0;
+    double light = g_lightJobs > 0 ? g_lightSeconds / g_lightJobs : 0.0;
+    pthread_mutex_unlock(&g_mutex);
+    stats.meshSkipped = mesh.cancelled;
+    double meshing = mesh.meshed > 0 ? mesh.seconds / mesh.meshed : 0.0;
+    stats.savedSeconds = stats.generateSkipped * generate + stats.lightSkipped * light + stats.meshSkipped * meshing;
+    return stats;
+}
+
+ChunkPrefetchStats GetChunkPrefetchStats(void) {
+    pthread_mutex_lock(&g_mutex);
+    ChunkPrefetchStats stats = g_prefetch;
+    pthread_mutex_unlock(&g_mutex);
+    return stats;
+}
+
+void GetChunkSourceStats(ChunkSourceStats stats[CHUNK_SOURCE_COUNT]) {
+    pthread_mutex_lock(&g_mutex);
+    for (int source = 0; source < CHUNK_SOURCE_COUNT; source++) {
+        stats[source].chunks = g_sourceChunks[source];
+        stats[source].meanSeconds = g_sourceChunks[source] > 0 ? g_sourceSeconds[source] / g_sourceChunks[source] : 0.0;
+    }
+    pthread_mutex_unlock(&g_mutex);
+}
+
+const char *ChunkSourceName(ChunkSource source) {
+    return source >= 0 && source < CHUNK_SOURCE_COUNT ? g_sourceNames[source] : "?";
+}
+
+const char *ChunkStageName(ChunkStage stage) {
+    return stage >= 0 && stage < CHUNK_STAGE_COUNT ? g_stageNames[stage] : "?";
+}
@@ -0,0 +1,121 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "data.h"
+
+// Path of every chunk from an empty slot to a mesh on screen. Each stage
+// depends on the 3x3 neighbourhood having reached the one before, because
+// that is what the work of the stage reads: decoration can reach into the
+// neighbours, the light floods across borders, and the mesher pads the chunk
+// with its neighbours' border blocks and light. Every chunk keeps, per
+// stage, how many of its neighbours it still waits for; a chunk finishing a
+// stage counts itself down in its neighbours, and the last one starts the
+// next stage of the waiting chunk right away, as a job. Nothing polls, and
+// since a chunk is only meshed once everything around it is final, no border
+// gets meshed twice.
+//
+// The chunks live in the slots of a torus (chunkSlot) that stays centred on
+// the player: a chunk leaving range gives its slot to the one coming in on
+// the opposite side. Its neighbours stop waiting for it, and its jobs are
+// cancelled, queued or running, through the epoch of the slot. The torus is
+// PREFETCH_DISTANCE chunks wider than the view on each side, and its centre
+// runs ahead of the player along their velocity, so the chunks they are
+// heading to are generated, lit and meshed before they come into view.
+typedef enum {
+    CHUNK_STAGE_EMPTY,           // coordinates assigned, nothing computed yet
+    CHUNK_STAGE_GENERATED,       // terrain generated, saved edits applied
+    CHUNK_STAGE_NEIGHBORS_READY, // the 8 neighbours are generated too
+    CHUNK_STAGE_POPULATED,       // features crossing chunk borders placed (none with the current generator)
+    CHUNK_STAGE_LIT,             // light final: the chunk and all its neighbours are lit
+    CHUNK_STAGE_MESHED,          // mesh built or read from the cache, waiting for upload
+    CHUNK_STAGE_UPLOADED,        // mesh on the GPU
+    CHUNK_STAGE_COUNT
+} ChunkStage;
+
+// Cancellation handle held by the jobs of a chunk: its slot and the epoch of
+// the slot (Chunk.epoch) when the job was made. Handing the slot to another
+// chunk moves it to a new epoch, which cancels every job holding the old
+// handle; checking costs one atomic load.
+typedef struct ChunkHandle {
+    int index;
+    unsigned epoch;
+} ChunkHandle;
+
+typedef struct ChunkStageStats {
+    int chunks;         // chunks currently at this stage
+    int queued;         // chunks at the previous stage, on their way to this one
+    long entered;       // chunks that reached this stage so far
+    double meanLatency; // seconds from the previous stage to this one
+    double maxLatency;
+} ChunkStageStats;
+
+// Work avoided because its chunk left range first
+typedef struct ChunkCancelStats {
+    long left;            // chunks that left range
+    long kept;            // came back before their slot was reused: not generated again
+    long generateSkipped; // generation jobs cancelled before they ran
+    long generateWasted;  // generated, but the chunk left before taking its slot
+    long lightSkipped;    // light jobs cancelled
+    long meshSkipped;     // mesh jobs cancelled, before or while meshing, and meshes not uploaded
+    double savedSeconds;  // worker time the cancelled jobs would have taken (mean time of each kind)
+} ChunkCancelStats;
+
+// Chunks that came into view (within VIEW_DISTANCE of the player's chunk)
+// as the player moved
+typedef struct ChunkPrefetchStats {
+    long hits;          // already on screen
+    long misses;        // still on their way through the pipeline
+    int aheadX, aheadZ; // chunks the centre of the grid runs ahead of the player
+} ChunkPrefetchStats;
+
+// Where the generation jobs got the blocks of the chunks coming into range
+typedef enum {
+    CHUNK_SOURCE_KEPT,      // still in its slot (back before the slot was reused)
+    CHUNK_SOURCE_COLD,      // decompressed from the cold tier (residency.h)
+    CHUNK_SOURCE_SAVE,      // copied from a snapshot waiting for the save job
+    CHUNK_SOURCE_REGION,    // read from its region file
+    CHUNK_SOURCE_GENERATED, // generated
+    CHUNK_SOURCE_COUNT
+} ChunkSource;
+
+typedef struct ChunkSourceStats {
+    long chunks;
+    double meanSeconds; // worker time to get the blocks
+} ChunkSourceStats;
+
+// Give the CHUNK_GRID_SIDE^2 slots of chunks the chunks around playerPos and
+// send them through the pipeline. The mesh system must be started (meshing
+// and upload report back through ChunkPipelineReached).
+void StartChunkPipeline(Chunk *chunks, int totalChunks, Vector3 playerPos);
+// Main thread, every frame: once the centre of the grid moves (the player
+// enters another chunk, or their velocity changes where they will be in a
+// moment), the chunks left behind give their slots to the ones coming into
+// range, the ones on the player's way (velocity, then look direction) first
+void StreamChunks(Vector3 playerPos, Vector3 velocity, Vector3 direction);
+// Wait for the generation and light jobs (before shutting the mesh system down)
+void ShutdownChunkPipeline(void);
+// Chunk the slot holds or waits for, and whether it is resident (not evicted)
+int ChunkSlotCoords(int chunkIndex, int *chunkX, int *chunkZ);
+// Main thread: take the chunk of a slot out of the pipeline to free its
+// memory. Its jobs are cancelled, unsaved edits go to the save job, its mesh
+// is freed, and a job moves its blocks to the cold tier and frees them (see
+// ChunkDataReleasing). The slot stays reserved for the chunk.
+void EvictChunk(int chunkIndex);
+// Bytes of blocks evicted but not freed yet, still in chunkDataBytes
+size_t ChunkDataReleasing(void);
+// Main thread: an evicted chunk goes through the pipeline again, from its
+// generation (or reload)
+void ReadmitChunk(int chunkIndex);
+ChunkHandle ChunkHandleOf(int chunkIndex);
+int ChunkHandleCancelled(ChunkHandle handle);
+// Called by the mesh system: the chunk of handle got to CHUNK_STAGE_MESHED or
+// CHUNK_STAGE_UPLOADED. Ignored unless it is the next stage of the chunk.
+void ChunkPipelineReached(ChunkHandle handle, ChunkStage stage);
+void GetChunkPipelineStats(ChunkStageStats stats[CHUNK_STAGE_COUNT]);
+ChunkCancelStats GetChunkCancelStats(void);
+ChunkPrefetchStats GetChunkPrefetchStats(void);
+void GetChunkSourceStats(ChunkSourceStats stats[CHUNK_SOURCE_COUNT]);
+const char *ChunkSourceName(ChunkSource source);
+const char *ChunkStageName(ChunkStage stage);
+
+#endif // PIPELINE_H
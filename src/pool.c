@@ -0,0 +1,185 @@
+#include "pool.h"
+#include "data.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+// Every class is a multiple of a cache line, so blocks carved one after the
+// other stay aligned and two of them never share a line
+#define POOL_ALIGN(n) (((size_t)(n) + 63) & ~(size_t)63)
+
+// Powers of two for the small buffers (cold chunks, snapshots), and the exact
+// size of the blocks of a chunk, which would waste a quarter of a 128 KiB class
+static const size_t g_classSizes[] = {
+    64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384, 32768, 65536, POOL_ALIGN(sizeof(ChunkData)),
+};
+#define POOL_CLASSES (int)(sizeof(g_classSizes) / sizeof(g_classSizes[0]))
+
+_Static_assert(sizeof(ChunkData) > 65536, "size classes must stay sorted");
+
+// Free blocks hold the link to the next one
+typedef struct PoolBlock {
+    struct PoolBlock *next;
+} PoolBlock;
+
+typedef struct PoolClass {
+    pthread_mutex_t mutex;
+    PoolBlock *free;
+    int freeCount;
+    // rest of the newest slab, carved as needed: pages nobody asked for yet are
+    // never touched, so (without huge pages) they stay out of the resident set
+    unsigned char *cursor, *end;
+} PoolClass;
+
+static PoolClass g_classes[POOL_CLASSES];
+static pthread_once_t g_once = PTHREAD_ONCE_INIT;
+static int g_hugePages = 0;
+static PoolStats g_stats; // modified atomically
+
+static void init_classes(void) {
+    for (int c = 0; c < POOL_CLASSES; c++) {
+        pthread_mutex_init(&g_classes[c].mutex, NULL);
+        g_classes[c].free = NULL;
+        g_classes[c].freeCount = 0;
+        g_classes[c].cursor = g_classes[c].end = NULL;
+    }
+}
+
+void PoolInit(int hugePages) {
+    g_hugePages = hugePages;
+    pthread_once(&g_once, init_classes);
+}
+
+static int size_class(size_t size) {
+    for (int c = 0; c < POOL_CLASSES; c++) {
+        if (size <= g_classSizes[c]) return c;
+    }
+    return -1;
+}
+
+#ifdef _WIN32
+// No mmap here (and windows.h clashes with raylib.h): plain heap slabs
+static unsigned char *map_slab(void) {
+    return malloc(POOL_SLAB_SIZE);
+}
+#else
+// Twice the size, trimmed to a POOL_SLAB_SIZE boundary: a huge page can only
+// back an aligned range
+static unsigned char *map_slab(void) {
+    unsigned char *map = mmap(NULL, 2 * POOL_SLAB_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) return NULL;
+    size_t offset = (POOL_SLAB_SIZE - (uintptr_t)map % POOL_SLAB_SIZE) % POOL_SLAB_SIZE;
+    if (offset > 0) munmap(map, offset);
+    munmap(map + offset + POOL_SLAB_SIZE, POOL_SLAB_SIZE - offset);
+    unsigned char *slab = map + offset;
+#ifdef MADV_HUGEPAGE
+    if (g_hugePages && madvise(slab, POOL_SLAB_SIZE, MADV_HUGEPAGE) == 0) {
+        __atomic_add_fetch(&g_stats.hugePages, 1, __ATOMIC_RELAXED);
+    }
+#endif
+    return slab;
+}
+#endif
+
+// Next block of the newest slab, mapping a new one when it is used up.
+// Called with the lock of the class held: a new slab maps under it, which is
+// rare and only holds up this class.
+static void *carve_block(PoolClass *pc, size_t bytes) {
+    if ((size_t)(pc->end - pc->cursor) < bytes) {
+        unsigned char *slab = map_slab();
+        if (slab == NULL) return NULL;
+        pc->cursor = slab;
+        pc->end = slab + POOL_SLAB_SIZE;
+        __atomic_add_fetch(&g_stats.slabs, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&g_stats.reserved, POOL_SLAB_SIZE, __ATOMIC_RELAXED);
+    }
+    void *p = pc->cursor;
+    pc->cursor += bytes;
+    return p;
+}
+
+void *PoolAlloc(size_t size) {
+    pthread_once(&g_once, init_classes);
+    int c = size_class(size);
+    if (c < 0) {
+        void *p = malloc(size);
+        if (p == NULL) return NULL;
+        __atomic_add_fetch(&g_stats.reserved, size, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&g_stats.used, size, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&g_stats.allocations, 1, __ATOMIC_RELAXED);
+        return p;
+    }
+    PoolClass *pc = &g_classes[c];
+    size_t bytes = g_classSizes[c];
+    pthread_mutex_lock(&pc->mutex);
+    void *p = pc->free;
+    if (p != NULL) {
+        pc->free = pc->free->next;
+        pc->freeCount--;
+    } else {
+        p = carve_block(pc, bytes);
+    }
+    pthread_mutex_unlock(&pc->mutex);
+    if (p == NULL) return NULL;
+    __atomic_add_fetch(&g_stats.used, bytes, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&g_stats.allocations, 1, __ATOMIC_RELAXED);
+    return p;
+}
+
+void PoolFree(void *ptr, size_t size) {
+    if (ptr == NULL) return;
+    int c = size_class(size);
+    __atomic_add_fetch(&g_stats.frees, 1, __ATOMIC_RELAXED);
+    if (c < 0) {
+        __atomic_sub_fetch(&g_stats.reserved, size, __ATOMIC_RELAXED);
+        __atomic_sub_fetch(&g_stats.used, size, __ATOMIC_RELAXED);
+        free(ptr);
+        return;
+    }
+    PoolClass *pc = &g_classes[c];
+    PoolBlock *block = ptr;
+    pthread_mutex_lock(&pc->mutex);
+    block->next = pc->free;
+    pc->free = block;
+    pc->freeCount++;
+    pthread_mutex_unlock(&pc->mutex);
+    __atomic_sub_fetch(&g_stats.used, g_classSizes[c], __ATOMIC_RELAXED);
+}
+
+void PoolReserve(size_t size, int count) {
+    pthread_once(&g_once, init_classes);
+    int c = size_class(size);
+    if (c < 0) return;
+    PoolClass *pc = &g_classes[c];
+    size_t bytes = g_classSizes[c];
+    for (;;) {
+        pthread_mutex_lock(&pc->mutex);
+        unsigned char *p = pc->freeCount < count ? carve_block(pc, bytes) : NULL;
+        pthread_mutex_unlock(&pc->mutex);
+        if (p == NULL) return;
+        // fault the pages in (a whole huge page at the first one) out of the lock
+        for (size_t i = 0; i < bytes; i += 4096) ((volatile unsigned char *)p)[i] = 0;
+        PoolBlock *block = (PoolBlock *)p;
+        pthread_mutex_lock(&pc->mutex);
+        block->next = pc->free;
+        pc->free = block;
+        pc->freeCount++;
+        pthread_mutex_unlock(&pc->mutex);
+    }
+}
+
+PoolStats GetPoolStats(void) {
+    PoolStats stats;
+    stats.reserved = __atomic_load_n(&g_stats.reserved, __ATOMIC_RELAXED);
+    stats.used = __atomic_load_n(&g_stats.used, __ATOMIC_RELAXED);
+    stats.allocations = __atomic_load_n(&g_stats.allocations, __ATOMIC_RELAXED);
+    stats.frees = __atomic_load_n(&g_stats.frees, __ATOMIC_RELAXED);
+    stats.slabs = __atomic_load_n(&g_stats.slabs, __ATOMIC_RELAXED);
+    stats.hugePages = __atomic_load_n(&g_stats.hugePages, __ATOMIC_RELAXED);
+    return stats;
+}
@@ -0,0 +1,41 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+// Slab allocator for the memory chunk streaming churns through: the blocks
+// of the chunks (allocChunkData), the save snapshots and the cold tier. Sizes
+// are rounded up to fixed classes, each carved out of POOL_SLAB_SIZE slabs and
+// recycled through a free list, so a chunk coming into range takes the memory
+// of one that left instead of going back to malloc, and the resident set stops
+// growing once the slabs cover the peak. Slabs are never given back. Thread
+// safe: one lock per class, held for a few pointer moves.
+//
+// Slabs can be advised as transparent huge pages (madvise, where the system
+// has them): fewer TLB misses on the block arrays the light and the mesher
+// sweep.
+
+#define POOL_SLAB_SIZE (2u << 20)
+
+typedef struct PoolStats {
+    size_t reserved;  // slabs, and allocations larger than every class
+    size_t used;      // handed out, rounded up to their class
+    long allocations;
+    long frees;
+    int slabs;
+    int hugePages;    // slabs advised as huge pages
+} PoolStats;
+
+// Slabs mapped after this are advised as huge pages if hugePages is set
+void PoolInit(int hugePages);
+void *PoolAlloc(size_t size);
+// size: the one given to PoolAlloc
+void PoolFree(void *ptr, size_t size);
+// Make sure `count` blocks of the class of `size` sit in its free list,
+// carving and touching new ones as needed: the page faults (and the zeroing
+// of a huge page) happen on the calling thread, not in the PoolAlloc that
+// later takes the block
+void PoolReserve(size_t size, int count);
+PoolStats GetPoolStats(void);
+
+#endif // POOL_H
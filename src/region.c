@@ -0,0 +1,698 @@
+#include "region.h"
+#include "codec.h"
+#include "data.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define REGION_CHUNKS (REGION_SIZE * REGION_SIZE)
+#define REGION_MAGIC "RGN1"
+#define REGION_VERSION 3
+#define REGION_OPEN_FILES 8
+// Dead space a file may carry while saving before it gets compacted, even
+// when it outweighs the live data
+#define REGION_COMPACT_SLACK (256 * 1024)
+
+#define CHUNK_BLOCKS (CHUNK_SIZE * WORLD_HEIGHT * CHUNK_SIZE)
+// Largest raw delta: one changed block per block
+#define DELTA_MAX (4 * CHUNK_BLOCKS)
+// Largest payload: the tag and a raw or compressed delta
+#define PAYLOAD_MAX (1 + CODEC_BOUND(DELTA_MAX))
+
+enum {
+    PAYLOAD_DELTA = 1,        // blocks that differ from generateChunk as (index, value)
+    // 2 held whole chunks as runs, before REGION_VERSION 3
+    PAYLOAD_CHUNK = 3,        // every block, CodecEncodeChunk
+    PAYLOAD_DELTA_PACKED = 4, // PAYLOAD_DELTA through CodecCompress
+};
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+typedef struct RegionEntry {
+    uint32_t offset; // 0 = chunk never saved
+    uint32_t size;
+} RegionEntry;
+
+// Stored as is, in host byte order, in one of the two slots at the start of
+// the file: each sync writes the slot the previous one did not, so a crash
+// while writing it leaves the other one whole, and the valid slot with the
+// highest generation is the header. Only chunks that differ from the
+// generator are stored, the others are regenerated on load.
+typedef struct RegionHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t generation; // syncs of the file so far
+    uint32_t checksum;   // of the header, this field counted as 0
+    uint32_t modified[REGION_CHUNKS / 32]; // one bit per chunk with a payload
+    RegionEntry entries[REGION_CHUNKS];
+} RegionHeader;
+
+// Payloads come after the two header slots
+#define REGION_DATA_START (2 * sizeof(RegionHeader))
+
+// Region files are shared between the chunk loading jobs and the save job.
+// g_regionMutex only covers the table of open files: a load or save pins its
+// file (users) so it stays open, and works under the locks of the file. The
+// slow disk work (fsync, compaction) is done under writeLock, which loads never
+// take, so it does not hold them up.
+typedef struct RegionFile {
+    int open;
+    int rx, rz;
+    int users;                // pins, the file is not closed while pinned
+    unsigned long lastUse;
+    pthread_mutex_t writeLock; // saves, syncs and compaction of the file
+    pthread_rwlock_t lock;    // fd, header and mapping: read by loads, written to change them
+    int fd;
+    RegionHeader header;
+    const unsigned char *map; // read-only view of the first mapSize bytes
+    size_t mapSize;
+    size_t fileSize;
+    // only under writeLock (or in an unpinned file under g_regionMutex)
+    size_t liveBytes;         // payload bytes referenced by the header
+    int headerDirty;          // entries changed since the header was last written
+} RegionFile;
+
+static pthread_mutex_t g_regionMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_regionUnpinned = PTHREAD_COND_INITIALIZER;
+static pthread_once_t g_once = PTHREAD_ONCE_INIT;
+static char g_directory[512] = "";
+static RegionFile g_files[REGION_OPEN_FILES];
+static unsigned long g_useCounter = 0;
+
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#define fsync _commit
+#define make_dir(path) _mkdir(path)
+#else
+#include <sys/mman.h>
+#define make_dir(path) mkdir(path, 0755)
+#endif
+
+static int write_at(int fd, const void *data, size_t size, size_t offset) {
+    const unsigned char *p = data;
+#ifdef _WIN32
+    if (lseek(fd, (long)offset, SEEK_SET) < 0) return -1;
+#endif
+    while (size > 0) {
+#ifdef _WIN32
+        long n = write(fd, p, (unsigned int)size);
+#else
+        ssize_t n = pwrite(fd, p, size, (off_t)offset);
+#endif
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n; size -= (size_t)n; offset += (size_t)n;
+    }
+    return 0;
+}
+
+static int read_at(int fd, void *data, size_t size, size_t offset) {
+    unsigned char *p = data;
+#ifdef _WIN32
+    if (lseek(fd, (long)offset, SEEK_SET) < 0) return -1;
+#endif
+    while (size > 0) {
+#ifdef _WIN32
+        long n = read(fd, p, (unsigned int)size);
+#else
+        ssize_t n = pread(fd, p, size, (off_t)offset);
+#endif
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n; size -= (size_t)n; offset += (size_t)n;
+    }
+    return 0;
+}
+
+#ifdef _WIN32
+// No mmap here (and windows.h clashes with raylib.h): read the file instead
+static const unsigned char *map_file(int fd, size_t size) {
+    unsigned char *p = malloc(size);
+    if (p && read_at(fd, p, size, 0) != 0) {
+        free(p);
+        return NULL;
+    }
+    return p;
+}
+
+static void unmap_file(const unsigned char *map, size_t size) {
+    (void)size;
+    free((void *)map);
+}
+#else
+static const unsigned char *map_file(int fd, size_t size) {
+    void *p = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    return p == MAP_FAILED ? NULL : p;
+}
+
+static void unmap_file(const unsigned char *map, size_t size) {
+    munmap((void *)map, size);
+}
+#endif
+
+// Block as stored: light is left out, chunks are relit on load
+static inline uint16_t block_bits(BlockData b) {
+    b.lightLevel = 0;
+    uint16_t value;
+    memcpy(&value, &b, sizeof(value));
+    return value;
+}
+
+static inline void put16(unsigned char *out, uint16_t a, uint16_t b) {
+    memcpy(out, &a, 2);
+    memcpy(out + 2, &b, 2);
+}
+
+// Payload: a tag, then the blocks that differ from what generateChunk gives
+// for the same coordinates as (index, value) 16 bit pairs, compressed when
+// that is smaller, or the whole chunk through CodecEncodeChunk when that is
+// smaller still (heavily edited chunk). `scratch` holds DELTA_MAX bytes.
+// Returns 0 when nothing differs from the generator.
+static size_t encode_chunk(const Chunk *chunk, Chunk *base, unsigned char *out, unsigned char *scratch) {
+    generateChunk(base, chunk->x, chunk->z);
+    const BlockData *blocks = &chunk->data->blocks[0][0][0];
+    const BlockData *baseBlocks = &base->data->blocks[0][0][0];
+    size_t n = 0;
+    for (int i = 0; i < CHUNK_BLOCKS; i++) {
+        uint16_t value = block_bits(blocks[i]);
+        if (value == block_bits(baseBlocks[i])) continue;
+        put16(scratch + n, (uint16_t)i, value);
+        n += 4;
+    }
+    if (n == 0) return 0;
+
+    size_t packed = CodecCompress(scratch, n, out + 1);
+    if (packed < n) {
+        out[0] = PAYLOAD_DELTA_PACKED;
+        n = packed;
+    } else {
+        out[0] = PAYLOAD_DELTA;
+        memcpy(out + 1, scratch, n);
+    }
+    // a delta of a few blocks cannot lose against the whole chunk (and
+    // CODEC_CHUNK_BOUND fits in scratch)
+    if (n > 256) {
+        size_t full = CodecEncodeChunk(chunk, scratch);
+        if (full > 0 && full < n) {
+            out[0] = PAYLOAD_CHUNK;
+            memcpy(out + 1, scratch, full);
+            n = full;
+        }
+    }
+    return 1 + n;
+}
+
+// A delta applies to chunk as generateChunk(chunk, chunkX, chunkZ) left it
+static int decode_chunk(Chunk *chunk, int chunkX, int chunkZ, const unsigned char *in, size_t size) {
+    static _Thread_local unsigned char unpacked[1 + DELTA_MAX];
+    if (size < 1) return 0;
+    if (in[0] == PAYLOAD_CHUNK) {
+        chunk->x = chunkX;
+        chunk->z = chunkZ;
+        chunk->lit = 0;
+        chunk->dirty = 0;
+        return CodecDecodeChunk(chunk, in + 1, size - 1);
+    }
+    if (in[0] == PAYLOAD_DELTA_PACKED) {
+        size_t n = CodecDecompress(in + 1, size - 1, unpacked + 1, DELTA_MAX);
+        if (n == 0) return 0;
+        unpacked[0] = PAYLOAD_DELTA;
+        in = unpacked;
+        size = 1 + n;
+    }
+    if (in[0] != PAYLOAD_DELTA || (size - 1) % 4 != 0) return 0;
+    BlockData *blocks = &chunk->data->blocks[0][0][0];
+    for (size_t pos = 1; pos < size; pos += 4) {
+        uint16_t index, value;
+        memcpy(&index, in + pos, 2);
+        memcpy(&value, in + pos + 2, 2);
+        if (index >= CHUNK_BLOCKS) return 0;
+        memcpy(&blocks[index], &value, sizeof(BlockData));
+    }
+    computeHeightMap(chunk);
+    computeBlockHash(chunk);
+    return 1;
+}
+
+static int floor_div(int a, int b) {
+    return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
+static void region_path(char *path, size_t size, int rx, int rz, const char *suffix) {
+    snprintf(path, size, "%s/r.%d.%d.region%s", g_directory, rx, rz, suffix);
+}
+
+// FNV-1a
+static uint32_t header_checksum(const RegionHeader *header) {
+    RegionHeader copy = *header;
+    copy.checksum = 0;
+    uint32_t h = 0x811C9DC5u;
+    const unsigned char *p = (const unsigned char *)&copy;
+    for (size_t i = 0; i < sizeof(copy); i++) h = (h ^ p[i]) * 0x01000193u;
+    return h;
+}
+
+static int header_valid(const RegionHeader *header) {
+    return memcmp(header->magic, REGION_MAGIC, 4) == 0 && header->version == REGION_VERSION &&
+           header->checksum == header_checksum(header);
+}
+
+// Write the header in the slot of its generation, the other one keeps the
+// previous header
+static int write_header(int fd, RegionHeader *header) {
+    header->checksum = header_checksum(header);
+    return write_at(fd, header, sizeof(*header), (header->generation & 1) * sizeof(RegionHeader));
+}
+
+// Make the saves since the last sync durable. Payloads are only appended, so
+// syncing them before writing the header means an entry on disk never points
+// to data that did not reach the disk, and the header goes to the slot not
+// holding the current one: a crash in the middle of the write leaves a slot
+// that fails its checksum, and the file opens with the previous header.
+// Called with writeLock held: only saves change the header, so a copy of it is
+// written while the loads go on reading.
+static int region_sync(RegionFile *f) {
+    if (!f->headerDirty) return 1;
+    RegionHeader header = f->header;
+    header.generation++;
+    if (fsync(f->fd) != 0 || write_header(f->fd, &header) != 0 || fsync(f->fd) != 0) {
+        // the next try writes the same slot again, the current header is still in the other one
+        fprintf(stderr, "region: cannot sync region %d %d: %s\n", f->rx, f->rz, strerror(errno));
+        return 0;
+    }
+    pthread_rwlock_wrlock(&f->lock);
+    f->header.generation = header.generation;
+    pthread_rwlock_unlock(&f->lock);
+    f->headerDirty = 0;
+    return 1;
+}
+
+// Close without writing the header
+static void region_release(RegionFile *f) {
+    if (f->map) unmap_file(f->map, f->mapSize);
+    close(f->fd);
+    f->map = NULL;
+    f->mapSize = 0;
+    f->open = 0;
+}
+
+static void region_close(RegionFile *f) {
+    if (!f->open) return;
+    region_sync(f);
+    region_release(f);
+}
+
+static int region_open(RegionFile *f, int rx, int rz, int create) {
+    char path[600];
+    region_path(path, sizeof(path), rx, rz, "");
+    int fd = open(path, O_RDWR | O_BINARY | (create ? O_CREAT : 0), 0644);
+    if (fd < 0) {
+        if (errno != ENOENT) fprintf(stderr, "region: cannot open %s: %s\n", path, strerror(errno));
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return 0;
+    }
+    if ((size_t)st.st_size < REGION_DATA_START) {
+        // new (or truncated before its first save) file: an empty header in
+        // the first slot, nothing valid in the second one
+        static const RegionHeader empty = {0};
+        f->header = empty;
+        memcpy(f->header.magic, REGION_MAGIC, 4);
+        f->header.version = REGION_VERSION;
+        if (write_header(fd, &f->header) != 0 || write_at(fd, &empty, sizeof(empty), sizeof(RegionHeader)) != 0) {
+            fprintf(stderr, "region: cannot write %s: %s\n", path, strerror(errno));
+            close(fd);
+            return 0;
+        }
+        f->fileSize = REGION_DATA_START;
+    } else {
+        RegionHeader slots[2];
+        if (read_at(fd, slots, sizeof(slots), 0) != 0) {
+            fprintf(stderr, "region: cannot read %s: %s\n", path, strerror(errno));
+            close(fd);
+            return 0;
+        }
+        int valid0 = header_valid(&slots[0]), valid1 = header_valid(&slots[1]);
+        if (!valid0 && !valid1) {
+            int other = memcmp(slots[0].magic, REGION_MAGIC, 4) == 0 && slots[0].version != REGION_VERSION;
+            fprintf(stderr, "region: %s %s\n", path, other ? "was written by another version" : "is not a region file");
+            close(fd);
+            return 0;
+        }
+        f->header = slots[valid1 && (!valid0 || slots[1].generation > slots[0].generation)];
+        f->fileSize = (size_t)st.st_size;
+    }
+    f->liveBytes = 0;
+    for (int i = 0; i < REGION_CHUNKS; i++) {
+        RegionEntry e = f->header.entries[i];
+        // an entry past the end of the file was never completely written
+        if (e.offset && (e.offset < REGION_DATA_START || (size_t)e.offset + e.size > f->fileSize)) {
+            f->header.entries[i] = (RegionEntry){0};
+            f->header.modified[i >> 5] &= ~(1u << (i & 31));
+        } else {
+            f->liveBytes += e.size;
+        }
+    }
+    f->open = 1;
+    f->headerDirty = 0;
+    f->rx = rx;
+    f->rz = rz;
+    f->fd = fd;
+    f->map = NULL;
+    f->mapSize = 0;
+    return 1;
+}
+
+// Open region file (rx, rz), closing the least recently used file nobody
+// uses if needed, and pin it: release it with region_put. Without `create`,
+// NULL when the file does not exist. Called with g_regionMutex held.
+static RegionFile *region_get(int rx, int rz, int create) {
+    for (;;) {
+        // no world open, or RegionOpenWorld refused it
+        if (!g_directory[0]) return NULL;
+        RegionFile *slot = NULL;
+        for (int i = 0; i < REGION_OPEN_FILES; i++) {
+            RegionFile *f = &g_files[i];
+            if (f->open && f->rx == rx && f->rz == rz) {
+                f->lastUse = ++g_useCounter;
+                f->users++;
+                return f;
+            }
+            if (f->users > 0) continue;
+            if (!slot || !f->open || (slot->open && f->lastUse < slot->lastUse)) slot = f;
+        }
+        if (!slot) {
+            pthread_cond_wait(&g_regionUnpinned, &g_regionMutex);
+            continue;
+        }
+        if (slot->open && slot->headerDirty) {
+            // unsynced saves: sync them without holding up the other files,
+            // then look again (a save may have reopened the slot meanwhile)
+            slot->users++;
+            pthread_mutex_unlock(&g_regionMutex);
+            pthread_mutex_lock(&slot->writeLock);
+            int synced = region_sync(slot);
+            pthread_mutex_unlock(&slot->writeLock);
+            pthread_mutex_lock(&g_regionMutex);
+            if (--slot->users == 0) pthread_cond_broadcast(&g_regionUnpinned);
+            if (synced || slot->users > 0) continue;
+            // cannot sync: closed without its header, as region_close would
+            region_release(slot);
+        }
+        region_close(slot);
+        if (!region_open(slot, rx, rz, create)) return NULL;
+        slot->lastUse = ++g_useCounter;
+        slot->users = 1;
+        return slot;
+    }
+}
+
+static void region_put(RegionFile *f) {
+    pthread_mutex_lock(&g_regionMutex);
+    if (--f->users == 0) pthread_cond_broadcast(&g_regionUnpinned);
+    pthread_mutex_unlock(&g_regionMutex);
+}
+
+// Map the whole file again once it has grown past the mapping
+static int region_map(RegionFile *f) {
+    if (f->map && f->mapSize == f->fileSize) return 1;
+    if (f->map) unmap_file(f->map, f->mapSize);
+    f->map = map_file(f->fd, f->fileSize);
+    f->mapSize = f->map ? f->fileSize : 0;
+    return f->map != NULL;
+}
+
+static size_t region_dead_bytes(const RegionFile *f) {
+    return f->fileSize - REGION_DATA_START - f->liveBytes;
+}
+
+// Rewrite the file with only the live payloads. The copy goes to a temporary
+// file renamed over the old one, so a crash leaves one of the two complete.
+// Called with writeLock held: loads go on reading the old file until the new
+// one replaces it.
+static int region_compact(RegionFile *f) {
+    pthread_rwlock_wrlock(&f->lock);
+    int mapped = region_map(f);
+    pthread_rwlock_unlock(&f->lock);
+    if (!mapped) return 0;
+    char path[600], tmpPath[600];
+    region_path(path, sizeof(path), f->rx, f->rz, "");
+    region_path(tmpPath, sizeof(tmpPath), f->rx, f->rz, ".tmp");
+    int fd = open(tmpPath, O_RDWR | O_BINARY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return 0;
+    // the file does not grow without writeLock: loads leave the mapping alone
+    RegionHeader header = f->header;
+    size_t offset = REGION_DATA_START;
+    int ok = 1;
+    for (int i = 0; i < REGION_CHUNKS && ok; i++) {
+        RegionEntry *e = &header.entries[i];
+        if (!e->offset) continue;
+        ok = write_at(fd, f->map + e->offset, e->size, offset) == 0;
+        e->offset = (uint32_t)offset;
+        offset += e->size;
+    }
+    // a fresh file: the header goes to the first slot, the second one stays empty
+    static const RegionHeader empty = {0};
+    header.generation = 0;
+    ok = ok && write_header(fd, &header) == 0 && write_at(fd, &empty, sizeof(empty), sizeof(RegionHeader)) == 0 &&
+         fsync(fd) == 0;
+    if (!ok) {
+        close(fd);
+        remove(tmpPath);
+        return 0;
+    }
+    const unsigned char *oldMap = f->map;
+    size_t oldMapSize = f->mapSize;
+    int oldFd = f->fd;
+    pthread_rwlock_wrlock(&f->lock);
+#ifdef _WIN32
+    // an open file cannot be replaced here
+    unmap_file(oldMap, oldMapSize);
+    close(oldFd);
+    oldMap = NULL;
+    oldFd = -1;
+    f->map = NULL;
+    f->mapSize = 0;
+    remove(path);
+#endif
+    int renamed = rename(tmpPath, path) == 0, error = errno;
+    if (renamed) {
+        // the new file already holds every entry
+        f->fd = fd;
+        f->header = header;
+        f->fileSize = offset;
+        f->map = NULL;
+        f->mapSize = 0;
+        f->headerDirty = 0;
+    } else {
+#ifdef _WIN32
+        f->fd = open(path, O_RDWR | O_BINARY | O_CREAT, 0644);
+#endif
+        oldMap = NULL;
+        oldFd = -1;
+    }
+    pthread_rwlock_unlock(&f->lock);
+    // no load holds the old mapping past the swap
+    if (oldMap) unmap_file(oldMap, oldMapSize);
+    if (oldFd >= 0) close(oldFd);
+    if (!renamed) {
+        // the entries still point to the payloads of the old file
+        fprintf(stderr, "region: cannot replace %s: %s\n", path, strerror(error));
+        close(fd);
+        remove(tmpPath);
+        return 0;
+    }
+#ifndef _WIN32
+    // the rename itself is only durable once the directory is synced
+    int dirFd = open(g_directory, O_RDONLY);
+    if (dirFd >= 0) {
+        fsync(dirFd);
+        close(dirFd);
+    }
+#endif
+    return 1;
+}
+
+// Read the number in `directory`/name into *value, or write *value there when
+// the file does not exist. Returns 1 when it was read.
+static int world_value(const char *directory, const char *name, unsigned long *value) {
+    char path[600];
+    snprintf(path, sizeof(path), "%s/%s", directory, name);
+    FILE *file = fopen(path, "r");
+    if (file) {
+        int read = fscanf(file, "%lu", value) == 1;
+        fclose(file);
+        return read;
+    }
+    if ((file = fopen(path, "w")) != NULL) {
+        fprintf(file, "%lu\n", *value);
+        fclose(file);
+    } else {
+        fprintf(stderr, "region: cannot write %s: %s\n", path, strerror(errno));
+    }
+    return 0;
+}
+
+static void init_files(void) {
+    for (int i = 0; i < REGION_OPEN_FILES; i++) {
+        pthread_mutex_init(&g_files[i].writeLock, NULL);
+        pthread_rwlock_init(&g_files[i].lock, NULL);
+    }
+}
+
+int RegionOpenWorld(const char *directory) {
+    pthread_once(&g_once, init_files);
+    g_directory[0] = '\0';
+    if (make_dir(directory) != 0 && errno != EEXIST) {
+        fprintf(stderr, "region: cannot create %s: %s\n", directory, strerror(errno));
+        return 0;
+    }
+    unsigned long version = GENERATOR_VERSION;
+    world_value(directory, "generator", &version);
+    if (version != GENERATOR_VERSION) {
+        fprintf(stderr, "region: %s was generated by generator version %lu, this build has version %d: "
+                "its saved edits apply to other terrain, move it away to start a new world\n",
+                directory, version, GENERATOR_VERSION);
+        return 0;
+    }
+    unsigned long seed = worldSeed();
+    if (world_value(directory, "seed", &seed)) setWorldSeed((uint32_t)seed);
+    snprintf(g_directory, sizeof(g_directory), "%s", directory);
+    return 1;
+}
+
+void RegionCloseWorld(void) {
+    pthread_mutex_lock(&g_regionMutex);
+    for (int i = 0; i < REGION_OPEN_FILES; i++) {
+        RegionFile *f = &g_files[i];
+        while (f->users > 0) pthread_cond_wait(&g_regionUnpinned, &g_regionMutex);
+        if (f->open && region_dead_bytes(f) > f->liveBytes) region_compact(f);
+        region_close(f);
+    }
+    pthread_mutex_unlock(&g_regionMutex);
+}
+
+static inline int region_index(int chunkX, int chunkZ, int rx, int rz) {
+    return (chunkX - rx * REGION_SIZE) * REGION_SIZE + (chunkZ - rz * REGION_SIZE);
+}
+
+// Decoded straight from the mapping, under the read lock of the file (the
+// mapping moves when the file grows, and a compaction replaces it). The chunk
+// a delta applies to is generated with the lock released, then the entry is
+// looked up again.
+int RegionLoadChunk(Chunk *chunk, int chunkX, int chunkZ) {
+    if (chunk->data == NULL) chunk->data = allocChunkData();
+    int rx = floor_div(chunkX, REGION_SIZE), rz = floor_div(chunkZ, REGION_SIZE);
+    int index = region_index(chunkX, chunkZ, rx, rz);
+    pthread_mutex_lock(&g_regionMutex);
+    RegionFile *f = region_get(rx, rz, 0);
+    pthread_mutex_unlock(&g_regionMutex);
+    int saved = 0, generated = 0, ok = 0;
+    if (f) {
+        pthread_rwlock_rdlock(&f->lock);
+        for (;;) {
+            RegionEntry e = f->header.entries[index];
+            saved = (f->header.modified[index >> 5] & (1u << (index & 31))) != 0;
+            if (!saved) break;
+            if (!f->map || (size_t)e.offset + e.size > f->mapSize) {
+                // saved since the file was last mapped
+                pthread_rwlock_unlock(&f->lock);
+                pthread_rwlock_wrlock(&f->lock);
+                saved = region_map(f);
+                pthread_rwlock_unlock(&f->lock);
+                pthread_rwlock_rdlock(&f->lock);
+                if (saved) continue;
+                break;
+            }
+            if (!generated && e.size > 0 && f->map[e.offset] != PAYLOAD_CHUNK) {
+                pthread_rwlock_unlock(&f->lock);
+                generateChunk(chunk, chunkX, chunkZ);
+                generated = 1;
+                pthread_rwlock_rdlock(&f->lock);
+                continue;
+            }
+            ok = decode_chunk(chunk, chunkX, chunkZ, f->map + e.offset, e.size);
+            break;
+        }
+        pthread_rwlock_unlock(&f->lock);
+        region_put(f);
+    }
+    if (saved && !ok) fprintf(stderr, "region: chunk %d %d is corrupted, regenerating it\n", chunkX, chunkZ);
+    if (!ok) generateChunk(chunk, chunkX, chunkZ);
+    return ok;
+}
+
+// The header (entries and bitmap) only reaches the disk in RegionSync, after
+// the payloads it points to. The payload is encoded before taking any lock,
+// and written under writeLock alone: the file lock is only taken to update
+// the entry, so loads from the file wait for neither.
+int RegionSaveChunk(const Chunk *chunk) {
+    static _Thread_local unsigned char payload[PAYLOAD_MAX], scratch[DELTA_MAX];
+    static _Thread_local Chunk base;
+    int rx = floor_div(chunk->x, REGION_SIZE), rz = floor_div(chunk->z, REGION_SIZE);
+    int index = region_index(chunk->x, chunk->z, rx, rz);
+    size_t size = encode_chunk(chunk, &base, payload, scratch);
+    pthread_mutex_lock(&g_regionMutex);
+    // a chunk back to its generated state only needs its old payload dropped
+    RegionFile *f = region_get(rx, rz, size > 0);
+    pthread_mutex_unlock(&g_regionMutex);
+    if (!f) return size == 0;
+    int ok = 1;
+    pthread_mutex_lock(&f->writeLock);
+    RegionEntry *e = &f->header.entries[index];
+    if (size == 0) {
+        if (e->offset) {
+            f->liveBytes -= e->size;
+            pthread_rwlock_wrlock(&f->lock);
+            *e = (RegionEntry){0};
+            f->header.modified[index >> 5] &= ~(1u << (index & 31));
+            pthread_rwlock_unlock(&f->lock);
+            f->headerDirty = 1;
+        }
+    } else if (write_at(f->fd, payload, size, f->fileSize) != 0) {
+        ok = 0;
+    } else {
+        f->liveBytes = f->liveBytes - e->size + size;
+        pthread_rwlock_wrlock(&f->lock);
+        e->offset = (uint32_t)f->fileSize;
+        e->size = (uint32_t)size;
+        f->fileSize += size;
+        f->header.modified[index >> 5] |= 1u << (index & 31);
+        pthread_rwlock_unlock(&f->lock);
+        f->headerDirty = 1;
+        size_t dead = region_dead_bytes(f);
+        if (dead > f->liveBytes && dead > REGION_COMPACT_SLACK) region_compact(f);
+    }
+    pthread_mutex_unlock(&f->writeLock);
+    region_put(f);
+    return ok;
+}
+
+void RegionSync(void) {
+    for (int i = 0; i < REGION_OPEN_FILES; i++) {
+        RegionFile *f = &g_files[i];
+        pthread_mutex_lock(&g_regionMutex);
+        int open = f->open;
+        if (open) f->users++;
+        pthread_mutex_unlock(&g_regionMutex);
+        if (!open) continue;
+        pthread_mutex_lock(&f->writeLock);
+        region_sync(f);
+        pthread_mutex_unlock(&f->writeLock);
+        region_put(f);
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef REGION_H
+#define REGION_H
+
+#include "data.h"
+
+// World persistence. The generator is deterministic, so only chunks that
+// differ from generateChunk are stored, as the blocks that changed (or the
+// whole chunk when it is smaller), compressed with the codec. Chunks are
+// grouped by REGION_SIZE x REGION_SIZE into region files: a header holding a
+// bitmap of the modified chunks and one (offset, size) entry per chunk, kept
+// in two alternating checksummed slots, followed by the payloads. Saving a
+// chunk appends its payload at the end of the file and rewrites its entry, so
+// the previous payload becomes dead space; a file is compacted once its dead
+// space outweighs the live data. Files are read through mmap.
+#define REGION_SIZE 32
+
+// Use `directory` (created if missing) for the region files. The payloads are
+// deltas against generateChunk, so a world keeps the seed it was generated
+// with: read from `directory`/seed when there is one (setWorldSeed), else the
+// current seed is written there. Same for the GENERATOR_VERSION in
+// `directory`/generator (written next to the seed for a new world), except
+// that a world made by another version is refused: returns 0, and the region
+// calls do nothing until a world opens.
+int RegionOpenWorld(const char *directory);
+// Compact and close every open region file
+void RegionCloseWorld(void);
+// Fill chunk: generated, with its saved edits applied. Returns 1 when it had
+// edits on disk.
+int RegionLoadChunk(Chunk *chunk, int chunkX, int chunkZ);
+// Store the difference between chunk and the generator (nothing for a chunk
+// that matches it). 0 on I/O error. Not durable before the next RegionSync.
+int RegionSaveChunk(const Chunk *chunk);
+// Make every save so far durable: payloads are synced, then the headers
+// pointing to them written and synced. Thread-safe, like the calls above.
+void RegionSync(void);
+
+#endif // REGION_H
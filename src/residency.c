@@ -0,0 +1,278 @@
+#include "residency.h"
+#include "pipeline.h"
+#include "mesh.h"
+#include "codec.h"
+#include "pool.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+// Evicted chunks come back once memory, with room for one more chunk, is
+// below this fraction of the budget: eviction stops right under the budget,
+// so the chunks it just evicted do not come back on the next frame
+#define RESIDENCY_REFILL 0.9
+
+// A cold chunk: its blocks through CodecCompress, which decodes at a few GB/s
+// on the generated terrain, and what would otherwise be recomputed from them
+typedef struct CompressedChunk {
+    int x, z;
+    size_t size;
+    unsigned char *bytes;
+    uint64_t blockHash;
+    uint64_t sideHash[4];
+    uint8_t heightMap[CHUNK_SIZE][CHUNK_SIZE];
+} CompressedChunk;
+
+static Chunk *g_chunks = NULL;
+static int g_totalChunks = 0;
+static size_t g_budget = 0;
+static ResidencyMode g_mode = RESIDENCY_DROP;
+// Per slot (main thread): the chunk it held last frame, when that chunk was
+// last in view (or came into range), and its squared distance to the player
+static int *g_slotX = NULL, *g_slotZ = NULL;
+static double *g_lastSeen = NULL;
+static int *g_distance = NULL;
+static int *g_order = NULL;
+static ResidencyStats g_stats;
+
+// Cold tier, oldest first. The release jobs (evictions) and the generation
+// jobs (chunks leaving range) add chunks, the generation jobs take them back.
+static pthread_mutex_t g_storeMutex = PTHREAD_MUTEX_INITIALIZER;
+static CompressedChunk *g_store = NULL;
+static int g_storeCount = 0, g_storeCapacity = 0;
+static size_t g_storeBytes = 0;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+void InitResidency(Chunk *chunks, int totalChunks, size_t budget, ResidencyMode mode) {
+    g_chunks = chunks;
+    g_totalChunks = totalChunks;
+    g_budget = budget;
+    g_mode = mode;
+    g_slotX = calloc(totalChunks, sizeof(int));
+    g_slotZ = calloc(totalChunks, sizeof(int));
+    g_lastSeen = calloc(totalChunks, sizeof(double));
+    g_distance = calloc(totalChunks, sizeof(int));
+    g_order = calloc(totalChunks, sizeof(int));
+    g_stats = (ResidencyStats){0};
+}
+
+void SetResidencyBudget(size_t budget) {
+    g_budget = budget;
+}
+
+void SetResidencyMode(ResidencyMode mode) {
+    __atomic_store_n(&g_mode, mode, __ATOMIC_RELAXED);
+}
+
+ResidencyMode GetResidencyMode(void) {
+    return g_mode;
+}
+
+static size_t compressed_bytes(int *count) {
+    pthread_mutex_lock(&g_storeMutex);
+    size_t bytes = g_storeBytes;
+    if (count) *count = g_storeCount;
+    pthread_mutex_unlock(&g_storeMutex);
+    return bytes;
+}
+
+static size_t memory_in_use(MeshMemory *meshes) {
+    *meshes = GetMeshMemory();
+    return chunkDataBytes() - ChunkDataReleasing() + meshes->cpu + meshes->gpu + compressed_bytes(NULL);
+}
+
+// Called with g_storeMutex held
+static CompressedChunk take_stored(int position) {
+    CompressedChunk entry = g_store[position];
+    memmove(&g_store[position], &g_store[position + 1], (g_storeCount - position - 1) * sizeof(CompressedChunk));
+    g_storeCount--;
+    g_storeBytes -= entry.size + sizeof(CompressedChunk);
+    return entry;
+}
+
+// The oldest cold chunk goes: it is reloaded from its region file (or
+// generated) if it comes back. Returns 0 once the store is empty.
+static int drop_oldest_stored(void) {
+    pthread_mutex_lock(&g_storeMutex);
+    if (g_storeCount == 0) {
+        pthread_mutex_unlock(&g_storeMutex);
+        return 0;
+    }
+    CompressedChunk entry = take_stored(0);
+    pthread_mutex_unlock(&g_storeMutex);
+    PoolFree(entry.bytes, entry.size);
+    return 1;
+}
+
+void ResidencyStoreChunk(const Chunk *chunk) {
+    static _Thread_local unsigned char scratch[CODEC_BOUND(sizeof(chunk->data->blocks))];
+    CompressedChunk entry = { chunk->x, chunk->z, 0, NULL, chunk->blockHash, {0}, {{0}} };
+    if (__atomic_load_n(&g_mode, __ATOMIC_RELAXED) == RESIDENCY_COMPRESS) {
+        entry.size = CodecCompress(chunk->data->blocks, sizeof(chunk->data->blocks), scratch);
+        entry.bytes = PoolAlloc(entry.size);
+        if (entry.bytes) memcpy(entry.bytes, scratch, entry.size);
+        memcpy(entry.sideHash, chunk->sideHash, sizeof(entry.sideHash));
+        memcpy(entry.heightMap, chunk->data->heightMap, sizeof(entry.heightMap));
+    }
+    CompressedChunk older = {0};
+    pthread_mutex_lock(&g_storeMutex);
+    for (int i = g_storeCount - 1; i >= 0; i--) {
+        if (g_store[i].x == chunk->x && g_store[i].z == chunk->z) {
+            older = take_stored(i);
+            break;
+        }
+    }
+    if (entry.bytes) {
+        if (g_storeCount == g_storeCapacity) {
+            g_storeCapacity = g_storeCapacity ? g_storeCapacity * 2 : 64;
+            g_store = realloc(g_store, g_storeCapacity * sizeof(CompressedChunk));
+        }
+        g_store[g_storeCount++] = entry;
+        g_storeBytes += entry.size + sizeof(CompressedChunk);
+    }
+    pthread_mutex_unlock(&g_storeMutex);
+    PoolFree(older.bytes, older.size);
+}
+
+// Cold chunks the player went too far from
+static void drop_far_stored(int playerX, int playerZ) {
+    pthread_mutex_lock(&g_storeMutex);
+    for (int i = g_storeCount - 1; i >= 0; i--) {
+        if (abs(g_store[i].x - playerX) <= COLD_DISTANCE && abs(g_store[i].z - playerZ) <= COLD_DISTANCE) continue;
+        CompressedChunk entry = take_stored(i);
+        PoolFree(entry.bytes, entry.size);
+    }
+    pthread_mutex_unlock(&g_storeMutex);
+}
+
+int ResidencyRestore(Chunk *chunk, int chunkX, int chunkZ) {
+    CompressedChunk entry = {0};
+    pthread_mutex_lock(&g_storeMutex);
+    for (int i = g_storeCount - 1; i >= 0; i--) {
+        if (g_store[i].x == chunkX && g_store[i].z == chunkZ) {
+            entry = take_stored(i);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_storeMutex);
+    if (!entry.bytes) return 0;
+    if (chunk->data == NULL) chunk->data = allocChunkData();
+    size_t size = CodecDecompress(entry.bytes, entry.size, chunk->data->blocks, sizeof(chunk->data->blocks));
+    PoolFree(entry.bytes, entry.size);
+    if (size != sizeof(chunk->data->blocks)) return 0;
+    memcpy(chunk->data->heightMap, entry.heightMap, sizeof(entry.heightMap));
+    chunk->blockHash = entry.blockHash;
+    memcpy(chunk->sideHash, entry.sideHash, sizeof(entry.sideHash));
+    chunk->x = chunkX;
+    chunk->z = chunkZ;
+    chunk->lit = 0;
+    chunk->dirty = 0;
+    memset(chunk->data->skyLight, 0, sizeof(chunk->data->skyLight));
+    return 1;
+}
+
+// Eviction order: least recently seen first, then farthest first
+static int compare_eviction(const void *a, const void *b) {
+    int i = *(const int *)a, j = *(const int *)b;
+    if (g_lastSeen[i] != g_lastSeen[j]) return g_lastSeen[i] < g_lastSeen[j] ? -1 : 1;
+    return g_distance[j] - g_distance[i];
+}
+
+static int compare_distance(const void *a, const void *b) {
+    return g_distance[*(const int *)a] - g_distance[*(const int *)b];
+}
+
+void UpdateResidency(Vector3 playerPos) {
+    double now = now_seconds();
+    int playerX = (int)floorf(playerPos.x / CHUNK_SIZE), playerZ = (int)floorf(playerPos.z / CHUNK_SIZE);
+    int candidates = 0, evicted = 0, loading = 0;
+    // evictable chunks fill g_order from the front, evicted ones from the back
+    for (int i = 0; i < g_totalChunks; i++) {
+        int x, z;
+        int resident = ChunkSlotCoords(i, &x, &z);
+        if (x != g_slotX[i] || z != g_slotZ[i]) {
+            g_slotX[i] = x;
+            g_slotZ[i] = z;
+            g_lastSeen[i] = now;
+        }
+        g_distance[i] = (x - playerX) * (x - playerX) + (z - playerZ) * (z - playerZ);
+        int stage = __atomic_load_n(&g_chunks[i].stage, __ATOMIC_ACQUIRE);
+        if (abs(x - playerX) <= VIEW_DISTANCE && abs(z - playerZ) <= VIEW_DISTANCE) {
+            g_lastSeen[i] = now;
+            if (!resident) {
+                ReadmitChunk(i);
+                g_stats.readmissions++;
+                loading++;
+            }
+        } else if (!resident) {
+            g_order[g_totalChunks - 1 - evicted++] = i;
+        } else if (stage >= CHUNK_STAGE_GENERATED) {
+            g_order[candidates++] = i;
+        } else {
+            loading++;
+        }
+    }
+
+    drop_far_stored(playerX, playerZ);
+    MeshMemory meshes;
+    size_t used = memory_in_use(&meshes);
+    if (used > g_budget) {
+        qsort(g_order, candidates, sizeof(int), compare_eviction);
+        for (int k = 0; k < candidates && used > g_budget; k++) {
+            int i = g_order[k];
+            EvictChunk(i);
+            g_stats.evictions++;
+            evicted++;
+            used = memory_in_use(&meshes);
+        }
+        // the cold chunks go last, oldest first
+        while (used > g_budget && drop_oldest_stored()) used = memory_in_use(&meshes);
+    } else if (evicted > 0) {
+        // a chunk coming back costs its blocks and a mesh of average size,
+        // and so do the chunks still loading
+        size_t perChunk = sizeof(ChunkData) + (meshes.count > 0 ? (meshes.cpu + meshes.gpu) / meshes.count : 0);
+        size_t planned = used + (size_t)loading * perChunk;
+        int *back = &g_order[g_totalChunks - evicted];
+        qsort(back, evicted, sizeof(int), compare_distance);
+        int readmitted = 0;
+        while (readmitted < evicted && planned + perChunk <= g_budget * RESIDENCY_REFILL) {
+            ReadmitChunk(back[readmitted++]);
+            planned += perChunk;
+        }
+        g_stats.readmissions += readmitted;
+        evicted -= readmitted;
+    }
+    g_stats.resident = g_totalChunks - evicted;
+    g_stats.evicted = evicted;
+}
+
+ResidencyStats GetResidencyStats(void) {
+    ResidencyStats stats = g_stats;
+    MeshMemory meshes = GetMeshMemory();
+    stats.budget = g_budget;
+    stats.voxelBytes = chunkDataBytes();
+    stats.cpuMeshBytes = meshes.cpu;
+    stats.gpuMeshBytes = meshes.gpu;
+    stats.compressedBytes = compressed_bytes(&stats.compressed);
+    return stats;
+}
+
+void ShutdownResidency(void) {
+    while (drop_oldest_stored()) {}
+    free(g_store);
+    g_store = NULL;
+    g_storeCapacity = 0;
+    free(g_slotX);
+    free(g_slotZ);
+    free(g_lastSeen);
+    free(g_distance);
+    free(g_order);
+}
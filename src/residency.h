@@ -0,0 +1,60 @@
+#ifndef RESIDENCY_H
+#define RESIDENCY_H
+
+#include "data.h"
+
+#include <stddef.h>
+
+// Keeps the memory of the loaded chunks under a budget: their blocks, the CPU
+// copies of their meshes and the GPU meshes. Past the budget, chunks out of
+// view are evicted least recently seen first, the farthest first among those
+// seen at the same time. They leave the chunk pipeline until memory frees up
+// or the player comes close again. Chunks in view are never evicted, so a
+// budget too small for the view is only reported as exceeded.
+//
+// Between the loaded chunks and the disk sits a cold tier: the blocks of the
+// chunks that were evicted or left range, compressed in RAM. A chunk coming
+// back within COLD_DISTANCE is decompressed instead of being read from its
+// region file or generated again. The cold tier counts in the budget and gives
+// its oldest chunks back first.
+
+// Cold chunks farther than this from the player's chunk are dropped
+#define COLD_DISTANCE (CHUNK_GRID_SIDE / 2 + 8)
+
+typedef enum {
+    RESIDENCY_DROP,     // blocks of evicted chunks and of chunks leaving range are freed
+    RESIDENCY_COMPRESS, // they go to the cold tier (CodecCompress)
+} ResidencyMode;
+
+typedef struct ResidencyStats {
+    size_t budget;
+    size_t voxelBytes;      // blocks of the chunks (workers' load buffers included)
+    size_t cpuMeshBytes;    // CPU copies kept with the uploaded meshes
+    size_t gpuMeshBytes;    // vertex buffers and light volume textures
+    size_t compressedBytes; // cold tier
+    int resident;           // chunks in range holding their blocks (or loading them)
+    int evicted;            // chunks in range evicted
+    int compressed;         // chunks in the cold tier
+    long evictions;
+    long readmissions;
+} ResidencyStats;
+
+void InitResidency(Chunk *chunks, int totalChunks, size_t budget, ResidencyMode mode);
+void SetResidencyBudget(size_t budget);
+void SetResidencyMode(ResidencyMode mode);
+ResidencyMode GetResidencyMode(void);
+// Main thread, every frame, after StreamChunks: evict chunks while over
+// budget, readmit evicted chunks that came into view, and the others nearest
+// first once there is room again
+void UpdateResidency(Vector3 playerPos);
+// Any thread, while nothing else changes the blocks of chunk: chunk leaves
+// memory, its blocks go to the cold tier (replacing an older copy; with
+// RESIDENCY_DROP, the older copy is only dropped)
+void ResidencyStoreChunk(const Chunk *chunk);
+// Any thread: fill chunk with chunk (chunkX, chunkZ) from the cold tier,
+// which then drops it. Returns 0 if it is not there.
+int ResidencyRestore(Chunk *chunk, int chunkX, int chunkZ);
+ResidencyStats GetResidencyStats(void);
+void ShutdownResidency(void);
+
+#endif // RESIDENCY_H
@@ -0,0 +1,229 @@
+#include "save.h"
+#include "region.h"
+#include "jobs.h"
+#include "data.h"
+#include "pool.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Snapshot buffers kept faulted in: more than one SaveDirtyChunks call takes
+// on warm memory. A fresh pool slab costs the thread that touches it first a
+// page fault per page, or the zeroing of a whole huge page (and a compaction
+// at worst), up to milliseconds for a single snapshot.
+#define SAVE_SNAPSHOT_RESERVE 64
+
+typedef struct SaveSnapshot {
+    Chunk chunk;  // only x, z and the blocks are filled
+    int saved;    // written by the save job (a failed write is tried again)
+    struct SaveSnapshot *next;
+} SaveSnapshot;
+
+// FIFO of snapshots waiting for the save job
+static SaveSnapshot *g_head = NULL;
+static SaveSnapshot *g_tail = NULL;
+// batch the save job is writing, freed once it is all written
+static SaveSnapshot *g_writingBatch = NULL;
+static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int g_writing = 0; // a save job is queued or running
+static JobCounter g_saveJobs = {0};
+static SaveStats g_stats = {0};
+// next chunk index to look at, so a call cut short by its budget resumes there
+static int g_cursor = 0;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// A later snapshot of the same chunk in the batch made it to the disk
+static int superseded(const SaveSnapshot *s) {
+    for (const SaveSnapshot *later = s->next; later; later = later->next) {
+        if (later->saved && later->chunk.x == s->chunk.x && later->chunk.z == s->chunk.z) return 1;
+    }
+    return 0;
+}
+
+static void reserve_snapshots(void) {
+    PoolReserve(sizeof(SaveSnapshot), SAVE_SNAPSHOT_RESERVE);
+    PoolReserve(sizeof(ChunkData), SAVE_SNAPSHOT_RESERVE);
+}
+
+// Take everything queued at once: the whole batch is written, then synced
+// with one RegionSync instead of one fsync per chunk. One save job at a time,
+// it keeps going while snapshots arrive and ends once the FIFO is empty.
+// Snapshots whose write failed go back to the front of the FIFO (before any
+// newer snapshot of the same chunk) and the job ends: the next call to
+// SaveDirtyChunks or SaveChunk tries them again. The memory of the next
+// snapshots is faulted in here, off the main thread.
+static void save_job(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&g_mutex);
+    int failed = 0;
+    while (g_head && !failed) {
+        SaveSnapshot *batch = g_head;
+        g_head = g_tail = NULL;
+        g_writingBatch = batch;
+        pthread_mutex_unlock(&g_mutex);
+        // first, so the next SaveDirtyChunks calls have it while this batch is written
+        reserve_snapshots();
+
+        int count = 0;
+        for (SaveSnapshot *s = batch; s; s = s->next) {
+            s->saved = RegionSaveChunk(&s->chunk);
+            failed += !s->saved;
+            count++;
+        }
+        RegionSync();
+
+        pthread_mutex_lock(&g_mutex);
+        g_writingBatch = NULL;
+        SaveSnapshot *retry = NULL, *retryTail = NULL;
+        int kept = 0;
+        while (batch) {
+            SaveSnapshot *next = batch->next;
+            if (!batch->saved && !superseded(batch)) {
+                batch->next = NULL;
+                if (retryTail) retryTail->next = batch;
+                else retry = batch;
+                retryTail = batch;
+                kept++;
+            } else {
+                freeChunkData(batch->chunk.data);
+                PoolFree(batch, sizeof(SaveSnapshot));
+            }
+            batch = next;
+        }
+        if (retry) {
+            retryTail->next = g_head;
+            if (!g_head) g_tail = retryTail;
+            g_head = retry;
+        }
+        g_stats.chunksSaved += count - failed;
+        g_stats.failures += failed;
+        g_stats.batches++;
+        g_stats.pending -= count - kept;
+    }
+    g_writing = 0;
+    pthread_mutex_unlock(&g_mutex);
+}
+
+void InitSaveSystem(void) {
+    g_cursor = 0;
+    g_stats = (SaveStats){0};
+    reserve_snapshots();
+}
+
+static SaveSnapshot *snapshot(Chunk *c) {
+    SaveSnapshot *s = PoolAlloc(sizeof(SaveSnapshot));
+    s->chunk.data = allocChunkData();
+    s->chunk.x = c->x;
+    s->chunk.z = c->z;
+    memcpy(s->chunk.data->blocks, c->data->blocks, sizeof(c->data->blocks));
+    s->saved = 0;
+    s->next = NULL;
+    c->dirty = 0;
+    return s;
+}
+
+// Called with g_mutex held. Also starts a save job for the snapshots left by
+// a failed one when head is NULL.
+static void queue_snapshots(SaveSnapshot *head, SaveSnapshot *tail, int count) {
+    if (head) {
+        if (g_tail) g_tail->next = head;
+        else g_head = head;
+        g_tail = tail;
+        g_stats.pending += count;
+    }
+    if (g_head && !g_writing) {
+        g_writing = 1;
+        JobSubmit(save_job, NULL, JOB_PRIORITY_LOW, &g_saveJobs);
+    }
+}
+
+// A snapshot is only taken if the slowest one of the call so far still fits
+// in the budget (the first one always is, so every call makes progress)
+int SaveDirtyChunks(Chunk *chunks, int totalChunks, double budget) {
+    double start = now_seconds();
+    SaveSnapshot *head = NULL, *tail = NULL;
+    int count = 0, scanned = 0;
+    double slowest = 0.0;
+    for (; scanned < totalChunks; scanned++) {
+        Chunk *c = &chunks[(g_cursor + scanned) % totalChunks];
+        if (!c->dirty) continue;
+        double before = now_seconds();
+        if (count > 0 && before - start + slowest > budget) break;
+        SaveSnapshot *s = snapshot(c);
+        double took = now_seconds() - before;
+        if (took > slowest) slowest = took;
+        if (tail) tail->next = s;
+        else head = s;
+        tail = s;
+        count++;
+    }
+    g_cursor = (g_cursor + scanned) % totalChunks;
+    int left = 0;
+    for (int i = 0; i < totalChunks - scanned; i++) left += chunks[(g_cursor + i) % totalChunks].dirty;
+
+    double stall = now_seconds() - start;
+    pthread_mutex_lock(&g_mutex);
+    queue_snapshots(head, tail, count);
+    g_stats.lastStall = stall;
+    if (stall > g_stats.maxStall) g_stats.maxStall = stall;
+    pthread_mutex_unlock(&g_mutex);
+    return left;
+}
+
+void SaveChunk(Chunk *chunk) {
+    SaveSnapshot *s = snapshot(chunk);
+    pthread_mutex_lock(&g_mutex);
+    queue_snapshots(s, s, 1);
+    pthread_mutex_unlock(&g_mutex);
+}
+
+// A snapshot leaves the lists only once written, so a chunk found in neither
+// is already in its region file. The newest one wins: the FIFO comes after the
+// batch being written, and goes oldest first.
+int RestorePendingSave(Chunk *chunk, int chunkX, int chunkZ) {
+    const SaveSnapshot *found = NULL;
+    if (chunk->data == NULL) chunk->data = allocChunkData();
+    pthread_mutex_lock(&g_mutex);
+    for (int list = 0; list < 2; list++) {
+        for (const SaveSnapshot *s = list == 0 ? g_writingBatch : g_head; s; s = s->next) {
+            if (s->chunk.x == chunkX && s->chunk.z == chunkZ) found = s;
+        }
+    }
+    if (found) memcpy(chunk->data->blocks, found->chunk.data->blocks, sizeof(chunk->data->blocks));
+    pthread_mutex_unlock(&g_mutex);
+    if (!found) return 0;
+    chunk->x = chunkX;
+    chunk->z = chunkZ;
+    chunk->lit = 0;
+    chunk->dirty = 0;
+    memset(chunk->data->skyLight, 0, sizeof(chunk->data->skyLight));
+    computeHeightMap(chunk);
+    computeBlockHash(chunk);
+    return 1;
+}
+
+void ShutdownSaveSystem(void) {
+    JobWait(&g_saveJobs);
+    // one last try for the writes that failed
+    pthread_mutex_lock(&g_mutex);
+    int retry = g_head != NULL && !g_writing;
+    if (retry) g_writing = 1;
+    pthread_mutex_unlock(&g_mutex);
+    if (retry) save_job(NULL);
+    if (g_head) fprintf(stderr, "save: %d chunks could not be saved\n", g_stats.pending);
+}
+
+SaveStats GetSaveStats(void) {
+    pthread_mutex_lock(&g_mutex);
+    SaveStats stats = g_stats;
+    pthread_mutex_unlock(&g_mutex);
+    return stats;
+}
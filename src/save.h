@@ -0,0 +1,39 @@
+#ifndef SAVE_H
+#define SAVE_H
+
+#include "data.h"
+
+// Background saving. The main thread only snapshots the dirty chunks (a copy
+// of their blocks); a low priority job encodes the snapshots, appends them to
+// the region files and makes each batch durable with a single RegionSync.
+// Needs the job system (JobsInit).
+#define AUTOSAVE_INTERVAL 30.0f   // seconds between two autosaves
+#define SAVE_STALL_BUDGET 0.0005  // main thread time one SaveDirtyChunks call may take, in seconds
+
+typedef struct SaveStats {
+    double lastStall;  // seconds the main thread spent in the last SaveDirtyChunks
+    double maxStall;
+    long chunksSaved;
+    long batches;      // batches written and synced by the save job
+    long failures;     // snapshot writes that failed (kept for the next batch)
+    int pending;       // snapshots not written yet
+} SaveStats;
+
+void InitSaveSystem(void);
+// Main thread, holding the read side of the chunk data lock while the light
+// jobs run (TryLockChunkDataRead): snapshot dirty chunks until `budget`
+// seconds are spent and hand them to the save job. Returns how many dirty
+// chunks are left for the next call.
+int SaveDirtyChunks(Chunk *chunks, int totalChunks, double budget);
+// Job holding LockChunkData: snapshot one chunk for the save job right away
+// (it is leaving memory with unsaved edits)
+void SaveChunk(Chunk *chunk);
+// Any thread: give chunk the blocks of the newest snapshot of (chunkX, chunkZ)
+// not written yet, so a chunk coming back right after leaving keeps its
+// edits. Returns 0, leaving chunk alone, when there is none.
+int RestorePendingSave(Chunk *chunk, int chunkX, int chunkZ);
+// Wait until every queued snapshot is written and synced
+void ShutdownSaveSystem(void);
+SaveStats GetSaveStats(void);
+
+#endif // SAVE_H